@@ -0,0 +1,39 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../bench_src/archive_bench.cpp \
+../bench_src/bench.cpp \
+../bench_src/end_to_end_bench.cpp \
+../bench_src/order_index_bench.cpp \
+../bench_src/orderbook_bench.cpp \
+../bench_src/side_policy_bench.cpp 
+
+OBJS += \
+./bench_src/archive_bench.o \
+./bench_src/bench.o \
+./bench_src/end_to_end_bench.o \
+./bench_src/order_index_bench.o \
+./bench_src/orderbook_bench.o \
+./bench_src/side_policy_bench.o 
+
+CPP_DEPS += \
+./bench_src/archive_bench.d \
+./bench_src/bench.d \
+./bench_src/end_to_end_bench.d \
+./bench_src/order_index_bench.d \
+./bench_src/orderbook_bench.d \
+./bench_src/side_policy_bench.d 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+bench_src/%.o: ../bench_src/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -std=c++17 -O3 -Wall -Wextra -Werror -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
@@ -0,0 +1,30 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../src/async_output.cpp \
+../src/feedhandler.cpp \
+../src/orderbook.cpp 
+
+OBJS += \
+./src/async_output.o \
+./src/feedhandler.o \
+./src/orderbook.o 
+
+CPP_DEPS += \
+./src/async_output.d \
+./src/feedhandler.d \
+./src/orderbook.d 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+src/%.o: ../src/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -std=c++17 -O3 -Wall -Wextra -Werror -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
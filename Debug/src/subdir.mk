@@ -4,26 +4,38 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../src/async_output.cpp \
 ../src/feedhandler.cpp \
 ../src/feedhandler_main.cpp \
-../src/orderbook.cpp 
+../src/orderbook.cpp \
+../src/parallel_replay.cpp \
+../src/pipelined_replay.cpp \
+../src/sharded_feedhandler.cpp 
 
 OBJS += \
+./src/async_output.o \
 ./src/feedhandler.o \
 ./src/feedhandler_main.o \
-./src/orderbook.o 
+./src/orderbook.o \
+./src/parallel_replay.o \
+./src/pipelined_replay.o \
+./src/sharded_feedhandler.o 
 
 CPP_DEPS += \
+./src/async_output.d \
 ./src/feedhandler.d \
 ./src/feedhandler_main.d \
-./src/orderbook.d 
+./src/orderbook.d \
+./src/parallel_replay.d \
+./src/pipelined_replay.d \
+./src/sharded_feedhandler.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
 src/%.o: ../src/%.cpp
 	@echo 'Building file: $<'
 	@echo 'Invoking: GCC C++ Compiler'
-	g++ -std=c++0x -O0 -g3 -Wall -Wextra -Werror -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	g++ -std=c++17 -O0 -g3 -Wall -Wextra -Werror -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
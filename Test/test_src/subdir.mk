@@ -4,23 +4,80 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../test_src/async_output_tests.cpp \
+../test_src/book_depth_tests.cpp \
+../test_src/capture_archive_tests.cpp \
+../test_src/capture_format_tests.cpp \
+../test_src/checkpoint_tests.cpp \
+../test_src/conflation_tests.cpp \
+../test_src/ladder_tests.cpp \
+../test_src/latency_histogram_tests.cpp \
+../test_src/live_metrics_tests.cpp \
+../test_src/message_parser_tests.cpp \
+../test_src/multi_instrument_tests.cpp \
+../test_src/node_pool_tests.cpp \
+../test_src/order_index_tests.cpp \
 ../test_src/orderbook_tests.cpp \
-../test_src/test.cpp 
+../test_src/output_sink_tests.cpp \
+../test_src/parallel_replay_tests.cpp \
+../test_src/perf_counters_tests.cpp \
+../test_src/pipelined_replay_tests.cpp \
+../test_src/sharded_feedhandler_tests.cpp \
+../test_src/test.cpp \
+../test_src/workload_simulator_tests.cpp 
 
 OBJS += \
+./test_src/async_output_tests.o \
+./test_src/book_depth_tests.o \
+./test_src/capture_archive_tests.o \
+./test_src/capture_format_tests.o \
+./test_src/checkpoint_tests.o \
+./test_src/conflation_tests.o \
+./test_src/ladder_tests.o \
+./test_src/latency_histogram_tests.o \
+./test_src/live_metrics_tests.o \
+./test_src/message_parser_tests.o \
+./test_src/multi_instrument_tests.o \
+./test_src/node_pool_tests.o \
+./test_src/order_index_tests.o \
 ./test_src/orderbook_tests.o \
-./test_src/test.o 
+./test_src/output_sink_tests.o \
+./test_src/parallel_replay_tests.o \
+./test_src/perf_counters_tests.o \
+./test_src/pipelined_replay_tests.o \
+./test_src/sharded_feedhandler_tests.o \
+./test_src/test.o \
+./test_src/workload_simulator_tests.o 
 
 CPP_DEPS += \
+./test_src/async_output_tests.d \
+./test_src/book_depth_tests.d \
+./test_src/capture_archive_tests.d \
+./test_src/capture_format_tests.d \
+./test_src/checkpoint_tests.d \
+./test_src/conflation_tests.d \
+./test_src/ladder_tests.d \
+./test_src/latency_histogram_tests.d \
+./test_src/live_metrics_tests.d \
+./test_src/message_parser_tests.d \
+./test_src/multi_instrument_tests.d \
+./test_src/node_pool_tests.d \
+./test_src/order_index_tests.d \
 ./test_src/orderbook_tests.d \
-./test_src/test.d 
+./test_src/output_sink_tests.d \
+./test_src/parallel_replay_tests.d \
+./test_src/perf_counters_tests.d \
+./test_src/pipelined_replay_tests.d \
+./test_src/sharded_feedhandler_tests.d \
+./test_src/test.d \
+./test_src/workload_simulator_tests.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
 test_src/%.o: ../test_src/%.cpp
 	@echo 'Building file: $<'
 	@echo 'Invoking: GCC C++ Compiler'
-	g++ -std=c++0x -O0 -g3 -Wall -Wextra -Werror -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	g++ -std=c++17 -O0 -g3 -Wall -Wextra -Werror -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
@@ -0,0 +1,201 @@
+#include "benchmark/benchmark.h"
+
+#include "../src/capture_archive.hpp"
+#include "../src/capture_format.hpp"
+#include "../src/mapped_file.hpp"
+#include "../src/message_parser.hpp"
+#include "../src/orderbook.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+//what a sample feed costs to keep and to read back, as csv, as a flat capture and as
+//a compressed archive. each benchmark reports the bytes stored per message, and
+//messages decoded (or decoded and applied to a book) per second. run from the Bench
+//directory so that ../samples can be found
+
+namespace
+{
+	//a sample held in all three forms
+	struct sample
+	{
+		mapped_file csv;
+		capture_reader capture;
+		archive_reader archive;
+		uint64_t messages = 0;
+		uint64_t capture_bytes = 0;
+	};
+
+	std::string sample_path(int n)
+	{
+		return "../samples/sample_" + std::to_string(n) + "_10000.csv";
+	}
+
+	//converts the sample the first time it's asked for; null if it can't be read
+	const sample *load_sample(int n)
+	{
+		static std::unique_ptr<sample> samples[4];
+		if (samples[n])
+		{
+			return samples[n].get();
+		}
+
+		std::unique_ptr<sample> s(new sample);
+		if (!s->csv.open(sample_path(n).c_str()))
+		{
+			return nullptr;
+		}
+
+		const std::string capture_path = "/tmp/archive_bench_" + std::to_string(getpid()) + ".cap";
+		const std::string archive_path = "/tmp/archive_bench_" + std::to_string(getpid()) + ".fha";
+		capture_writer capture;
+		archive_writer archive;
+		if (!capture.open(capture_path.c_str(), tick_size()) || !archive.open(archive_path.c_str(), tick_size()))
+		{
+			return nullptr;
+		}
+		const message_parser parser;
+		s->csv.for_each_line([&](const char *line, size_t len)
+		{
+			parsed_message msg;
+			if (parser.parse(line, len, msg))
+			{
+				capture.add(to_capture_record(msg, 0));
+				archive.add(to_capture_record(msg, 0));
+			}
+		});
+		s->messages = capture.record_count();
+		if (!capture.close({}) || !archive.close({})
+				|| !s->capture.open(capture_path.c_str()) || !s->archive.open(archive_path.c_str()))
+		{
+			return nullptr;
+		}
+
+		//the mappings outlive the files
+		s->capture_bytes = sizeof(capture_header) + s->messages * sizeof(capture_record);
+		remove(capture_path.c_str());
+		remove(archive_path.c_str());
+		samples[n] = std::move(s);
+		return samples[n].get();
+	}
+
+	void report(benchmark::State &state, const sample &s, uint64_t stored_bytes)
+	{
+		state.SetItemsProcessed(state.iterations() * s.messages);
+		state.counters["bytes_per_msg"] = static_cast<double>(stored_bytes) / s.messages;
+	}
+}
+
+void BM_decode_csv(benchmark::State &state)
+{
+	const sample *s = load_sample(state.range(0));
+	if (!s)
+	{
+		state.SkipWithError("can't read the sample");
+		return;
+	}
+	const message_parser parser;
+	for (auto _ : state)
+	{
+		parsed_message msg;
+		s->csv.for_each_line([&](const char *line, size_t len)
+		{
+			benchmark::DoNotOptimize(parser.parse(line, len, msg));
+		});
+		benchmark::ClobberMemory();
+	}
+	report(state, *s, s->csv.size());
+}
+BENCHMARK(BM_decode_csv)->DenseRange(1, 3);
+
+void BM_decode_capture(benchmark::State &state)
+{
+	const sample *s = load_sample(state.range(0));
+	if (!s)
+	{
+		state.SkipWithError("can't read the sample");
+		return;
+	}
+	for (auto _ : state)
+	{
+		parsed_message msg;
+		for (uint64_t i = 0; i < s->capture.record_count(); ++i)
+		{
+			benchmark::DoNotOptimize(from_capture_record(s->capture.records()[i], msg));
+		}
+		benchmark::ClobberMemory();
+	}
+	report(state, *s, s->capture_bytes);
+}
+BENCHMARK(BM_decode_capture)->DenseRange(1, 3);
+
+void BM_decode_archive(benchmark::State &state)
+{
+	const sample *s = load_sample(state.range(0));
+	if (!s)
+	{
+		state.SkipWithError("can't read the sample");
+		return;
+	}
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(s->archive.for_each_record([](const capture_record &record)
+		{
+			benchmark::DoNotOptimize(record);
+		}));
+	}
+	report(state, *s, sizeof(archive_header) + s->archive.block_bytes() + s->archive.block_count() * sizeof(uint64_t));
+}
+BENCHMARK(BM_decode_archive)->DenseRange(1, 3);
+
+//parsed lines applied to a book, against archived records decoded straight into one
+void BM_replay_csv(benchmark::State &state)
+{
+	const sample *s = load_sample(state.range(0));
+	if (!s)
+	{
+		state.SkipWithError("can't read the sample");
+		return;
+	}
+	const message_parser parser;
+	for (auto _ : state)
+	{
+		orderbook ob;
+		s->csv.for_each_line([&](const char *line, size_t len)
+		{
+			parsed_message msg;
+			if (parser.parse(line, len, msg))
+			{
+				apply_capture_record(ob, to_capture_record(msg, 0));
+			}
+		});
+		benchmark::DoNotOptimize(ob.get_best_price(side::bid));
+	}
+	report(state, *s, s->csv.size());
+}
+BENCHMARK(BM_replay_csv)->DenseRange(1, 3);
+
+void BM_replay_archive(benchmark::State &state)
+{
+	const sample *s = load_sample(state.range(0));
+	if (!s)
+	{
+		state.SkipWithError("can't read the sample");
+		return;
+	}
+	for (auto _ : state)
+	{
+		orderbook ob;
+		s->archive.for_each_record([&ob](const capture_record &record)
+		{
+			apply_capture_record(ob, record);
+		});
+		benchmark::DoNotOptimize(ob.get_best_price(side::bid));
+	}
+	report(state, *s, sizeof(archive_header) + s->archive.block_bytes() + s->archive.block_count() * sizeof(uint64_t));
+}
+BENCHMARK(BM_replay_archive)->DenseRange(1, 3);
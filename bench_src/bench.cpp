@@ -0,0 +1,12 @@
+#include "benchmark/benchmark.h"
+
+
+int main(int argc, char **argv) {
+
+      ::benchmark::Initialize(&argc, argv);
+
+      ::benchmark::RunSpecifiedBenchmarks();
+
+      return 0;
+
+}
@@ -0,0 +1,236 @@
+#include "benchmark/benchmark.h"
+
+#include "../src/capture_format.hpp"
+#include "../src/feedhandler.hpp"
+#include "../src/latency_histogram.hpp"
+#include "../src/workload_simulator.hpp"
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+//the feedhandler's own processing cost, with no file to read and nowhere to write. a
+//feed of each workload profile is generated into memory the first time it's needed,
+//and replayed through a new feedhandler every iteration, with the output formatted as
+//ever but handed to a stream that throws it away. the book isn't printed every so
+//many messages as feedhandler_main does, as on a deep book that would be all that's
+//measured.
+//
+//  BM_end_to_end       each line parsed, applied and its output written
+//  BM_apply            the lines decoded before the clock starts, so only applying them
+//                      and writing the output is timed
+//  BM_apply_latency    BM_apply with each message timed on its own, for the p50, p99,
+//                      p99.9 and max in ns; the timestamps add a little to each
+//
+//every benchmark reports messages a second. the feeds are END_TO_END_EVENTS lines
+//long, a million unless it's set in the environment
+
+namespace
+{
+	//a stream buffer that accepts everything and keeps none of it
+	class null_buffer : public std::streambuf
+	{
+	protected:
+		int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+		std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+	};
+
+	//a profile's feed, as lines one after another in a single buffer
+	struct generated_feed
+	{
+		std::string text;
+		std::vector<std::pair<size_t, size_t>> lines;	//offset and length
+	};
+
+	size_t feed_events()
+	{
+		const char *events = getenv("END_TO_END_EVENTS");
+		return events && atoll(events) > 0 ? atoll(events) : 1000000;
+	}
+
+	const generated_feed &feed_for(size_t profile)
+	{
+		static std::map<size_t, std::unique_ptr<generated_feed>> feeds;
+		auto &feed = feeds[profile];
+		if (feed)
+		{
+			return *feed;
+		}
+
+		feed.reset(new generated_feed);
+		const size_t events = feed_events();
+		workload_simulator simulator(workload_profile::all()[profile], 1);
+		const tick_size ticks;
+		char line[max_capture_line];
+		while (feed->lines.size() < events)
+		{
+			simulator.step([&](int instrument, const parsed_message &msg)
+			{
+				const std::string &symbol = simulator.symbol(instrument);
+				const size_t len = format_capture_line(msg, symbol.data(), symbol.size(), ticks, line);
+				feed->lines.emplace_back(feed->text.size(), len);
+				feed->text.append(line, len);
+			});
+		}
+		return *feed;
+	}
+
+	feedhandler_options options_for(const workload_profile &profile)
+	{
+		feedhandler_options options;
+		if (profile.instruments > 1)
+		{
+			//every instrument gets a pool of its own
+			options.max_instruments = profile.instruments;
+			options.pool.capacity_bytes = 1 << 20;
+		}
+		else
+		{
+			//room for the deep profile's book without going to the heap
+			options.pool.capacity_bytes = 64 << 20;
+		}
+		return options;
+	}
+
+	//a feedhandler writing to nowhere, for one iteration
+	struct null_feedhandler
+	{
+		explicit null_feedhandler(const feedhandler_options &options) : os(&buffer), fh(0, os, options) {}
+
+		null_buffer buffer;
+		std::ostream os;
+		feedhandler fh;
+	};
+
+	void report(benchmark::State &state, const generated_feed &feed)
+	{
+		state.SetItemsProcessed(state.iterations() * feed.lines.size());
+	}
+}
+
+void BM_end_to_end(benchmark::State &state, size_t profile_index)
+{
+	const workload_profile &profile = workload_profile::all()[profile_index];
+	const generated_feed &feed = feed_for(profile_index);
+	const feedhandler_options options = options_for(profile);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		std::unique_ptr<null_feedhandler> handler(new null_feedhandler(options));
+		state.ResumeTiming();
+
+		for (const auto &line : feed.lines)
+		{
+			handler->fh.process_message(feed.text.data() + line.first, line.second);
+		}
+		handler->fh.flush();
+
+		state.PauseTiming();
+		handler.reset();
+		state.ResumeTiming();
+	}
+	report(state, feed);
+}
+
+namespace
+{
+	//every line of the feed decoded as the feedhandler would
+	std::vector<decoded_message> decode_feed(const feedhandler &fh, const generated_feed &feed)
+	{
+		std::vector<decoded_message> decoded(feed.lines.size());
+		for (size_t i = 0; i < feed.lines.size(); ++i)
+		{
+			fh.decode_message(feed.text.data() + feed.lines[i].first, feed.lines[i].second, decoded[i]);
+		}
+		return decoded;
+	}
+}
+
+void BM_apply(benchmark::State &state, size_t profile_index)
+{
+	const workload_profile &profile = workload_profile::all()[profile_index];
+	const generated_feed &feed = feed_for(profile_index);
+	const feedhandler_options options = options_for(profile);
+	std::vector<decoded_message> decoded;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		std::unique_ptr<null_feedhandler> handler(new null_feedhandler(options));
+		if (decoded.empty())
+		{
+			decoded = decode_feed(handler->fh, feed);
+		}
+		state.ResumeTiming();
+
+		for (const auto &msg : decoded)
+		{
+			handler->fh.apply_message(msg);
+		}
+		handler->fh.flush();
+
+		state.PauseTiming();
+		handler.reset();
+		state.ResumeTiming();
+	}
+	report(state, feed);
+}
+
+void BM_apply_latency(benchmark::State &state, size_t profile_index)
+{
+	const workload_profile &profile = workload_profile::all()[profile_index];
+	const generated_feed &feed = feed_for(profile_index);
+	const feedhandler_options options = options_for(profile);
+	std::vector<decoded_message> decoded;
+	std::unique_ptr<latency_histogram> latencies(new latency_histogram);
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		std::unique_ptr<null_feedhandler> handler(new null_feedhandler(options));
+		if (decoded.empty())
+		{
+			decoded = decode_feed(handler->fh, feed);
+		}
+		state.ResumeTiming();
+
+		uint64_t start = read_tsc();
+		for (const auto &msg : decoded)
+		{
+			handler->fh.apply_message(msg);
+			const uint64_t end = read_tsc();
+			latencies->record(end - start);
+			start = end;
+		}
+		handler->fh.flush();
+
+		state.PauseTiming();
+		handler.reset();
+		state.ResumeTiming();
+	}
+	report(state, feed);
+
+	const double ticks_per_ns = tsc_ticks_per_ns();
+	state.counters["p50_ns"] = latencies->value_at(0.5) / ticks_per_ns;
+	state.counters["p99_ns"] = latencies->value_at(0.99) / ticks_per_ns;
+	state.counters["p99.9_ns"] = latencies->value_at(0.999) / ticks_per_ns;
+	state.counters["max_ns"] = latencies->max() / ticks_per_ns;
+}
+
+namespace
+{
+	//each benchmark once for each profile, named after it
+	const bool registered = []()
+	{
+		for (size_t i = 0; i < workload_profile::all().size(); ++i)
+		{
+			const std::string &name = workload_profile::all()[i].name;
+			benchmark::RegisterBenchmark(("BM_end_to_end/" + name).c_str(), BM_end_to_end, i)->Unit(benchmark::kMillisecond);
+			benchmark::RegisterBenchmark(("BM_apply/" + name).c_str(), BM_apply, i)->Unit(benchmark::kMillisecond);
+			benchmark::RegisterBenchmark(("BM_apply_latency/" + name).c_str(), BM_apply_latency, i)->Unit(benchmark::kMillisecond);
+		}
+		return true;
+	}();
+}
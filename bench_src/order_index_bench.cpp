@@ -0,0 +1,79 @@
+#include "benchmark/benchmark.h"
+
+#include "../src/order_index.hpp"
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+//cost of the order id lookups made on every modify and remove, for the node-based
+//map the book used to have and the two flat indexes. ids are dense, as our feeds' are
+
+namespace
+{
+	const int live_orders = 1 << 16;
+
+	struct std_index
+	{
+		std::unordered_map<int, int> map;
+
+		int *insert(int key) { return &map[key]; }
+		int *find(int key)
+		{
+			const auto iter = map.find(key);
+			return iter == map.end() ? nullptr : &iter->second;
+		}
+	};
+
+	std_index make_index(std_index *) { return std_index(); }
+	hashed_order_index<int> make_index(hashed_order_index<int> *) { return hashed_order_index<int>(live_orders); }
+
+	//lookups in a random order, so that they aren't just a sequential walk
+	std::vector<int> make_lookups()
+	{
+		std::vector<int> keys;
+		for (int i = 0; i < live_orders; ++i)
+		{
+			keys.push_back(i);
+		}
+		std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+		return keys;
+	}
+}
+
+template <typename Index>
+void run_finds(benchmark::State &state, Index &index)
+{
+	for (int i = 0; i < live_orders; ++i)
+	{
+		*index.insert(i) = i;
+	}
+
+	const std::vector<int> keys = make_lookups();
+	for (auto _ : state)
+	{
+		for (const int key : keys)
+		{
+			benchmark::DoNotOptimize(index.find(key));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename Index>
+void BM_index_find(benchmark::State &state)
+{
+	Index index = make_index((Index *)nullptr);
+	run_finds(state, index);
+}
+BENCHMARK_TEMPLATE(BM_index_find, std_index);
+BENCHMARK_TEMPLATE(BM_index_find, hashed_order_index<int>);
+
+//the paged index can't be copied out of a factory
+void BM_index_find_paged(benchmark::State &state)
+{
+	paged_order_index<int> index;
+	run_finds(state, index);
+}
+BENCHMARK(BM_index_find_paged);
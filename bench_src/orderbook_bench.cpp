@@ -0,0 +1,397 @@
+#include "benchmark/benchmark.h"
+
+#include "../src/feed_simulator.hpp"
+#include "../src/message_parser.hpp"
+#include "../src/orderbook.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+//cost of each of the book's operations, against the shape of the book it's run on:
+//how many orders rest in it, how many of them share each level, and how many ticks
+//apart the levels are. each benchmark reports ops per second and the time per op.
+//the resting book is built once per shape and left as it was found by each batch,
+//so the 1m order books only have to be built once per benchmark. the last benchmark
+//replays the simulator's feed into a fresh book, for the operations in a realistic mix
+
+namespace
+{
+	//far enough from zero that a million orders' worth of bid levels stays positive
+	const price_t base_price = 100000000;
+
+	//operations between untimed fix-ups of the book, for those that change its shape
+	const int max_batch = 256;
+
+	struct resting_order
+	{
+		int order_id;
+		side order_side;
+		price_t price;
+	};
+
+	//a book of the given shape, with what's resting in it
+	template <typename Book>
+	struct book_fixture
+	{
+		std::unique_ptr<Book> ob;
+		std::vector<resting_order> orders;
+		std::vector<price_t> levels[2];
+		int next_order_id = 0;
+		std::mt19937 rng;
+	};
+
+	//the book's levels alternate between sides from the touch out, each filled with
+	//its orders before the next is started
+	template <typename Book>
+	std::unique_ptr<book_fixture<Book>> make_fixture(int orders, int per_level, int spread)
+	{
+		std::unique_ptr<book_fixture<Book>> fixture(new book_fixture<Book>);
+		node_pool_options pool_options;
+		pool_options.capacity_bytes = 512 << 20;
+		order_index_options index_options;
+		index_options.expected_orders = orders + max_batch;
+		fixture->ob.reset(new Book(tick_size(), typename Book::level_options(), pool_options, index_options));
+
+		for (int i = 0; i < orders; ++i)
+		{
+			const side s = (i / per_level) % 2 == 0 ? side::bid : side::ask;
+			const price_t offset = (price_t)(i / per_level / 2) * spread;
+			const price_t price = s == side::bid ? base_price - offset : base_price + spread + offset;
+			auto &levels = fixture->levels[(int)s];
+			if (levels.empty() || levels.back() != price)
+			{
+				levels.push_back(price);
+			}
+			fixture->ob->on_order_add(s, i, price, 10);
+			fixture->orders.push_back({i, s, price});
+		}
+		fixture->next_order_id = orders;
+		fixture->rng.seed(1);
+		return fixture;
+	}
+
+	//the book for the benchmark's shape, kept between the library's runs of the same
+	//benchmark since every one of them leaves it as it found it
+	template <typename Book>
+	book_fixture<Book> &fixture_for(const benchmark::State &state)
+	{
+		static std::unique_ptr<book_fixture<Book>> fixture;
+		static int64_t shape[3] = {-1, -1, -1};
+		if (!fixture || shape[0] != state.range(0) || shape[1] != state.range(1) || shape[2] != state.range(2))
+		{
+			//let the old one go first, so that two big books aren't held at once
+			fixture.reset();
+			fixture = make_fixture<Book>(state.range(0), state.range(1), state.range(2));
+			shape[0] = state.range(0);
+			shape[1] = state.range(1);
+			shape[2] = state.range(2);
+		}
+		return *fixture;
+	}
+
+	//batches are no bigger than the book, so that the smallest ones keep their shape
+	int batch_for(const benchmark::State &state)
+	{
+		return std::max<int>(16, std::min<int>(max_batch, state.range(0)));
+	}
+
+	//random picks from a fixture, made up front so that the rng isn't timed
+	template <typename Book>
+	std::vector<size_t> pick_orders(book_fixture<Book> &fixture, size_t count)
+	{
+		std::uniform_int_distribution<size_t> pick(0, fixture.orders.size() - 1);
+		std::vector<size_t> picks(count);
+		for (auto &p : picks)
+		{
+			p = pick(fixture.rng);
+		}
+		return picks;
+	}
+
+	template <typename Book>
+	price_t pick_level(book_fixture<Book> &fixture, side s)
+	{
+		const auto &levels = fixture.levels[(int)s];
+		return levels[std::uniform_int_distribution<size_t>(0, levels.size() - 1)(fixture.rng)];
+	}
+
+	void report(benchmark::State &state, int64_t ops)
+	{
+		state.SetItemsProcessed(ops);
+		state.counters["time_per_op"] = benchmark::Counter(ops, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	}
+
+	//depth from 10 to a million orders with a few to a level on each tick, then at 100k
+	//orders, levels of one order or many, and levels spread further apart
+	void book_shapes(benchmark::internal::Benchmark *b)
+	{
+		b->ArgNames({"orders", "per_level", "spread"});
+		for (const int orders : {10, 1000, 100000, 1000000})
+		{
+			b->Args({orders, 4, 1});
+		}
+		for (const int per_level : {1, 64})
+		{
+			b->Args({100000, per_level, 1});
+		}
+		for (const int spread : {10, 100})
+		{
+			b->Args({100000, 4, spread});
+		}
+	}
+
+	//a run of events from the simulator, as they'd come off the feed
+	std::vector<parsed_message> simulated_feed(int events)
+	{
+		feed_simulator simulator(1);
+		std::vector<parsed_message> feed;
+		while ((int)feed.size() < events)
+		{
+			simulator.step([&feed](const parsed_message &msg)
+			{
+				feed.push_back(msg);
+			});
+		}
+		return feed;
+	}
+}
+
+//new orders joining the back of existing levels, taken out again untimed
+template <typename Book>
+void BM_add(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	const int batch = batch_for(state);
+	std::vector<resting_order> adds;
+	for (int i = 0; i < batch; ++i)
+	{
+		const side s = i % 2 == 0 ? side::bid : side::ask;
+		adds.push_back({fixture.next_order_id + i, s, pick_level(fixture, s)});
+	}
+
+	Book &ob = *fixture.ob;
+	for (auto _ : state)
+	{
+		for (const auto &add : adds)
+		{
+			benchmark::DoNotOptimize(ob.on_order_add(add.order_side, add.order_id, add.price, 10));
+		}
+		state.PauseTiming();
+		for (const auto &add : adds)
+		{
+			ob.on_order_remove(add.order_side, add.order_id);
+		}
+		state.ResumeTiming();
+	}
+	report(state, state.iterations() * batch);
+}
+
+//resting orders taken out from anywhere in their levels, put back untimed
+template <typename Book>
+void BM_remove(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	const int batch = batch_for(state);
+
+	//distinct orders, so that none is removed twice in a batch
+	std::vector<size_t> picks = pick_orders(fixture, batch * 4);
+	std::sort(picks.begin(), picks.end());
+	picks.erase(std::unique(picks.begin(), picks.end()), picks.end());
+	std::shuffle(picks.begin(), picks.end(), fixture.rng);
+	picks.resize(std::min<size_t>(picks.size(), batch));
+
+	Book &ob = *fixture.ob;
+	for (auto _ : state)
+	{
+		for (const size_t p : picks)
+		{
+			const auto &order = fixture.orders[p];
+			benchmark::DoNotOptimize(ob.on_order_remove(order.order_side, order.order_id));
+		}
+		state.PauseTiming();
+		for (const size_t p : picks)
+		{
+			const auto &order = fixture.orders[p];
+			ob.on_order_add(order.order_side, order.order_id, order.price, 10);
+		}
+		state.ResumeTiming();
+	}
+	report(state, state.iterations() * picks.size());
+}
+
+//volume changes in place, which keep the order's time priority
+template <typename Book>
+void BM_modify_volume(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	const std::vector<size_t> picks = pick_orders(fixture, 4096);
+
+	Book &ob = *fixture.ob;
+	size_t i = 0;
+	int volume = 11;
+	for (auto _ : state)
+	{
+		const auto &order = fixture.orders[picks[i]];
+		benchmark::DoNotOptimize(ob.on_order_modify(order.order_side, order.order_id, order.price, volume));
+		if (++i == picks.size())
+		{
+			//every order's volume goes back and forth between two values
+			i = 0;
+			volume = volume == 11 ? 10 : 11;
+		}
+	}
+	for (const size_t p : picks)
+	{
+		const auto &order = fixture.orders[p];
+		ob.on_order_modify(order.order_side, order.order_id, order.price, 10);
+	}
+	report(state, state.iterations());
+}
+
+//orders moved to another existing level on their side, and moved back untimed
+template <typename Book>
+void BM_modify_price(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	const int batch = batch_for(state);
+	std::vector<size_t> picks = pick_orders(fixture, batch * 4);
+	std::sort(picks.begin(), picks.end());
+	picks.erase(std::unique(picks.begin(), picks.end()), picks.end());
+	std::shuffle(picks.begin(), picks.end(), fixture.rng);
+	picks.resize(std::min<size_t>(picks.size(), batch));
+	std::vector<price_t> targets;
+	for (const size_t p : picks)
+	{
+		targets.push_back(pick_level(fixture, fixture.orders[p].order_side));
+	}
+
+	Book &ob = *fixture.ob;
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < picks.size(); ++i)
+		{
+			const auto &order = fixture.orders[picks[i]];
+			benchmark::DoNotOptimize(ob.on_order_modify(order.order_side, order.order_id, targets[i], 10));
+		}
+		state.PauseTiming();
+		for (const size_t p : picks)
+		{
+			const auto &order = fixture.orders[p];
+			ob.on_order_modify(order.order_side, order.order_id, order.price, 10);
+		}
+		state.ResumeTiming();
+	}
+	report(state, state.iterations() * picks.size());
+}
+
+//trades on a book crossed by one order, which only touch the trade stats
+template <typename Book>
+void BM_trade(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	Book &ob = *fixture.ob;
+	const price_t touch = ob.get_best_price(side::ask);
+	const int crossing_id = fixture.next_order_id;
+	ob.on_order_add(side::bid, crossing_id, touch, 10);
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ob.on_trade(touch, 1));
+	}
+	ob.on_order_remove(side::bid, crossing_id);
+	report(state, state.iterations());
+}
+
+//volume looked up at random levels on either side
+template <typename Book>
+void BM_get_volume(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	std::vector<std::pair<side, price_t>> lookups;
+	for (int i = 0; i < 4096; ++i)
+	{
+		const side s = i % 2 == 0 ? side::bid : side::ask;
+		lookups.emplace_back(s, pick_level(fixture, s));
+	}
+
+	const Book &ob = *fixture.ob;
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ob.get_volume(lookups[i].first, lookups[i].second));
+		i = (i + 1) % lookups.size();
+	}
+	report(state, state.iterations());
+}
+
+//the order at a random position on either side; this walks levels from the touch,
+//so it slows with depth, more so the fewer orders there are to a level
+template <typename Book>
+void BM_get_order_in_position(benchmark::State &state)
+{
+	auto &fixture = fixture_for<Book>(state);
+	const Book &ob = *fixture.ob;
+	std::vector<std::pair<side, unsigned>> lookups;
+	for (int i = 0; i < 4096; ++i)
+	{
+		const side s = i % 2 == 0 ? side::bid : side::ask;
+		const unsigned count = std::max(1, ob.get_order_count_on_side(s));
+		lookups.emplace_back(s, std::uniform_int_distribution<unsigned>(0, count - 1)(fixture.rng));
+	}
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ob.get_order_in_position(lookups[i].first, lookups[i].second));
+		i = (i + 1) % lookups.size();
+	}
+	report(state, state.iterations());
+}
+
+#define BOOK_BENCHMARK(name) \
+	BENCHMARK_TEMPLATE(name, orderbook)->Apply(book_shapes); \
+	BENCHMARK_TEMPLATE(name, ladder_orderbook)->Apply(book_shapes)
+
+BOOK_BENCHMARK(BM_add);
+BOOK_BENCHMARK(BM_remove);
+BOOK_BENCHMARK(BM_modify_volume);
+BOOK_BENCHMARK(BM_modify_price);
+BOOK_BENCHMARK(BM_trade);
+BOOK_BENCHMARK(BM_get_volume);
+BOOK_BENCHMARK(BM_get_order_in_position);
+
+//the simulator's feed, its adds, modifies, removes, trades and uncrossing included,
+//replayed into a fresh book
+template <typename Book>
+void BM_simulated_feed(benchmark::State &state)
+{
+	const std::vector<parsed_message> feed = simulated_feed(state.range(0));
+	for (auto _ : state)
+	{
+		//only the operations are timed, not reserving the book's pool and index
+		state.PauseTiming();
+		std::unique_ptr<Book> ob(new Book);
+		state.ResumeTiming();
+
+		for (const auto &msg : feed)
+		{
+			switch (msg.type)
+			{
+			case message_type::add: ob->on_order_add(msg.order_side, msg.order_id, msg.price, msg.volume); break;
+			case message_type::modify: ob->on_order_modify(msg.order_side, msg.order_id, msg.price, msg.volume); break;
+			case message_type::remove: ob->on_order_remove(msg.order_side, msg.order_id); break;
+			case message_type::trade: ob->on_trade(msg.price, msg.volume); break;
+			}
+		}
+		benchmark::DoNotOptimize(ob->get_best_price(side::bid));
+
+		state.PauseTiming();
+		ob.reset();
+		state.ResumeTiming();
+	}
+	report(state, state.iterations() * feed.size());
+}
+BENCHMARK_TEMPLATE(BM_simulated_feed, orderbook)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_simulated_feed, ladder_orderbook)->Arg(100000);
@@ -0,0 +1,82 @@
+#include "benchmark/benchmark.h"
+
+#include "../src/orderbook.hpp"
+
+#include <functional>
+#include <map>
+#include <random>
+#include <vector>
+
+//cost of adding orders to one side of the book. the side's levels used to be kept in
+//a map ordered through a std::function comparator; compare that against the stateless
+//comparator the side policies use now, and against whole-book adds for each backend
+
+namespace
+{
+	const int orders_per_run = 4096;
+
+	//prices spread over a few hundred ticks, as a liquid book would see
+	std::vector<price_t> make_prices(int count)
+	{
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<price_t> offset(-250, 250);
+		std::vector<price_t> prices;
+		prices.reserve(count);
+		for (int i = 0; i < count; ++i)
+		{
+			prices.push_back(10000 + offset(rng));
+		}
+		return prices;
+	}
+
+	bool descending(price_t left, price_t right)
+	{
+		return right < left;
+	}
+
+	typedef std::map<price_t, price_level, std::function<bool(price_t, price_t)>> function_levels;
+	typedef std::map<price_t, price_level, bid_side::compare> policy_levels;
+
+	function_levels make_levels(function_levels *) { return function_levels(descending); }
+	policy_levels make_levels(policy_levels *) { return policy_levels(); }
+}
+
+//a level lookup-or-insert for each add, the tree work an add does
+template <typename Levels>
+void BM_level_insert(benchmark::State &state)
+{
+	const std::vector<price_t> prices = make_prices(orders_per_run);
+	for (auto _ : state)
+	{
+		Levels levels = make_levels((Levels *)nullptr);
+		for (const price_t price : prices)
+		{
+			++levels.emplace(price, price_level()).first->second.order_count;
+		}
+		benchmark::DoNotOptimize(levels.size());
+	}
+	state.SetItemsProcessed(state.iterations() * prices.size());
+}
+BENCHMARK_TEMPLATE(BM_level_insert, function_levels);
+BENCHMARK_TEMPLATE(BM_level_insert, policy_levels);
+
+//adds through the book's public interface, alternating sides
+template <typename Book>
+void BM_book_add(benchmark::State &state)
+{
+	const std::vector<price_t> prices = make_prices(orders_per_run);
+	for (auto _ : state)
+	{
+		Book ob;
+		for (int i = 0; i < orders_per_run; ++i)
+		{
+			//keep the sides apart so the book doesn't cross
+			const bool bid = (i & 1) != 0;
+			ob.on_order_add(bid ? side::bid : side::ask, i, prices[i] + (bid ? -300 : 300), 10);
+		}
+		benchmark::DoNotOptimize(ob.get_best_price(side::bid));
+	}
+	state.SetItemsProcessed(state.iterations() * orders_per_run);
+}
+BENCHMARK_TEMPLATE(BM_book_add, orderbook);
+BENCHMARK_TEMPLATE(BM_book_add, ladder_orderbook);
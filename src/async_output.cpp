@@ -0,0 +1,215 @@
+#include "async_output.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+async_output::async_output(std::ostream &os, tick_size ticks, size_t capacity)
+		: ring_(capacity),
+		  out_(os),
+		  ticks_(ticks)
+{
+	writer_ = std::thread(&async_output::run, this);
+}
+
+async_output::~async_output()
+{
+	flush();
+	stopping_.store(true, std::memory_order_release);
+	writer_.join();
+}
+
+void async_output::line(const char *text, size_t len)
+{
+	output_record record;
+	record.type = output_record::kind::line_part;
+	while (len > output_record::max_text)
+	{
+		record.count = output_record::max_text;
+		memcpy(record.text, text, output_record::max_text);
+		ring_.push(record);
+		text += output_record::max_text;
+		len -= output_record::max_text;
+	}
+
+	record.type = output_record::kind::line;
+	record.count = static_cast<uint8_t>(len);
+	memcpy(record.text, text, len);
+	ring_.push(record);
+}
+
+void async_output::midpoint(double value)
+{
+	output_record record;
+	record.type = output_record::kind::midpoint;
+	record.midpoint = value;
+	ring_.push(record);
+}
+
+void async_output::trade(uint64_t cumulative_volume, price_t price)
+{
+	output_record record;
+	record.type = output_record::kind::trade;
+	record.trade.price = price;
+	record.trade.cumulative_volume = cumulative_volume;
+	ring_.push(record);
+}
+
+void async_output::unparsable()
+{
+	output_record record;
+	record.type = output_record::kind::unparsable;
+	ring_.push(record);
+}
+
+void async_output::book_begin(const std::string &symbol)
+{
+	//symbols are far shorter than a record's text
+	output_record record;
+	record.type = output_record::kind::book_begin;
+	record.count = static_cast<uint8_t>(std::min<size_t>(symbol.size(), output_record::max_text));
+	memcpy(record.text, symbol.data(), record.count);
+	ring_.push(record);
+	level_.count = 0;
+}
+
+void async_output::book_order(side s, price_t price, int volume)
+{
+	//orders at the same price on the same side share a record until it's full
+	if (level_.count != 0 && (level_.count == output_record::max_volumes || level_.order_side != s || level_.level.price != price))
+	{
+		push_level();
+	}
+	if (level_.count == 0)
+	{
+		level_.type = output_record::kind::book_level;
+		level_.order_side = s;
+		level_.level.price = price;
+	}
+	level_.level.volumes[level_.count++] = volume;
+}
+
+void async_output::book_end()
+{
+	if (level_.count != 0)
+	{
+		push_level();
+	}
+	output_record record;
+	record.type = output_record::kind::book_end;
+	ring_.push(record);
+}
+
+void async_output::depth_begin(const std::string &symbol, bool update)
+{
+	output_record record;
+	record.type = update ? output_record::kind::depth_update_begin : output_record::kind::depth_begin;
+	record.count = static_cast<uint8_t>(std::min<size_t>(symbol.size(), output_record::max_text));
+	memcpy(record.text, symbol.data(), record.count);
+	ring_.push(record);
+}
+
+void async_output::depth_price(side s, const depth_level &level)
+{
+	output_record record;
+	record.type = output_record::kind::depth_level;
+	record.order_side = s;
+	record.depth.price = level.price;
+	record.depth.volume = level.volume;
+	record.depth.order_count = level.order_count;
+	ring_.push(record);
+}
+
+void async_output::depth_end()
+{
+	output_record record;
+	record.type = output_record::kind::depth_end;
+	ring_.push(record);
+}
+
+void async_output::flush()
+{
+	output_record record;
+	record.type = output_record::kind::flush;
+	ring_.push(record);
+
+	//the writer only pops a record once it's done with it
+	ring_.wait_until_empty();
+}
+
+void async_output::push_level()
+{
+	ring_.push(level_);
+	level_.count = 0;
+}
+
+void async_output::run()
+{
+	for (;;)
+	{
+		output_record *record = ring_.front();
+		if (!record)
+		{
+			//the producer only stops once the ring has been drained
+			if (stopping_.load(std::memory_order_acquire))
+			{
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+		write(*record);
+		ring_.pop();
+	}
+	out_.flush();
+}
+
+void async_output::write(const output_record &record)
+{
+	switch (record.type)
+	{
+	case output_record::kind::line_part:
+		out_.write(record.text, record.count);
+		break;
+	case output_record::kind::line:
+		out_.write(record.text, record.count);
+		out_ << ": ";
+		break;
+	case output_record::kind::midpoint:
+		write_midpoint(out_, record.midpoint);
+		break;
+	case output_record::kind::trade:
+		write_trade(out_, record.trade.cumulative_volume, ticks_.to_price(record.trade.price));
+		break;
+	case output_record::kind::unparsable:
+		write_unparsable(out_);
+		break;
+	case output_record::kind::book_begin:
+		write_book_header(out_, record.text, record.count);
+		book_.emplace(out_, ticks_);
+		break;
+	case output_record::kind::book_level:
+		for (unsigned i = 0; i < record.count; ++i)
+		{
+			book_->order(record.order_side, record.level.price, record.level.volumes[i]);
+		}
+		break;
+	case output_record::kind::book_end:
+		book_->finish();
+		book_.reset();
+		write_book_footer(out_);
+		break;
+	case output_record::kind::depth_begin:
+	case output_record::kind::depth_update_begin:
+		write_depth_header(out_, record.text, record.count, record.type == output_record::kind::depth_update_begin);
+		break;
+	case output_record::kind::depth_level:
+		write_depth_level(out_, record.order_side, ticks_.to_price(record.depth.price), record.depth.volume, record.depth.order_count);
+		break;
+	case output_record::kind::depth_end:
+		write_book_footer(out_);
+		break;
+	case output_record::kind::flush:
+		out_.flush();
+		break;
+	}
+}
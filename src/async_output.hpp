@@ -0,0 +1,150 @@
+#ifndef __ASYNC_OUTPUT_H__
+#define __ASYNC_OUTPUT_H__
+
+#include "book_depth.hpp"
+#include "enums.hpp"
+#include "feed_output.hpp"
+#include "output_sink.hpp"
+#include "price.hpp"
+#include "spsc_ring.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <optional>
+#include <thread>
+
+//one fixed-size entry in the async output ring: the raw values behind a piece of the
+//feedhandler's output, before any of it has been formatted
+struct output_record
+{
+	enum class kind : uint8_t
+	{
+		line_part,	//part of an echoed line, more to follow
+		line,		//the end of an echoed line, followed by ": "
+		midpoint,
+		trade,
+		unparsable,
+		book_begin,	//with the book's symbol, if it has one
+		book_level,	//some of the orders at one price on one side, in print order
+		book_end,
+		depth_begin,	//with the book's symbol, if it has one
+		depth_update_begin,
+		depth_level,
+		depth_end,
+		flush		//hand everything written so far to the stream
+	};
+
+	static constexpr unsigned max_text = 56;
+	static constexpr unsigned max_volumes = 12;
+
+	kind type = kind::flush;
+	uint8_t count = 0;	//bytes of text, or volumes in a book level
+	side order_side = side::bid;
+
+	union
+	{
+		char text[max_text];
+		double midpoint;
+		struct
+		{
+			price_t price;
+			uint64_t cumulative_volume;
+		} trade;
+		struct
+		{
+			price_t price;
+			int32_t volumes[max_volumes];
+		} level;
+		struct
+		{
+			price_t price;
+			int32_t volume;
+			int32_t order_count;
+		} depth;
+	};
+};
+static_assert(sizeof(output_record) == 64, "output records should fill a cache line");
+
+//takes formatting and writing off the thread that applies book updates. the producer
+//pushes output_records into a single-producer/single-consumer ring and a writer
+//thread formats them into its own output_sink in front of the stream.
+//
+//when the ring is full the producer waits until there's room, which shows up in the
+//ring's stats
+class async_output
+{
+public:
+	typedef spsc_ring<output_record>::producer_stats stats;
+
+	static constexpr size_t default_capacity = 1 << 16;
+
+	async_output(std::ostream &os, tick_size ticks, size_t capacity = default_capacity);
+
+	//drains anything outstanding, then stops the writer
+	~async_output();
+
+	async_output(const async_output &) = delete;
+	async_output &operator=(const async_output &) = delete;
+
+	//producer side; these must all be called from the one thread
+
+	//echo the input line, followed by ": "
+	void line(const char *text, size_t len);
+
+	void midpoint(double value);
+	void trade(uint64_t cumulative_volume, price_t price);
+	void unparsable();
+
+	//a dump of the whole book, as print_ob would print it, headed with its symbol
+	//unless that's empty
+	template <typename Book>
+	void book(const Book &ob, const std::string &symbol)
+	{
+		book_begin(symbol);
+		ob.for_each_order_by_price([this](side s, price_t price, int volume)
+		{
+			book_order(s, price, volume);
+		});
+		book_end();
+	}
+
+	//a depth snapshot or update, a level at a time in print order
+	void depth_begin(const std::string &symbol, bool update);
+	void depth_price(side s, const depth_level &level);
+	void depth_end();
+
+	//wait until everything pushed so far has been written and flushed to the stream
+	void flush();
+
+	//only stable while the producer isn't pushing
+	const stats &get_stats() const { return ring_.get_producer_stats(); }
+
+private: //methods
+	void book_begin(const std::string &symbol);
+	void book_order(side s, price_t price, int volume);
+	void book_end();
+
+	void push_level();
+
+	//writer thread
+	void run();
+	void write(const output_record &record);
+
+private: //state
+	spsc_ring<output_record> ring_;
+
+	//the book level being filled in by book_order
+	output_record level_;
+
+	//only touched by the writer thread once it's started
+	output_sink out_;
+	const tick_size ticks_;
+	std::optional<book_printer<output_sink>> book_;
+
+	std::atomic<bool> stopping_{false};
+	std::thread writer_;
+};
+
+#endif
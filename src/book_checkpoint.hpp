@@ -0,0 +1,285 @@
+#ifndef __BOOK_CHECKPOINT_H__
+#define __BOOK_CHECKPOINT_H__
+
+#include "capture_format.hpp"
+#include "enums.hpp"
+#include "mapped_file.hpp"
+#include "price.hpp"
+#include "price_level.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//the state of a feedhandler's books part way through a feed, so that a restart can
+//pick up from there rather than replaying the feed from the start. laid out as:
+//  checkpoint_header
+//  book_count books, each a checkpoint_book followed by its bid_orders bids and then
+//  its ask_orders asks as checkpoint_orders, each side from its best level out and
+//  in time priority within a level
+//  symbol_count symbols of capture_symbol_bytes each, as in a capture
+//everything is 8 byte aligned, so a mapped checkpoint's orders are read in place
+//and go straight back into a book in the order they have to be queued in.
+
+static const char checkpoint_magic[8] = {'F', 'H', 'C', 'H', 'K', 'P', 'N', 'T'};
+static const uint32_t checkpoint_version = 1;
+
+//what a checkpoint's input offset counts
+enum class checkpoint_offset : uint32_t
+{
+	bytes,		//into a text feed, to the end of the last line applied
+	records		//of a capture, applied
+};
+
+struct checkpoint_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t tick_decimals;
+	uint64_t input_offset;
+	checkpoint_offset offset_kind;
+	uint32_t book_count;
+	uint32_t symbol_count;	//0 for a single instrument feed
+	int32_t unparsable;
+	int32_t unknown_instruments;
+	int32_t messages_since_print;	//towards the next time the book's printed
+	uint64_t size;	//of the whole checkpoint
+	uint8_t reserved[8];
+};
+static_assert(sizeof(checkpoint_header) == 64, "the checkpoint header is 64 bytes");
+
+//a book's stats, and those the feedhandler keeps for its instrument
+struct checkpoint_book
+{
+	uint64_t bid_orders;
+	uint64_t ask_orders;
+	int64_t last_trade_price;
+	uint64_t cumulative_trade_volume;
+	int32_t duplicate_order_ids;
+	int32_t trade_without_order;
+	int32_t removes_without_order;
+	int32_t modifies_without_order;
+	int32_t crossed_book_no_trades;
+	int32_t invalid_inputs;
+	int32_t messages;
+	int32_t unparsable;
+	int32_t trades;
+	int32_t reserved;
+	uint64_t traded_volume;
+};
+static_assert(sizeof(checkpoint_book) == 80, "checkpoint books are 80 bytes");
+
+struct checkpoint_order
+{
+	int32_t order_id;
+	int32_t volume;
+	int64_t price;	//in ticks
+};
+static_assert(sizeof(checkpoint_order) == 16, "checkpoint orders are 16 bytes");
+
+//builds a checkpoint in memory, which is as long as whatever's feeding the books
+//has to wait; writing it out can be left to another thread
+class checkpoint_builder
+{
+public:
+	//start again, dropping anything built so far but keeping the memory
+	void begin(const tick_size &ticks, uint64_t input_offset, checkpoint_offset offset_kind)
+	{
+		image_.clear();
+		checkpoint_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+		header.version = checkpoint_version;
+		header.tick_decimals = ticks.decimals();
+		header.input_offset = input_offset;
+		header.offset_kind = offset_kind;
+		append(header);
+	}
+
+	//the feed's counters, which can be set any time before end
+	checkpoint_header &header() { return *reinterpret_cast<checkpoint_header *>(image_.data()); }
+
+	//the book's orders and stats, with its instrument's stats already filled in
+	template <typename Book>
+	void add_book(const Book &ob, checkpoint_book stats)
+	{
+		stats.bid_orders = ob.get_order_count_on_side(side::bid);
+		stats.ask_orders = ob.get_order_count_on_side(side::ask);
+		stats.last_trade_price = ob.get_current_trade_stats().last_trade_price;
+		stats.cumulative_trade_volume = ob.get_current_trade_stats().cumulative_trade_volume;
+		const auto &errors = ob.get_error_stats();
+		stats.duplicate_order_ids = errors.duplicate_order_ids;
+		stats.trade_without_order = errors.trade_without_order;
+		stats.removes_without_order = errors.removes_without_order;
+		stats.modifies_without_order = errors.modifies_without_order;
+		stats.crossed_book_no_trades = errors.crossed_book_no_trades;
+		stats.invalid_inputs = errors.invalid_inputs;
+		append(stats);
+
+		//sized up front so each order is a copy into place
+		size_t at = image_.size();
+		image_.resize(at + (stats.bid_orders + stats.ask_orders) * sizeof(checkpoint_order));
+		const auto add_level = [this, &at](price_t price, const price_level &level)
+		{
+			for (const auto &order : level.orders)
+			{
+				const checkpoint_order saved = {order.order_id, order.volume, price};
+				memcpy(image_.data() + at, &saved, sizeof(saved));
+				at += sizeof(saved);
+			}
+			return true;
+		};
+		ob.bids().for_each_level(add_level);
+		ob.asks().for_each_level(add_level);
+		++header().book_count;
+	}
+
+	//add the symbols and the finished size; the checkpoint's then in image()
+	void end(const std::vector<std::string> &symbols)
+	{
+		for (const auto &symbol : symbols)
+		{
+			char padded[capture_symbol_bytes] = {};
+			memcpy(padded, symbol.data(), std::min(symbol.size(), capture_symbol_bytes));
+			image_.insert(image_.end(), padded, padded + sizeof(padded));
+		}
+		header().symbol_count = symbols.size();
+		header().size = image_.size();
+	}
+
+	const std::vector<char> &image() const { return image_; }
+
+private: //methods
+	template <typename T>
+	void append(const T &value)
+	{
+		const char *bytes = reinterpret_cast<const char *>(&value);
+		image_.insert(image_.end(), bytes, bytes + sizeof(value));
+	}
+
+private: //state
+	std::vector<char> image_;
+};
+
+//write a built checkpoint to the file, by way of a temporary file beside it so that
+//there's always a whole checkpoint under the name. returns false if it can't be written
+inline bool write_checkpoint(const char *filename, const std::vector<char> &image)
+{
+	const std::string temporary = std::string(filename) + ".tmp";
+	std::ofstream os(temporary, std::ios::binary | std::ios::trunc);
+	os.write(image.data(), image.size());
+	os.close();
+	if (os.fail() || rename(temporary.c_str(), filename) != 0)
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+//a checkpoint mapped into memory, with its orders read in place
+class checkpoint_reader
+{
+public:
+	//returns false if the file can't be mapped or isn't a checkpoint we can read
+	bool open(const char *filename)
+	{
+		if (!file_.open(filename) || file_.size() < sizeof(checkpoint_header))
+		{
+			return false;
+		}
+
+		memcpy(&header_, file_.data(), sizeof(header_));
+		if (memcmp(header_.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0
+				|| header_.version != checkpoint_version
+				|| header_.tick_decimals > (uint32_t)tick_size::max_decimals
+				|| (header_.offset_kind != checkpoint_offset::bytes && header_.offset_kind != checkpoint_offset::records)
+				|| header_.size != file_.size())
+		{
+			return false;
+		}
+
+		//find the books, checking that each one and then the symbols fit in the file
+		books_.clear();
+		uint64_t offset = sizeof(checkpoint_header);
+		for (uint32_t i = 0; i < header_.book_count; ++i)
+		{
+			if (header_.size - offset < sizeof(checkpoint_book))
+			{
+				return false;
+			}
+			const checkpoint_book &book = *reinterpret_cast<const checkpoint_book *>(file_.data() + offset);
+			offset += sizeof(checkpoint_book);
+			const uint64_t room = (header_.size - offset) / sizeof(checkpoint_order);
+			if (book.bid_orders > room || book.ask_orders > room - book.bid_orders)
+			{
+				return false;
+			}
+			books_.push_back(&book);
+			offset += (book.bid_orders + book.ask_orders) * sizeof(checkpoint_order);
+		}
+		symbols_offset_ = offset;
+		return header_.symbol_count <= (header_.size - offset) / capture_symbol_bytes;
+	}
+
+	const checkpoint_header &header() const { return header_; }
+	tick_size ticks() const { return tick_size(header_.tick_decimals); }
+
+	size_t book_count() const { return books_.size(); }
+	const checkpoint_book &book(size_t i) const { return *books_[i]; }
+
+	//a book's bids, then its asks
+	const checkpoint_order *orders(size_t i) const { return reinterpret_cast<const checkpoint_order *>(books_[i] + 1); }
+
+	size_t symbol_count() const { return header_.symbol_count; }
+	const char *symbol(size_t i) const { return file_.data() + symbols_offset_ + i * capture_symbol_bytes; }
+	size_t symbol_length(size_t i) const { return strnlen(symbol(i), capture_symbol_bytes); }
+
+private: //state
+	mapped_file file_;
+	checkpoint_header header_;
+	std::vector<const checkpoint_book *> books_;
+	uint64_t symbols_offset_ = 0;
+};
+
+//put the reader's ith book back into an empty book. returns false if the book isn't
+//empty or the orders can't all go back in, which leaves it part restored
+template <typename Book>
+bool restore_book(Book &ob, const checkpoint_reader &checkpoint, size_t i)
+{
+	if (ob.get_order_count_on_side(side::bid) != 0 || ob.get_order_count_on_side(side::ask) != 0)
+	{
+		return false;
+	}
+
+	const checkpoint_book &saved = checkpoint.book(i);
+	const checkpoint_order *orders = checkpoint.orders(i);
+	for (uint64_t n = 0; n < saved.bid_orders + saved.ask_orders; ++n)
+	{
+		const side s = n < saved.bid_orders ? side::bid : side::ask;
+		if (!ob.restore_order(s, orders[n].order_id, orders[n].price, orders[n].volume))
+		{
+			return false;
+		}
+	}
+
+	typename Book::trade_stats trades;
+	trades.last_trade_price = saved.last_trade_price;
+	trades.cumulative_trade_volume = saved.cumulative_trade_volume;
+	typename Book::error_stats errors;
+	errors.duplicate_order_ids = saved.duplicate_order_ids;
+	errors.trade_without_order = saved.trade_without_order;
+	errors.removes_without_order = saved.removes_without_order;
+	errors.modifies_without_order = saved.modifies_without_order;
+	errors.crossed_book_no_trades = saved.crossed_book_no_trades;
+	errors.invalid_inputs = saved.invalid_inputs;
+	ob.end_restore(trades, errors);
+	return true;
+}
+
+#endif
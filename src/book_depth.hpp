@@ -0,0 +1,135 @@
+#ifndef __BOOK_DEPTH_H__
+#define __BOOK_DEPTH_H__
+
+#include "enums.hpp"
+#include "price.hpp"
+#include "price_level.hpp"
+#include "side_policy.hpp"
+
+#include <cstddef>
+#include <vector>
+
+//one price of a depth snapshot, with the orders there added up
+struct depth_level
+{
+	price_t price = 0;
+	int volume = 0;
+	int order_count = 0;
+
+	bool operator==(const depth_level &other) const
+	{
+		return price == other.price && volume == other.volume && order_count == other.order_count;
+	}
+	bool operator!=(const depth_level &other) const { return !(*this == other); }
+};
+
+//the best few levels of each side of a book, best first. the book tells us about every
+//level it changes; a change at or better than the worst level we hold, or on a side
+//with fewer levels than we hold, marks that side stale, and a stale side is re-read
+//from the book's levels the next time it's asked for. a change further out costs a
+//compare, and a refresh costs a walk of the levels we hold, so a snapshot costs at
+//most the number of levels however deep the book is
+class book_depth
+{
+public:
+	explicit book_depth(size_t levels = 0)
+		: levels_(levels)
+	{
+
+	}
+
+	//0 if depth isn't being kept
+	size_t levels() const { return levels_; }
+
+	void set_levels(size_t levels)
+	{
+		levels_ = levels;
+		stale_[0] = stale_[1] = true;
+	}
+
+	template <typename Side>
+	void on_level_change(price_t price)
+	{
+		const int s = (int)Side::value;
+		if (!stale_[s] && (sides_[s].size() < levels_ || !Side::better(sides_[s].back().price, price)))
+		{
+			stale_[s] = true;
+		}
+	}
+
+	bool is_stale(side s) const { return stale_[(int)s]; }
+
+	//re-read the side from its levels, which are walked best first
+	template <typename SideLevels>
+	void refresh(side s, const SideLevels &levels)
+	{
+		std::vector<depth_level> &held = sides_[(int)s];
+		held.clear();
+		const size_t wanted = levels_;
+		levels.for_each_level([&held, wanted](price_t price, const price_level &level)
+		{
+			if (held.size() == wanted)
+			{
+				return false;
+			}
+			depth_level depth;
+			depth.price = price;
+			depth.volume = level.total_volume;
+			depth.order_count = level.order_count;
+			held.push_back(depth);
+			return true;
+		});
+		stale_[(int)s] = false;
+		++refreshes_;
+	}
+
+	//only current if the side isn't stale
+	const std::vector<depth_level> &side_levels(side s) const { return sides_[(int)s]; }
+
+	//how many times a side has been re-read
+	size_t refreshes() const { return refreshes_; }
+
+private: //state
+	size_t levels_;
+	std::vector<depth_level> sides_[2];
+	bool stale_[2] = {true, true};
+	size_t refreshes_ = 0;
+};
+
+//call f(const depth_level &) for each level of one side that differs between two of
+//its snapshots, best first: a level that's new or has changed as it is now, and one
+//that's gone with no volume or orders
+template <typename F>
+void for_each_depth_change(side s, const std::vector<depth_level> &before, const std::vector<depth_level> &after, F f)
+{
+	const auto better = [s](price_t left, price_t right)
+	{
+		return s == side::bid ? bid_side::better(left, right) : ask_side::better(left, right);
+	};
+
+	size_t i = 0, j = 0;
+	while (i < before.size() || j < after.size())
+	{
+		if (j == after.size() || (i < before.size() && better(before[i].price, after[j].price)))
+		{
+			depth_level gone;
+			gone.price = before[i++].price;
+			f(gone);
+		}
+		else if (i == before.size() || better(after[j].price, before[i].price))
+		{
+			f(after[j++]);
+		}
+		else
+		{
+			if (before[i] != after[j])
+			{
+				f(after[j]);
+			}
+			++i;
+			++j;
+		}
+	}
+}
+
+#endif
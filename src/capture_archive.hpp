@@ -0,0 +1,407 @@
+#ifndef __CAPTURE_ARCHIVE_H__
+#define __CAPTURE_ARCHIVE_H__
+
+#include "capture_format.hpp"
+#include "mapped_file.hpp"
+#include "price.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//compressed form of a capture, for keeping feeds around. laid out as:
+//  archive_header
+//  block_count blocks, each an archive_block_header and then its encoded records
+//  block_count uint64 offsets of the blocks, from index_offset
+//  symbol_count symbols of capture_symbol_bytes each, as in a capture
+//
+//a record is a head byte and then varints:
+//  head         bits 0-1 the type (add, modify, remove, trade), bit 2 the side, bit 3
+//               set if the instrument isn't the previous record's
+//  instrument   if it changed
+//  order id     zigzag, less the previous order id; not there for trades, whose
+//               ids are 0
+//  volume       zigzag
+//  price        zigzag ticks, less the previous price on the same side, with trades
+//               kept apart from both sides
+//the previous id, prices and instrument all start at 0 in each block, so any block
+//can be decoded without the ones before it, and blocks can be decoded in parallel.
+
+static const char archive_magic[8] = {'F', 'H', 'A', 'R', 'C', 'H', 'I', 'V'};
+static const uint32_t archive_version = 1;
+
+struct archive_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t tick_decimals;
+	uint64_t record_count;
+	uint64_t block_count;
+	uint64_t index_offset;
+	uint64_t symbols_offset;
+	uint32_t symbol_count;	//0 for a single instrument feed
+	uint32_t block_records;	//most records in a block
+	uint8_t reserved[8];
+};
+static_assert(sizeof(archive_header) == 64, "the archive header is 64 bytes");
+
+struct archive_block_header
+{
+	uint32_t bytes;	//of encoded records following
+	uint32_t records;
+};
+
+inline uint64_t zigzag_encode(int64_t n)
+{
+	return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t n)
+{
+	return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+//appends n in 7 bit groups, low first, with the top bit set on all but the last
+inline void write_varint(std::vector<uint8_t> &out, uint64_t n)
+{
+	while (n >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(n) | 0x80);
+		n >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(n));
+}
+
+//returns false if the varint runs past the end or is longer than a uint64 needs
+inline bool read_varint(const uint8_t *&p, const uint8_t *end, uint64_t &n)
+{
+	n = 0;
+	for (int shift = 0; shift < 64 && p != end; shift += 7)
+	{
+		const uint8_t byte = *p++;
+		n |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (byte < 0x80)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//what each record is coded against; reset at the start of every block
+class archive_coding_state
+{
+public:
+	void reset()
+	{
+		order_id_ = 0;
+		instrument_ = 0;
+		prices_[0] = prices_[1] = prices_[2] = 0;
+	}
+
+	//turns records into bytes
+	void encode(const capture_record &record, std::vector<uint8_t> &out)
+	{
+		const int type = type_code(record.type);
+		uint8_t head = static_cast<uint8_t>(type | (record.order_side & 1) << 2);
+		if (record.instrument != instrument_)
+		{
+			head |= instrument_changed;
+		}
+		out.push_back(head);
+		if (record.instrument != instrument_)
+		{
+			write_varint(out, record.instrument);
+			instrument_ = record.instrument;
+		}
+
+		if (type != trade_code)
+		{
+			write_varint(out, zigzag_encode(static_cast<int64_t>(record.order_id) - order_id_));
+			order_id_ = record.order_id;
+		}
+		write_varint(out, zigzag_encode(record.volume));
+
+		//differences are taken mod 2^64 so that any two prices have one
+		int64_t &previous = prices_[type == trade_code ? 2 : record.order_side & 1];
+		write_varint(out, zigzag_encode(static_cast<int64_t>(static_cast<uint64_t>(record.price) - static_cast<uint64_t>(previous))));
+		previous = record.price;
+	}
+
+	//turns bytes back into records; returns false if they don't make one
+	bool decode(const uint8_t *&p, const uint8_t *end, capture_record &record)
+	{
+		static const uint8_t type_letters[] = {'A', 'M', 'X', 'T'};
+
+		if (p == end || (*p & ~head_bits) != 0)
+		{
+			return false;
+		}
+		const uint8_t head = *p++;
+		const int type = head & 3;
+		record.type = type_letters[type];
+		record.order_side = (head >> 2) & 1;
+		record.reserved = 0;
+
+		uint64_t n;
+		if (head & instrument_changed)
+		{
+			if (!read_varint(p, end, n) || n > UINT16_MAX)
+			{
+				return false;
+			}
+			instrument_ = static_cast<uint16_t>(n);
+		}
+		record.instrument = instrument_;
+
+		record.order_id = 0;
+		if (type != trade_code)
+		{
+			if (!read_varint(p, end, n))
+			{
+				return false;
+			}
+			order_id_ += zigzag_decode(n);
+			record.order_id = static_cast<int32_t>(order_id_);
+		}
+
+		if (!read_varint(p, end, n))
+		{
+			return false;
+		}
+		record.volume = static_cast<int32_t>(zigzag_decode(n));
+
+		if (!read_varint(p, end, n))
+		{
+			return false;
+		}
+		int64_t &previous = prices_[type == trade_code ? 2 : record.order_side];
+		previous = static_cast<int64_t>(static_cast<uint64_t>(previous) + static_cast<uint64_t>(zigzag_decode(n)));
+		record.price = previous;
+		return true;
+	}
+
+private: //methods
+	static int type_code(uint8_t type)
+	{
+		switch (type)
+		{
+		case 'A': return 0;
+		case 'M': return 1;
+		case 'X': return 2;
+		default: return trade_code;
+		}
+	}
+
+private: //state
+	static const int trade_code = 3;
+	static const uint8_t instrument_changed = 1 << 3;
+	static const uint8_t head_bits = 0x0f;
+
+	int64_t order_id_ = 0;
+	uint16_t instrument_ = 0;
+
+	//bid, ask, trade
+	int64_t prices_[3] = {0, 0, 0};
+};
+
+//writes an archive, a block at a time
+class archive_writer
+{
+public:
+	static const uint32_t default_block_records = 4096;
+
+	archive_writer() = default;
+
+	//returns false if the file can't be created
+	bool open(const char *filename, const tick_size &ticks, uint32_t block_records = default_block_records)
+	{
+		os_.open(filename, std::ios::binary | std::ios::trunc);
+		if (!os_)
+		{
+			return false;
+		}
+
+		memset(&header_, 0, sizeof(header_));
+		memcpy(header_.magic, archive_magic, sizeof(archive_magic));
+		header_.version = archive_version;
+		header_.tick_decimals = ticks.decimals();
+		header_.block_records = block_records ? block_records : 1;
+		os_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+		offset_ = sizeof(header_);
+		offsets_.clear();
+		block_.clear();
+		records_in_block_ = 0;
+		state_.reset();
+		return true;
+	}
+
+	void add(const capture_record &record)
+	{
+		state_.encode(record, block_);
+		++header_.record_count;
+		if (++records_in_block_ == header_.block_records)
+		{
+			drain();
+		}
+	}
+
+	//write the last block, the index, the symbols and the finished header; returns
+	//false if anything failed to be written
+	bool close(const std::vector<std::string> &symbols)
+	{
+		drain();
+		header_.block_count = offsets_.size();
+		header_.index_offset = offset_;
+		os_.write(reinterpret_cast<const char *>(offsets_.data()), offsets_.size() * sizeof(uint64_t));
+		header_.symbols_offset = offset_ + offsets_.size() * sizeof(uint64_t);
+		header_.symbol_count = symbols.size();
+		for (const auto &symbol : symbols)
+		{
+			char padded[capture_symbol_bytes] = {};
+			memcpy(padded, symbol.data(), std::min(symbol.size(), capture_symbol_bytes));
+			os_.write(padded, sizeof(padded));
+		}
+		os_.seekp(0);
+		os_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+		os_.close();
+		return !os_.fail();
+	}
+
+	uint64_t record_count() const { return header_.record_count; }
+
+private: //methods
+	void drain()
+	{
+		if (records_in_block_ == 0)
+		{
+			return;
+		}
+		archive_block_header block;
+		block.bytes = block_.size();
+		block.records = records_in_block_;
+		os_.write(reinterpret_cast<const char *>(&block), sizeof(block));
+		os_.write(reinterpret_cast<const char *>(block_.data()), block_.size());
+		offsets_.push_back(offset_);
+		offset_ += sizeof(block) + block_.size();
+
+		block_.clear();
+		records_in_block_ = 0;
+		state_.reset();
+	}
+
+private: //state
+	std::ofstream os_;
+	archive_header header_;
+	uint64_t offset_ = 0;
+	std::vector<uint64_t> offsets_;
+
+	//the block being built
+	std::vector<uint8_t> block_;
+	uint32_t records_in_block_ = 0;
+	archive_coding_state state_;
+};
+
+//an archive mapped into memory. blocks are decoded straight out of the mapping, and
+//as decoding doesn't change the reader, different blocks can be decoded on
+//different threads at once
+class archive_reader
+{
+public:
+	//returns false if the file can't be mapped or isn't an archive we can read
+	bool open(const char *filename)
+	{
+		if (!file_.open(filename) || file_.size() < sizeof(archive_header))
+		{
+			return false;
+		}
+
+		memcpy(&header_, file_.data(), sizeof(header_));
+		if (memcmp(header_.magic, archive_magic, sizeof(archive_magic)) != 0
+				|| header_.version != archive_version
+				|| header_.tick_decimals > (uint32_t)tick_size::max_decimals)
+		{
+			return false;
+		}
+
+		//the index and symbols have to be within the file; the blocks are checked
+		//as they're decoded
+		const uint64_t size = file_.size();
+		if (header_.index_offset < sizeof(archive_header) || header_.index_offset > size
+				|| header_.block_count > (size - header_.index_offset) / sizeof(uint64_t)
+				|| header_.symbols_offset > size
+				|| header_.symbol_count > (size - header_.symbols_offset) / capture_symbol_bytes)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	tick_size ticks() const { return tick_size(header_.tick_decimals); }
+	uint64_t record_count() const { return header_.record_count; }
+	uint64_t block_count() const { return header_.block_count; }
+
+	//bytes of the file taken up by the blocks
+	uint64_t block_bytes() const { return header_.index_offset - sizeof(archive_header); }
+
+	size_t symbol_count() const { return header_.symbol_count; }
+	const char *symbol(size_t i) const { return file_.data() + header_.symbols_offset + i * capture_symbol_bytes; }
+	size_t symbol_length(size_t i) const { return strnlen(symbol(i), capture_symbol_bytes); }
+
+	//call cb(const capture_record &) for each record in the block in turn
+	//returns false, having stopped, if the block is damaged
+	template <typename Callback>
+	bool for_each_record(uint64_t block, Callback cb) const
+	{
+		uint64_t offset;
+		memcpy(&offset, file_.data() + header_.index_offset + block * sizeof(uint64_t), sizeof(offset));
+		archive_block_header bh;
+		if (offset < sizeof(archive_header) || offset > header_.index_offset - sizeof(bh))
+		{
+			return false;
+		}
+		memcpy(&bh, file_.data() + offset, sizeof(bh));
+		if (bh.bytes > header_.index_offset - offset - sizeof(bh))
+		{
+			return false;
+		}
+
+		const uint8_t *p = reinterpret_cast<const uint8_t *>(file_.data() + offset + sizeof(bh));
+		const uint8_t *const end = p + bh.bytes;
+		archive_coding_state state;
+		capture_record record;
+		for (uint32_t i = 0; i < bh.records; ++i)
+		{
+			if (!state.decode(p, end, record))
+			{
+				return false;
+			}
+			cb(record);
+		}
+		return p == end;
+	}
+
+	//every record of every block, in order
+	template <typename Callback>
+	bool for_each_record(Callback cb) const
+	{
+		for (uint64_t block = 0; block < block_count(); ++block)
+		{
+			if (!for_each_record(block, cb))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private: //state
+	mapped_file file_;
+	archive_header header_;
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef __CAPTURE_FORMAT_H__
+#define __CAPTURE_FORMAT_H__
+
+#include "enums.hpp"
+#include "mapped_file.hpp"
+#include "message_parser.hpp"
+#include "price.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//binary capture of a feed, so that it only has to be parsed once however many times
+//it's replayed. laid out as:
+//  capture_header
+//  capture_record * record_count, from records_offset
+//  symbol_count symbols of capture_symbol_bytes each, zero padded, from symbols_offset
+//all little endian, and every record is the same size and 8 byte aligned so that a
+//mapped capture can be read in place as an array of capture_records.
+//
+//a capture holds the events of the lines that parsed; blank and unparsable lines
+//aren't kept.
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "captures are read in place, which needs a little endian host"
+#endif
+
+static const char capture_magic[8] = {'F', 'H', 'C', 'A', 'P', 'T', 'U', 'R'};
+static const uint32_t capture_version = 1;
+static const size_t capture_symbol_bytes = 16;
+
+struct capture_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t tick_decimals;
+	uint64_t record_count;
+	uint64_t records_offset;
+	uint64_t symbols_offset;
+	uint32_t symbol_count;	//0 for a single instrument feed
+	uint32_t record_size;
+	uint8_t reserved[16];
+};
+static_assert(sizeof(capture_header) == 64, "the capture header is 64 bytes");
+
+struct capture_record
+{
+	uint8_t type;	//'A', 'M', 'X' or 'T'
+	uint8_t order_side;	//0 bid, 1 ask
+	uint16_t instrument;	//index into the symbols
+	int32_t order_id;
+	int32_t volume;
+	int32_t reserved;
+	int64_t price;	//in ticks
+};
+static_assert(sizeof(capture_record) == 24, "capture records are 24 bytes");
+
+inline capture_record to_capture_record(const parsed_message &msg, uint16_t instrument)
+{
+	static const uint8_t type_codes[] = {'A', 'M', 'X', 'T'};
+
+	capture_record record;
+	record.type = type_codes[(int)msg.type];
+	record.order_side = (uint8_t)msg.order_side;
+	record.instrument = instrument;
+	record.order_id = msg.order_id;
+	record.volume = msg.volume;
+	record.reserved = 0;
+	record.price = msg.price;
+	return record;
+}
+
+//returns false if the record's type or side isn't one we know
+inline bool from_capture_record(const capture_record &record, parsed_message &msg)
+{
+	switch (record.type)
+	{
+	case 'A': msg.type = message_type::add; break;
+	case 'M': msg.type = message_type::modify; break;
+	case 'X': msg.type = message_type::remove; break;
+	case 'T': msg.type = message_type::trade; break;
+	default: return false;
+	}
+	if (record.order_side > 1)
+	{
+		return false;
+	}
+	msg.order_side = (side)record.order_side;
+	msg.order_id = record.order_id;
+	msg.volume = record.volume;
+	msg.price = record.price;
+	return true;
+}
+
+//apply the record straight to a book, for a replay that has no need of a feedhandler
+//returns what the book's handler did
+template <typename Book>
+bool apply_capture_record(Book &book, const capture_record &record)
+{
+	const side s = (side)(record.order_side & 1);
+	switch (record.type)
+	{
+	case 'A': return book.on_order_add(s, record.order_id, record.price, record.volume);
+	case 'M': return book.on_order_modify(s, record.order_id, record.price, record.volume);
+	case 'X': return book.on_order_remove(s, record.order_id);
+	case 'T': return book.on_trade(record.price, record.volume);
+	default: return false;
+	}
+}
+
+//longest line format_capture_line can write
+static const size_t max_capture_line = 96;
+
+//write the message back out as a feed line, e.g. "VOD.L,A,1,B,100,10.5", with the
+//price in its shortest exact decimal form; returns the length, at most
+//max_capture_line. this is what a replay of a capture echoes in place of the
+//original line
+inline size_t format_capture_line(const parsed_message &msg, const char *symbol, size_t symbol_len,
+		const tick_size &ticks, char *out)
+{
+	char *p = out;
+	if (symbol_len != 0)
+	{
+		memcpy(p, symbol, symbol_len);
+		p += symbol_len;
+		*p++ = ',';
+	}
+
+	static const char type_codes[] = {'A', 'M', 'X', 'T'};
+	char *const end = out + max_capture_line;
+	*p++ = type_codes[(int)msg.type];
+	*p++ = ',';
+	if (msg.type != message_type::trade)
+	{
+		p = std::to_chars(p, end, msg.order_id).ptr;
+		*p++ = ',';
+		*p++ = msg.order_side == side::bid ? 'B' : 'S';
+		*p++ = ',';
+	}
+	p = std::to_chars(p, end, msg.volume).ptr;
+	*p++ = ',';
+
+	//whole ticks, then the fraction without its trailing zeros
+	uint64_t magnitude = msg.price < 0 ? -(uint64_t)msg.price : msg.price;
+	if (msg.price < 0)
+	{
+		*p++ = '-';
+	}
+	const uint64_t per_unit = ticks.ticks_per_unit();
+	p = std::to_chars(p, end, magnitude / per_unit).ptr;
+	uint64_t fraction = magnitude % per_unit;
+	if (fraction != 0)
+	{
+		int digits = ticks.decimals();
+		while (fraction % 10 == 0)
+		{
+			fraction /= 10;
+			--digits;
+		}
+
+		//zero padded on the left to its number of digits
+		*p++ = '.';
+		for (int i = digits - 1; i >= 0; --i)
+		{
+			p[i] = '0' + fraction % 10;
+			fraction /= 10;
+		}
+		p += digits;
+	}
+	return p - out;
+}
+
+//writes a capture: the header is filled in and the symbols appended once all the
+//records are in
+class capture_writer
+{
+public:
+	capture_writer() = default;
+
+	//returns false if the file can't be created
+	bool open(const char *filename, const tick_size &ticks)
+	{
+		os_.open(filename, std::ios::binary | std::ios::trunc);
+		if (!os_)
+		{
+			return false;
+		}
+
+		memset(&header_, 0, sizeof(header_));
+		memcpy(header_.magic, capture_magic, sizeof(capture_magic));
+		header_.version = capture_version;
+		header_.tick_decimals = ticks.decimals();
+		header_.records_offset = sizeof(capture_header);
+		header_.record_size = sizeof(capture_record);
+		os_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+		buffer_.reserve(buffer_records);
+		return true;
+	}
+
+	void add(const capture_record &record)
+	{
+		buffer_.push_back(record);
+		if (buffer_.size() == buffer_records)
+		{
+			drain();
+		}
+	}
+
+	//write the symbols and the finished header; returns false if anything failed
+	//to be written
+	bool close(const std::vector<std::string> &symbols)
+	{
+		drain();
+		header_.symbols_offset = header_.records_offset + header_.record_count * sizeof(capture_record);
+		header_.symbol_count = symbols.size();
+		for (const auto &symbol : symbols)
+		{
+			char padded[capture_symbol_bytes] = {};
+			memcpy(padded, symbol.data(), std::min(symbol.size(), capture_symbol_bytes));
+			os_.write(padded, sizeof(padded));
+		}
+		os_.seekp(0);
+		os_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+		os_.close();
+		return !os_.fail();
+	}
+
+	uint64_t record_count() const { return header_.record_count + buffer_.size(); }
+
+private: //methods
+	void drain()
+	{
+		os_.write(reinterpret_cast<const char *>(buffer_.data()), buffer_.size() * sizeof(capture_record));
+		header_.record_count += buffer_.size();
+		buffer_.clear();
+	}
+
+private: //state
+	static const size_t buffer_records = 1 << 16;
+
+	std::ofstream os_;
+	capture_header header_;
+	std::vector<capture_record> buffer_;
+};
+
+//a capture mapped into memory, with its records read in place
+class capture_reader
+{
+public:
+	//returns false if the file can't be mapped or isn't a capture we can read
+	bool open(const char *filename)
+	{
+		if (!file_.open(filename) || file_.size() < sizeof(capture_header))
+		{
+			return false;
+		}
+
+		memcpy(&header_, file_.data(), sizeof(header_));
+		if (memcmp(header_.magic, capture_magic, sizeof(capture_magic)) != 0
+				|| header_.version != capture_version
+				|| header_.record_size != sizeof(capture_record)
+				|| header_.tick_decimals > (uint32_t)tick_size::max_decimals
+				|| header_.records_offset % alignof(capture_record) != 0)
+		{
+			return false;
+		}
+
+		//everything has to be within the file
+		const uint64_t size = file_.size();
+		if (header_.records_offset > size
+				|| header_.record_count > (size - header_.records_offset) / sizeof(capture_record)
+				|| header_.symbols_offset > size
+				|| header_.symbol_count > (size - header_.symbols_offset) / capture_symbol_bytes)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	tick_size ticks() const { return tick_size(header_.tick_decimals); }
+
+	const capture_record *records() const
+	{
+		return reinterpret_cast<const capture_record *>(file_.data() + header_.records_offset);
+	}
+	uint64_t record_count() const { return header_.record_count; }
+
+	size_t symbol_count() const { return header_.symbol_count; }
+
+	//the symbol's bytes, which aren't null terminated if it's the longest allowed
+	const char *symbol(size_t i) const { return file_.data() + header_.symbols_offset + i * capture_symbol_bytes; }
+	size_t symbol_length(size_t i) const { return strnlen(symbol(i), capture_symbol_bytes); }
+
+private: //state
+	mapped_file file_;
+	capture_header header_;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __CAPTURE_REPLAY_H__
+#define __CAPTURE_REPLAY_H__
+
+#include "capture_format.hpp"
+#include "feedhandler.hpp"
+
+#include <cstdint>
+
+//call cb(const decoded_message &) for each of the capture's records in turn, as
+//the message it was parsed from. the record is already parsed, so all that's left
+//is to write out the line that's echoed for it, and that only lives until cb returns.
+//records before first are skipped, as when picking up from a checkpoint.
+//returns false, having stopped, at a record that doesn't make sense
+template <typename Callback>
+bool for_each_capture_message(const capture_reader &capture, Callback cb, uint64_t first = 0)
+{
+	const tick_size ticks = capture.ticks();
+	const capture_record *const records = capture.records();
+	const bool multi_instrument = capture.symbol_count() != 0;
+
+	char line[max_capture_line];
+	decoded_message decoded;
+	decoded.line = line;
+	decoded.parsed = true;
+	for (uint64_t i = first; i < capture.record_count(); ++i)
+	{
+		const capture_record &record = records[i];
+		if (!from_capture_record(record, decoded.msg)
+				|| (multi_instrument ? record.instrument >= capture.symbol_count() : record.instrument != 0))
+		{
+			return false;
+		}
+
+		const char *symbol = multi_instrument ? capture.symbol(record.instrument) : nullptr;
+		const size_t symbol_len = multi_instrument ? capture.symbol_length(record.instrument) : 0;
+		decoded.len = format_capture_line(decoded.msg, symbol, symbol_len, ticks, line);
+		decoded.symbol = multi_instrument ? line : nullptr;
+		decoded.symbol_len = symbol_len;
+		cb(decoded);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,159 @@
+//============================================================================
+// Name        : converter_main.cpp
+// Description : converts a csv feed to a binary capture that the feedhandler
+//               can replay without parsing it, or to a compressed archive
+//============================================================================
+
+#include "capture_archive.hpp"
+#include "capture_format.hpp"
+#include "mapped_file.hpp"
+#include "message_parser.hpp"
+#include "symbol_directory.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+	void usage()
+	{
+		std::cout << "usage: converter [-d decimals] [-s max_instruments] [-z] [-b block_records] <csv_filename> <output_filename>" << std::endl;
+		std::cout << "  -d  number of decimal places in a tick, e.g. 2 for a 0.01 tick (default 2)" << std::endl;
+		std::cout << "  -s  lines start with an instrument symbol; take up to this many instruments" << std::endl;
+		std::cout << "  -z  write a compressed archive rather than a capture" << std::endl;
+		std::cout << "  -b  most messages in each of an archive's blocks (default " << archive_writer::default_block_records << ")" << std::endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int tick_decimals = 2;
+	int max_instruments = 0;
+	bool archive = false;
+	int block_records = archive_writer::default_block_records;
+	int opt;
+	while ((opt = getopt(argc, argv, "d:s:zb:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': tick_decimals = atoi(optarg); break;
+		case 's': max_instruments = atoi(optarg); break;
+		case 'z': archive = true; break;
+		case 'b': block_records = atoi(optarg); break;
+		default: usage(); return 1;
+		}
+	}
+
+	if (tick_decimals < 0 || tick_decimals > tick_size::max_decimals)
+	{
+		std::cout << "Tick decimals must be between 0 and " << tick_size::max_decimals << std::endl;
+		return 1;
+	}
+	//instruments are numbered in a uint16 in the records
+	if (max_instruments < 0 || max_instruments > std::numeric_limits<uint16_t>::max() + 1)
+	{
+		std::cout << "Number of instruments must be between 0 and " << std::numeric_limits<uint16_t>::max() + 1 << std::endl;
+		return 1;
+	}
+	if (block_records <= 0)
+	{
+		std::cout << "Blocks must have room for some messages" << std::endl;
+		return 1;
+	}
+	if (optind != argc - 2)
+	{
+		usage();
+		return 1;
+	}
+	const char *in_filename = argv[optind];
+	const char *out_filename = argv[optind + 1];
+
+	mapped_file infile;
+	if (!infile.open(in_filename))
+	{
+		std::cout << "Cannot open file " << in_filename << std::endl;
+		return 1;
+	}
+
+	const tick_size ticks(tick_decimals);
+	capture_writer capture;
+	archive_writer compressed;
+	if (archive ? !compressed.open(out_filename, ticks, block_records) : !capture.open(out_filename, ticks))
+	{
+		std::cout << "Cannot create file " << out_filename << std::endl;
+		return 1;
+	}
+
+	const message_parser parser(ticks);
+	symbol_directory symbols(max_instruments);
+	int skipped = 0;
+	infile.for_each_line([&](const char *line, size_t len)
+	{
+		//lines that wouldn't reach a book are left out, and only a line that's kept
+		//makes an instrument of its symbol
+		const char *comma = nullptr;
+		if (max_instruments != 0)
+		{
+			comma = static_cast<const char *>(memchr(line, ',', len));
+			if (!comma)
+			{
+				++skipped;
+				return;
+			}
+		}
+
+		parsed_message msg;
+		const char *rest = comma ? comma + 1 : line;
+		if (!parser.parse(rest, line + len - rest, msg))
+		{
+			++skipped;
+			return;
+		}
+
+		int instrument = 0;
+		if (comma)
+		{
+			instrument = symbols.find_or_add(line, comma - line);
+			if (instrument < 0)
+			{
+				++skipped;
+				return;
+			}
+		}
+		const capture_record record = to_capture_record(msg, static_cast<uint16_t>(instrument));
+		if (archive)
+		{
+			compressed.add(record);
+		}
+		else
+		{
+			capture.add(record);
+		}
+	});
+
+	std::vector<std::string> names;
+	for (size_t i = 0; i < symbols.size(); ++i)
+	{
+		names.push_back(symbols.name(i));
+	}
+	const uint64_t records = archive ? compressed.record_count() : capture.record_count();
+	if (archive ? !compressed.close(names) : !capture.close(names))
+	{
+		std::cout << "Failed writing " << out_filename << std::endl;
+		return 1;
+	}
+
+	std::cout << "Wrote " << records << " messages";
+	if (max_instruments != 0)
+	{
+		std::cout << " for " << names.size() << " instruments";
+	}
+	std::cout << " to " << out_filename << ", skipping " << skipped << " unparsable lines" << std::endl;
+	return 0;
+}
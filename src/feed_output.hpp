@@ -0,0 +1,115 @@
+#ifndef __FEED_OUTPUT_H__
+#define __FEED_OUTPUT_H__
+
+#include "enums.hpp"
+#include "price.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+//the text the feedhandler writes for each message. the inline and the async output
+//paths both go through these, so the two can't drift apart. Stream is a std::ostream
+//or an output_sink
+
+template <typename Stream>
+void write_midpoint(Stream &os, double midpoint)
+{
+	if (midpoint == 0)
+	{
+		os << "NAN" << '\n';
+	}
+	else
+	{
+		os << midpoint << '\n';
+	}
+}
+
+template <typename Stream>
+void write_trade(Stream &os, uint64_t cumulative_volume, double price)
+{
+	os << cumulative_volume << "@" << price << '\n';
+}
+
+template <typename Stream>
+void write_unparsable(Stream &os)
+{
+	os << " UNPARSABLE" << '\n';
+}
+
+//the symbol is left out when the feed only carries one instrument, i.e. when it's empty
+template <typename Stream>
+void write_book_header(Stream &os, const char *symbol, size_t symbol_len)
+{
+	os << '\n' << '\n' << "Current Orderbook";
+	if (symbol_len != 0)
+	{
+		os << ' ';
+		os.write(symbol, symbol_len);
+	}
+	os << ":" << '\n';
+}
+
+template <typename Stream>
+void write_book_footer(Stream &os)
+{
+	os << '\n';
+}
+
+//a depth snapshot, or just the levels that have changed since the last one if it's an
+//update, headed like a book. each level is a line, e.g. "10.5 S 120 (3)" for 120 over
+//3 orders, with a level that's gone down to nothing
+template <typename Stream>
+void write_depth_header(Stream &os, const char *symbol, size_t symbol_len, bool update)
+{
+	os << '\n' << '\n' << (update ? "Depth update" : "Depth");
+	if (symbol_len != 0)
+	{
+		os << ' ';
+		os.write(symbol, symbol_len);
+	}
+	os << ":" << '\n';
+}
+
+template <typename Stream>
+void write_depth_level(Stream &os, side s, double price, int volume, int order_count)
+{
+	os << price << (s == side::bid ? " B " : " S ") << volume << " (" << order_count << ")" << '\n';
+}
+
+//prints the orders of a book handed to it in descending price order, one line per
+//price, e.g. "10.5 S 100 S 20"
+template <typename Stream>
+class book_printer
+{
+public:
+	book_printer(Stream &os, const tick_size &ticks)
+		: os_(os),
+		  ticks_(ticks)
+	{
+
+	}
+
+	//print the next order, starting a new line if the price has changed
+	void order(side s, price_t price, int volume)
+	{
+		if (price != curr_price_)
+		{
+			curr_price_ = price;
+			os_ << '\n';
+			os_ << ticks_.to_price(curr_price_);
+		}
+		os_ << (s == side::bid ? " B " : " S ") << volume;
+	}
+
+	void finish()
+	{
+		os_ << '\n';
+	}
+
+private: //state
+	Stream &os_;
+	const tick_size ticks_;
+	price_t curr_price_ = 0;
+};
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef __FEED_SIMULATOR_H__
+#define __FEED_SIMULATOR_H__
+
+#include "enums.hpp"
+#include "message_parser.hpp"
+#include "orderbook.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//generates a random but consistent feed: adds, modifies and removes of orders priced
+//around the touch, and whenever the book crosses, the trades and the modifies and
+//removes that uncross it. a book of its own is kept up to date with every event, so
+//it only ever modifies or removes orders that are in it. the same seed always gives
+//the same feed
+class feed_simulator
+{
+public:
+	enum class action
+	{
+		add = 0,
+		remove = 1,
+		modify = 2
+	};
+
+	explicit feed_simulator(int seed)
+	{
+		rng_.seed(seed);
+	}
+
+	//generate the next event and any trades it causes, calling
+	//emit(const parsed_message &) for each in feed order
+	template <typename Emit>
+	void step(Emit emit)
+	{
+		switch (generate_action())
+		{
+		//add - randomly generate an add on either side
+		case action::add:
+		{
+			const auto order_id = next_order_id_++;
+			const auto chosen_side = generate_side();
+			const auto chosen_price = get_random_appropriate_price(chosen_side);
+			const auto chosen_volume = generate_volume();
+
+			//insert the new order's details
+			order_details_to_order_id_[chosen_side].emplace(std::make_pair(chosen_price, chosen_volume), order_id);
+			ob_.on_order_add(chosen_side, order_id, chosen_price, chosen_volume);
+			emit(make_event(message_type::add, chosen_side, order_id, chosen_volume, chosen_price));
+			break;
+		}
+		//modify - choose a random open order
+		case action::modify:
+		{
+			const auto chosen_side = generate_valid_side();
+			const auto chosen_depth = generate_int(0, ob_.get_order_count_on_side(chosen_side) - 1);
+			const auto order_to_modify = *ob_.get_order_in_position(chosen_side, chosen_depth);
+
+			//do we change price?
+			const auto new_price = generate_bool()
+											? get_random_appropriate_price(chosen_side)
+											: order_to_modify.price;
+
+			const auto new_size = generate_bool()
+											? generate_volume()
+											: order_to_modify.volume;
+
+			const auto order_id = modify_order_mapping(chosen_side, order_to_modify.price, order_to_modify.volume, new_price, new_size);
+			emit(make_event(message_type::modify, chosen_side, order_id, new_size, new_price));
+			ob_.on_order_modify(chosen_side, order_id, new_price, new_size);
+			break;
+		}
+		case action::remove:
+		{
+			const auto chosen_side = generate_valid_side();
+			const auto chosen_depth = generate_int(0, ob_.get_order_count_on_side(chosen_side) - 1);
+			const auto order_to_remove = *ob_.get_order_in_position(chosen_side, chosen_depth);
+
+			const auto order_id = remove_order_mapping(chosen_side, order_to_remove.price, order_to_remove.volume);
+			emit(make_event(message_type::remove, chosen_side, order_id, order_to_remove.volume, order_to_remove.price));
+			ob_.on_order_remove(chosen_side, order_id);
+			break;
+		}
+		default:
+			throw std::logic_error("");
+		}
+
+		//if there's crossing, uncross everything until we're done
+		if (ob_.is_crossed())
+		{
+			uncross(emit);
+		}
+	}
+
+	//the book as the feed so far leaves it
+	const orderbook &book() const { return ob_; }
+
+private: //methods
+	static parsed_message make_event(message_type type, side s, int order_id, int volume, price_t price)
+	{
+		parsed_message msg;
+		msg.type = type;
+		msg.order_side = s;
+		msg.order_id = order_id;
+		msg.volume = volume;
+		msg.price = price;
+		return msg;
+	}
+
+	template <typename Emit>
+	void uncross(Emit emit)
+	{
+		//they must currently overlap because we're crossed
+		trades_.clear();
+		order_actions_.clear();
+
+		//keep matching the touch order on each side until we get rid of any overlap
+		while (ob_.is_crossed() && ob_.get_order_count_on_side(side::bid) != 0 && ob_.get_order_count_on_side(side::ask) != 0)
+		{
+			const auto bid_touch = *ob_.get_order_in_position(side::bid, 0);
+			const auto ask_touch = *ob_.get_order_in_position(side::ask, 0);
+
+			auto remaining_vol_to_remove = bid_touch.volume;
+
+			//we've got someone bidding for more than the ask price, remove the bid vol from ask
+			auto price_to_sell = ask_touch.price;
+
+			//get the order id of touch
+			const auto bid_order_id = order_details_to_order_id_[side::bid].find(std::make_pair(bid_touch.price, bid_touch.volume))->second;
+			const auto ask_order_id = order_details_to_order_id_[side::ask].find(std::make_pair(ask_touch.price, ask_touch.volume))->second;
+
+			//generate trade, modify or remove the bid, modify or remove the ask
+			const auto this_trade_volume = std::min(remaining_vol_to_remove, ask_touch.volume);
+
+			remaining_vol_to_remove -= this_trade_volume;
+
+			//trade
+			trades_.push_back(make_event(message_type::trade, side::bid, 0, this_trade_volume, price_to_sell));
+
+			//remove/modify bid
+			if (remaining_vol_to_remove == 0)
+			{
+				order_actions_.push_back(make_event(message_type::remove, side::bid, bid_order_id, bid_touch.volume, bid_touch.price));
+				remove_order_mapping(side::bid, bid_order_id, bid_touch.price, bid_touch.volume);
+				ob_.on_order_remove(side::bid, bid_order_id);
+			}
+			else
+			{
+				order_actions_.push_back(make_event(message_type::modify, side::bid, bid_order_id, remaining_vol_to_remove, bid_touch.price));
+				modify_order_mapping(side::bid, bid_order_id, bid_touch.price, bid_touch.volume, bid_touch.price, remaining_vol_to_remove);
+				ob_.on_order_modify(side::bid, bid_order_id, bid_touch.price, remaining_vol_to_remove);
+			}
+
+			//remove/modify ask
+			//non-zero left to remove so the ask order gets removed entirely
+			if (remaining_vol_to_remove != 0)
+			{
+				order_actions_.push_back(make_event(message_type::remove, side::ask, ask_order_id, ask_touch.volume, ask_touch.price));
+				remove_order_mapping(side::ask, ask_order_id, ask_touch.price, ask_touch.volume);
+				ob_.on_order_remove(side::ask, ask_order_id);
+			}
+			else
+			{
+				const auto remaining_ask_volume = ask_touch.volume - this_trade_volume;
+				order_actions_.push_back(make_event(message_type::modify, side::ask, ask_order_id, remaining_ask_volume, ask_touch.price));
+				modify_order_mapping(side::ask, ask_order_id, ask_touch.price, ask_touch.volume, ask_touch.price, remaining_ask_volume);
+				ob_.on_order_modify(side::ask, ask_order_id, ask_touch.price, remaining_ask_volume);
+			}
+		}
+
+		//the trades then the actions
+		for (const auto &trade : trades_)
+		{
+			emit(trade);
+		}
+		for (const auto &act : order_actions_)
+		{
+			emit(act);
+		}
+	}
+
+	int remove_order_mapping(side s, price_t price, int size)
+	{
+		//get the order id
+		auto iter = order_details_to_order_id_[s].find(std::make_pair(price, size));
+		if (iter == order_details_to_order_id_[s].end())
+		{
+			std::cout << "Couldn't find " << s << ", " << price << ", " << size << " in order details map!" << std::endl;
+			throw std::runtime_error("");
+		}
+		const auto order_id = iter->second;
+		order_details_to_order_id_[s].erase(iter);
+		return order_id;
+	}
+
+	void remove_order_mapping(side s, int order_id, price_t price, int size)
+	{
+		auto iter_pair = order_details_to_order_id_[s].equal_range(std::make_pair(price, size));
+
+		for (auto iter = iter_pair.first; iter != iter_pair.second; ++iter)
+		{
+			if (order_id == iter->second)
+			{
+				order_details_to_order_id_[s].erase(iter);
+				return;
+			}
+		}
+
+		std::cout << "Couldn't find order id " << order_id << " in our multimap!" << std::endl;
+		throw std::logic_error("");
+	}
+
+	int modify_order_mapping(side s, price_t old_price, int old_size, price_t new_price, int new_size)
+	{
+		//get the order id
+		auto iter = order_details_to_order_id_[s].find(std::make_pair(old_price, old_size));
+		const auto order_id = iter->second;
+		order_details_to_order_id_[s].erase(iter);
+
+		order_details_to_order_id_[s].emplace(std::make_pair(new_price, new_size), order_id);
+		return order_id;
+	}
+
+	void modify_order_mapping(side s, int order_id, price_t old_price, int old_size, price_t new_price, int new_size)
+	{
+		auto iter_pair = order_details_to_order_id_[s].equal_range(std::make_pair(old_price, old_size));
+
+		for (auto iter = iter_pair.first; iter != iter_pair.second; ++iter)
+		{
+			if (order_id == iter->second)
+			{
+				order_details_to_order_id_[s].erase(iter);
+				order_details_to_order_id_[s].emplace(std::make_pair(new_price, new_size), order_id);
+				return;
+			}
+		}
+
+		std::cout << "Couldn't find order id " << order_id << " in our multimap!" << std::endl;
+		throw std::logic_error("");
+	}
+
+	action generate_action()
+	{
+		if (order_details_to_order_id_.empty())
+		{
+			return action::add;
+		}
+
+		std::uniform_int_distribution<> distribution(0, 4);
+
+		const auto result = distribution(rng_);
+		switch(result)
+		{
+		case 0:
+			return action::remove;
+		case 1:
+			return action::modify;
+		default:
+			return action::add;
+		}
+	}
+
+	side generate_side()
+	{
+		std::uniform_int_distribution<> distribution(0, 1);
+		return (side)distribution(rng_);
+	}
+
+	side generate_valid_side()
+	{
+		if (ob_.get_midpoint() != 0)
+		{
+			return generate_side();
+		}
+		return ob_.get_best_price(side::ask) == 0 ? side::bid : side::ask;
+	}
+
+	int generate_volume()
+	{
+		std::uniform_int_distribution<> distribution(1, 400);
+		return distribution(rng_);
+	}
+
+	int generate_int(int min, int max)
+	{
+		std::uniform_int_distribution<> distribution(min, max);
+		return distribution(rng_);
+	}
+
+	bool generate_bool()
+	{
+		std::uniform_int_distribution<> distribution(0, 1);
+		return distribution(rng_) == 1;
+	}
+
+	//generate a whole-unit price near the current touch, returned in the book's ticks
+	price_t get_random_appropriate_price(side s)
+	{
+		const auto &ticks = ob_.get_tick_size();
+		const auto best_bid = ticks.to_price(ob_.get_best_price(side::bid));
+		const auto best_ask = ticks.to_price(ob_.get_best_price(side::ask));
+
+		//if nothing populated, return random price
+		if (best_bid == 0 && best_ask == 0)
+		{
+			return ticks.to_ticks(std::uniform_int_distribution<>(100, 1000)(rng_));
+		}
+
+		//if ask is empty then base it around best bid
+		if (best_ask == 0)
+		{
+			return ticks.to_ticks(std::uniform_int_distribution<>(best_bid * 0.8, best_bid * 1.2)(rng_));
+		}
+		//if bid is empty base it around best ask
+		if (best_bid == 0)
+		{
+			return ticks.to_ticks(std::uniform_int_distribution<>(best_ask * 0.8, best_ask * 1.2)(rng_));
+		}
+
+		//otherwise base it around the midpoint
+		const auto midpoint = ob_.is_crossed() ? ticks.to_price(ob_.get_best_price(s)) : ob_.get_midpoint();
+
+		if (s == side::bid)
+		{
+			const auto min_bound = std::max<double>(100, midpoint * 0.7);
+			const auto max_bound = std::min<double>(1000, midpoint * 1.15);
+			return ticks.to_ticks((int)std::uniform_real_distribution<>(min_bound, max_bound)(rng_));
+		}
+
+		if (s == side::ask)
+		{
+			const auto min_bound = std::max<double>(100, midpoint * 0.85);
+			const auto max_bound = std::min<double>(1000, midpoint * 1.3);
+			return ticks.to_ticks((int)std::uniform_real_distribution<>(min_bound, max_bound)(rng_));
+		}
+		throw std::logic_error("");
+	}
+
+private: //state
+	std::mt19937 rng_;	//the Mersenne Twister with a popular choice of parameters
+
+	orderbook ob_;
+
+	//reverse index of (price, volume) to the order ids resting with those details
+	std::map<side, std::multimap<std::pair<price_t, int>, int>> order_details_to_order_id_;
+	int next_order_id_ = 1;
+
+	//what uncrossing the book generates, held back until it's all done
+	std::vector<parsed_message> trades_;
+	std::vector<parsed_message> order_actions_;
+};
+
+#endif
@@ -1,143 +1,632 @@
 #include "feedhandler.hpp"
+#include "feed_output.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 namespace
 {
-	enum class parse_state
+	//formats the output straight into the sink, on the thread processing the feed.
+	//has the same interface as async_output
+	class inline_output
 	{
-		type,
-		order_id,
-		side,
-		price,
-		size,
-		done
+	public:
+		inline_output(output_sink &out, const tick_size &ticks)
+			: out_(out),
+			  ticks_(ticks)
+		{
+
+		}
+
+		void line(const char *text, size_t len)
+		{
+			out_.write(text, len);
+			out_ << ": ";
+		}
+
+		void midpoint(double value) { write_midpoint(out_, value); }
+		void trade(uint64_t cumulative_volume, price_t price) { write_trade(out_, cumulative_volume, ticks_.to_price(price)); }
+		void unparsable() { write_unparsable(out_); }
+
+		void book(const orderbook &ob, const std::string &symbol)
+		{
+			write_book_header(out_, symbol.data(), symbol.size());
+			ob.print_ob(out_);
+			write_book_footer(out_);
+		}
+
+		void depth_begin(const std::string &symbol, bool update) { write_depth_header(out_, symbol.data(), symbol.size(), update); }
+		void depth_price(side s, const depth_level &level) { write_depth_level(out_, s, ticks_.to_price(level.price), level.volume, level.order_count); }
+		void depth_end() { write_book_footer(out_); }
+
+	private:
+		output_sink &out_;
+		const tick_size &ticks_;
 	};
-	enum class action
+}
+
+feedhandler::feedhandler(int ob_print_frequency, std::ostream &os, const feedhandler_options &options)
+		: ob_print_frequency_(ob_print_frequency),
+		  depth_updates_(options.depth_updates),
+		  conflation_(options.conflation),
+		  windowed_(options.conflation != conflation_mode::none
+				&& (options.conflation_window_messages != 0 || options.conflation_window_us != 0)),
+		  window_messages_(options.conflation_window_messages),
+		  window_time_(std::chrono::microseconds(options.conflation_window_us)),
+		  window_start_(std::chrono::steady_clock::now()),
+		  out_(os),
+		  async_(options.async ? new async_output(os, options.ticks, options.async_ring_records) : nullptr),
+		  parser_(options.ticks),
+		  multi_instrument_(options.max_instruments != 0),
+		  symbols_(options.max_instruments),
+		  live_metrics_(options.live_metrics),
+		  live_metrics_messages_(std::max<size_t>(options.live_metrics_messages, 1))
 	{
-		add,
-		modify,
-		remove,
-		trade,
-		none
-	};
+		instruments_.resize(multi_instrument_ ? options.max_instruments : 1);
+		for (auto &inst : instruments_)
+		{
+			inst.book.reset(new orderbook(options.ticks, orderbook::level_options(), options.pool, options.index));
+			inst.book->set_depth_levels(options.depth_levels);
+		}
+	}
+
+feedhandler::~feedhandler()
+{
+	wait_for_checkpoint();
+}
+
+void write_feed_stats(output_sink &out, const feed_stats &stats)
+{
+	const auto &ob_stats = stats.book_errors;
+	out << '\n';
+	out << "ERROR STATS:" << '\n';
+	out << "  unparseable: " << stats.unparsable << '\n';
+	out << "  crossed book with no trades: " << ob_stats.crossed_book_no_trades << '\n';
+	out << "  duplicate order ids: " << ob_stats.duplicate_order_ids << '\n';
+	out << "  invalid inputs: " << ob_stats.invalid_inputs << '\n';
+	out << "  modifies without order: " << ob_stats.modifies_without_order << '\n';
+	out << "  removes without order: " << ob_stats.removes_without_order << '\n';
+	out << "  trades without order: " << ob_stats.trade_without_order << '\n';
+	out << '\n';
 
-	bool str_to_int(const char *buf, size_t len, int &)        // digits only
+	if (stats.multi_instrument)
 	{
-		int n=0;
+		out << "INSTRUMENT STATS:" << '\n';
+		out << "  instruments: " << stats.instruments.size() << " of " << stats.instrument_capacity << '\n';
+		out << "  unknown or over capacity: " << stats.unknown_instruments << '\n';
+		for (const auto &inst : stats.instruments)
+		{
+			out << "  " << inst.symbol << ": messages " << inst.messages
+					<< ", unparseable " << inst.unparsable
+					<< ", trades " << inst.trades << " (volume " << inst.traded_volume << ")"
+					<< ", orders " << inst.bid_orders << " bid " << inst.ask_orders << " ask"
+					<< ", errors " << inst.book_errors << '\n';
+		}
+		out << '\n';
+	}
 
-		while (len--)
+#ifdef FEEDHANDLER_LATENCY
+	//in nanoseconds, for each stage and message type that saw any messages
+	const char *stage_names[] = {"parse", "apply", "output"};
+	const char *type_names[] = {"add", "modify", "remove", "trade"};
+	const double ticks_per_ns = tsc_ticks_per_ns();
+	const auto ns = [ticks_per_ns](uint64_t ticks) { return (uint64_t)(ticks / ticks_per_ns); };
+	out << "LATENCY STATS (ns):" << '\n';
+	for (size_t s = 0; s < feed_latencies::stages; ++s)
+	{
+		for (size_t type = 0; type < feed_latencies::message_types; ++type)
 		{
-			n = n*10 + *buf++ - '0';
+			const latency_histogram &histogram = stats.latencies.histograms[s][type];
+			if (histogram.count() == 0)
+			{
+				continue;
+			}
+			out << "  " << stage_names[s] << ' ' << type_names[type] << ": count " << histogram.count()
+					<< ", p50 " << ns(histogram.value_at(0.5))
+					<< ", p99 " << ns(histogram.value_at(0.99))
+					<< ", p99.9 " << ns(histogram.value_at(0.999))
+					<< ", max " << ns(histogram.max()) << '\n';
 		}
+	}
+	out << '\n';
+#endif
+}
 
-		return n;
+void feedhandler::print_stats() const
+{
+	//anything still waiting in the ring comes before the stats
+	if (async_)
+	{
+		async_->flush();
 	}
 
+	write_feed_stats(out_, get_stats());
+
+	if (async_)
+	{
+		const auto &output_stats = async_->get_stats();
+		out_ << "OUTPUT STATS:" << '\n';
+		out_ << "  records: " << output_stats.pushes << '\n';
+		out_ << "  ring capacity: " << output_stats.capacity << '\n';
+		out_ << "  ring high-water mark: " << output_stats.high_water_mark << '\n';
+		out_ << "  producer stalls: " << output_stats.stalls << '\n';
+		out_ << '\n';
+	}
+	out_.flush();
 }
 
-feedhandler::feedhandler(int ob_print_frequency, std::ostream &os)
-		: ob_print_frequency_(ob_print_frequency),
-		  os_(os)
+feed_stats feedhandler::get_stats() const
+{
+	feed_stats stats;
+	stats.unparsable = parse_failure_count_;
+	stats.messages = parse_failure_count_;
+	for (const auto &inst : instruments_)
 	{
+		stats.book_errors += inst.book->get_error_stats();
+		stats.messages += inst.stats.messages;
+	}
 
+#ifdef FEEDHANDLER_LATENCY
+	stats.latencies = latencies_;
+#endif
+
+	stats.multi_instrument = multi_instrument_;
+	stats.instrument_capacity = symbols_.capacity();
+	stats.unknown_instruments = unknown_instrument_count_;
+	if (multi_instrument_)
+	{
+		for (size_t id = 0; id < symbols_.size(); ++id)
+		{
+			const instrument &inst = instruments_[id];
+			stats.instruments.push_back(inst.stats);
+			stats.instruments.back().bid_orders = inst.book->get_order_count_on_side(side::bid);
+			stats.instruments.back().ask_orders = inst.book->get_order_count_on_side(side::ask);
+			stats.instruments.back().book_errors = inst.book->get_error_stats().total();
+		}
 	}
+	return stats;
+}
 
-void feedhandler::print_stats() const
+void feedhandler::flush()
 {
-	const auto &ob_stats = ob_.get_error_stats();
-	os_ << std::endl;
-	os_ << "ERROR STATS:" << std::endl;
-	os_ << "  unparseable: " << parse_failure_count_ << std::endl;
-	os_ << "  crossed book with no trades: " << ob_stats.crossed_book_no_trades << std::endl;
-	os_ << "  duplicate order ids: " << ob_stats.duplicate_order_ids << std::endl;
-	os_ << "  invalid inputs: " << ob_stats.invalid_inputs << std::endl;
-	os_ << "  modifies without order: " << ob_stats.modifies_without_order << std::endl;
-	os_ << "  removes without order: " << ob_stats.removes_without_order << std::endl;
-	os_ << "  trades without order: " << ob_stats.trade_without_order << std::endl;
-	os_ << std::endl;
+	//everything so far includes the window that's open
+	if (windowed_)
+	{
+		if (async_)
+		{
+			end_window(*async_);
+		}
+		else
+		{
+			inline_output output(out_, parser_.get_tick_size());
+			end_window(output);
+		}
+	}
+
+	if (async_)
+	{
+		async_->flush();
+	}
+	out_.flush();
+
+	if (live_metrics_)
+	{
+		publish_live_metrics();
+	}
+}
+
+void feedhandler::publish_live_metrics()
+{
+	messages_since_published_ = 0;
+	live_metrics_snapshot snapshot;
+	snapshot.unparsable = parse_failure_count_;
+	snapshot.messages = parse_failure_count_;
+	snapshot.unknown_instruments = unknown_instrument_count_;
+
+	//only the instruments seen so far have anything to add
+	const size_t books = multi_instrument_ ? symbols_.size() : 1;
+	snapshot.instruments = multi_instrument_ ? books : 1;
+	for (size_t id = 0; id < books; ++id)
+	{
+		const instrument &inst = instruments_[id];
+		snapshot.messages += inst.stats.messages;
+		snapshot.trades += inst.stats.trades;
+		snapshot.traded_volume += inst.stats.traded_volume;
+		snapshot.bid_orders += inst.book->get_order_count_on_side(side::bid);
+		snapshot.ask_orders += inst.book->get_order_count_on_side(side::ask);
+		const auto &errors = inst.book->get_error_stats();
+		snapshot.duplicate_order_ids += errors.duplicate_order_ids;
+		snapshot.trade_without_order += errors.trade_without_order;
+		snapshot.removes_without_order += errors.removes_without_order;
+		snapshot.modifies_without_order += errors.modifies_without_order;
+		snapshot.crossed_book_no_trades += errors.crossed_book_no_trades;
+		snapshot.invalid_inputs += errors.invalid_inputs;
+	}
+	live_metrics_->publish(snapshot);
+}
+
+bool feedhandler::checkpoint(const char *filename, uint64_t input_offset, checkpoint_offset offset_kind)
+{
+	//the last checkpoint's image can't be reused until it's been written
+	const bool written = wait_for_checkpoint();
+
+	checkpoint_.begin(parser_.get_tick_size(), input_offset, offset_kind);
+	checkpoint_.header().unparsable = parse_failure_count_;
+	checkpoint_.header().unknown_instruments = unknown_instrument_count_;
+	checkpoint_.header().messages_since_print = messages_processed_;
+
+	//only the instruments seen so far have anything to keep
+	const size_t books = multi_instrument_ ? symbols_.size() : 1;
+	std::vector<std::string> names;
+	for (size_t id = 0; id < books; ++id)
+	{
+		const instrument &inst = instruments_[id];
+		checkpoint_book stats = {};
+		stats.messages = inst.stats.messages;
+		stats.unparsable = inst.stats.unparsable;
+		stats.trades = inst.stats.trades;
+		stats.traded_volume = inst.stats.traded_volume;
+		checkpoint_.add_book(*inst.book, stats);
+		if (multi_instrument_)
+		{
+			names.push_back(symbols_.name(id));
+		}
+	}
+	checkpoint_.end(names);
+
+	checkpoint_filename_ = filename;
+	checkpoint_writer_ = std::thread([this]()
+	{
+		checkpoint_written_ = write_checkpoint(checkpoint_filename_.c_str(), checkpoint_.image());
+	});
+	return written;
+}
+
+bool feedhandler::wait_for_checkpoint()
+{
+	if (checkpoint_writer_.joinable())
+	{
+		checkpoint_writer_.join();
+	}
+	return checkpoint_written_;
 }
 
-void feedhandler::record_failure()
+bool feedhandler::restore(const char *filename, uint64_t &input_offset, checkpoint_offset &offset_kind)
 {
-	os_ << " UNPARSABLE" << std::endl;
-	++parse_failure_count_;
+	checkpoint_reader checkpoint;
+	if (!checkpoint.open(filename)
+			|| checkpoint.ticks().decimals() != parser_.get_tick_size().decimals()
+			|| (checkpoint.symbol_count() != 0) != multi_instrument_
+			|| checkpoint.book_count() != (multi_instrument_ ? checkpoint.symbol_count() : 1)
+			|| checkpoint.book_count() > instruments_.size())
+	{
+		return false;
+	}
+
+	for (size_t id = 0; id < checkpoint.book_count(); ++id)
+	{
+		//interned in the same order as before, so they get the same ids
+		instrument &inst = instruments_[id];
+		if (multi_instrument_)
+		{
+			if (symbols_.find_or_add(checkpoint.symbol(id), checkpoint.symbol_length(id)) != (int)id)
+			{
+				return false;
+			}
+			inst.stats.symbol = symbols_.name(id);
+		}
+
+		if (!restore_book(*inst.book, checkpoint, id))
+		{
+			return false;
+		}
+		const checkpoint_book &saved = checkpoint.book(id);
+		inst.stats.messages = saved.messages;
+		inst.stats.unparsable = saved.unparsable;
+		inst.stats.trades = saved.trades;
+		inst.stats.traded_volume = saved.traded_volume;
+
+		//the touch as it is was printed before the checkpoint was taken
+		inst.seen_changes = conflation_ == conflation_mode::top ? inst.book->get_top_changes() : inst.book->get_midpoint_changes();
+		inst.printed_midpoint = inst.book->get_midpoint();
+	}
+
+	parse_failure_count_ = checkpoint.header().unparsable;
+	unknown_instrument_count_ = checkpoint.header().unknown_instruments;
+	messages_processed_ = checkpoint.header().messages_since_print;
+	input_offset = checkpoint.header().input_offset;
+	offset_kind = checkpoint.header().offset_kind;
+	return true;
 }
 
 void feedhandler::process_message(const std::string &line)
 {
-	os_ << line << ": ";
+	process_message(line.data(), line.size());
+}
 
-	//pretty basic scanning of the line; attempt to sscanf the various
-	// types of action that are available; if we can't match anything then
-	// it means something was wrong with the line and we mark it unparsable
+void feedhandler::process_message(const char *line, size_t len)
+{
+	decoded_message decoded;
+	decode_message(line, len, decoded);
+	apply_message(decoded);
+}
 
-	char type, s;
-	int order_id, volume;
-	double price;
-	char dummy;
-	//trade
-	if (sscanf(line.c_str(), "%c,%d,%lf%c", &type, &volume, &price, &dummy) == 3)
+void feedhandler::decode_message(const char *line, size_t len, decoded_message &decoded) const
+{
+	decoded.line = line;
+	decoded.len = len;
+
+	//split off the symbol
+	if (multi_instrument_)
 	{
-		if (type != 'T')
+		const char *comma = static_cast<const char *>(memchr(line, ',', len));
+		if (!comma)
 		{
-			record_failure();
+			decoded.symbol = nullptr;
+			decoded.parsed = false;
 			return;
 		}
-		ob_.on_trade(price, volume);
+		decoded.symbol = line;
+		decoded.symbol_len = comma - line;
+		len -= comma + 1 - line;
+		line = comma + 1;
+	}
 
-		//output the trade stats every message
-		const auto &trade_stats = ob_.get_current_trade_stats();
-		os_ << trade_stats.cumulative_trade_volume << "@" << trade_stats.last_trade_price << std::endl;
+#ifdef FEEDHANDLER_LATENCY
+	const uint64_t start = read_tsc();
+	decoded.parsed = parser_.parse(line, len, decoded.msg);
+	decoded.parse_ticks = read_tsc() - start;
+#else
+	decoded.parsed = parser_.parse(line, len, decoded.msg);
+#endif
+}
+
+void feedhandler::apply_message(const decoded_message &decoded)
+{
+	if (async_)
+	{
+		apply_message(*async_, decoded);
+	}
+	else
+	{
+		inline_output output(out_, parser_.get_tick_size());
+		apply_message(output, decoded);
+	}
+
+	if (live_metrics_ && ++messages_since_published_ == live_metrics_messages_)
+	{
+		publish_live_metrics();
+	}
+}
+
+template <typename Output>
+void feedhandler::apply_message(Output &output, const decoded_message &decoded)
+{
+	if (windowed_)
+	{
+		next_window_message(output);
 	}
-	//order action
-	else if (sscanf(line.c_str(), "%c,%d,%c,%d,%lf%c", &type, &order_id, &s, &volume, &price, &dummy) == 5)
+
+	if (!decoded.parsed)
 	{
-		side action_side;
-		if (s == 'B')
+		output.line(decoded.line, decoded.len);
+		output.unparsable();
+		++parse_failure_count_;
+
+		//a line that doesn't parse never makes an instrument of its first field, but
+		//it's put down to its instrument if that's one we already have
+		if (!multi_instrument_)
 		{
-			action_side = side::bid;
+			++instruments_[0].stats.unparsable;
 		}
-		else if (s == 'S')
+		else if (!decoded.symbol)
 		{
-			action_side = side::ask;
+			++unknown_instrument_count_;
 		}
 		else
 		{
-			record_failure();
-			return;
+			const int id = symbols_.find(decoded.symbol, decoded.symbol_len);
+			if (id >= 0)
+			{
+				++instruments_[id].stats.unparsable;
+			}
 		}
+		return;
+	}
 
-		switch(type)
+	//find the message's instrument
+	instrument *inst = &instruments_[0];
+	if (multi_instrument_)
+	{
+		const int id = symbols_.find_or_add(decoded.symbol, decoded.symbol_len);
+		if (id < 0)
 		{
-		case 'A': ob_.on_order_add(action_side, order_id, price, volume); break;
-		case 'M': ob_.on_order_modify(action_side, order_id, price, volume); break;
-		case 'X': ob_.on_order_remove(action_side, order_id); break;
-		default: record_failure(); return;
+			output.line(decoded.line, decoded.len);
+			output.unparsable();
+			++parse_failure_count_;
+			++unknown_instrument_count_;
+			return;
 		}
 
-		//print out the midpoint
-		const auto midpoint = ob_.get_midpoint();
-		if (midpoint == 0)
+		inst = &instruments_[id];
+		if (inst->stats.symbol.empty())
 		{
-			os_ << "NAN" << std::endl;
+			inst->stats.symbol = symbols_.name(id);
 		}
-		else
+	}
+
+	const parsed_message &msg = decoded.msg;
+#ifdef FEEDHANDLER_LATENCY
+	const uint64_t apply_start = read_tsc();
+#endif
+
+	orderbook &ob = *inst->book;
+	++inst->stats.messages;
+	switch (msg.type)
+	{
+	case message_type::add: ob.on_order_add(msg.order_side, msg.order_id, msg.price, msg.volume); break;
+	case message_type::modify: ob.on_order_modify(msg.order_side, msg.order_id, msg.price, msg.volume); break;
+	case message_type::remove: ob.on_order_remove(msg.order_side, msg.order_id); break;
+	case message_type::trade:
+		if (ob.on_trade(msg.price, msg.volume))
 		{
-			os_ << midpoint << std::endl;
+			++inst->stats.trades;
+			inst->stats.traded_volume += msg.volume;
 		}
+		break;
+	}
+#ifdef FEEDHANDLER_LATENCY
+	const uint64_t output_start = read_tsc();
+#endif
+
+	if (msg.type == message_type::trade)
+	{
+		//output the trade stats every message
+		const auto &trade_stats = ob.get_current_trade_stats();
+		output.line(decoded.line, decoded.len);
+		output.trade(trade_stats.cumulative_trade_volume, trade_stats.last_trade_price);
+	}
+	else if (conflation_ == conflation_mode::none)
+	{
+		//print out the midpoint
+		output.line(decoded.line, decoded.len);
+		output.midpoint(ob.get_midpoint());
 	}
 	else
 	{
-		record_failure();
-		return;
+		conflate(output, decoded, *inst);
 	}
 
 	++messages_processed_;
 	if (ob_print_frequency_ != 0 && messages_processed_ == ob_print_frequency_)
 	{
 		//print the ob
-		os_ << std::endl << std::endl << "Current Orderbook:" << std::endl;
-		ob_.print_ob(os_);
-		os_ << std::endl;
+		if (ob.get_depth().levels() != 0)
+		{
+			print_depth(output, *inst);
+		}
+		else
+		{
+			output.book(ob, inst->stats.symbol);
+		}
 		messages_processed_ = 0;
 	}
+
+#ifdef FEEDHANDLER_LATENCY
+	latencies_.at(feed_latencies::parse, msg.type).record(decoded.parse_ticks);
+	latencies_.at(feed_latencies::apply, msg.type).record(output_start - apply_start);
+	latencies_.at(feed_latencies::output, msg.type).record(read_tsc() - output_start);
+#endif
+}
+
+template <typename Output>
+void feedhandler::print_depth(Output &output, instrument &inst)
+{
+	const book_depth &depth = inst.book->get_depth();
+	bool changed = false;
+	for (const side s : {side::bid, side::ask})
+	{
+		std::vector<depth_level> &changes = depth_changes_[(int)s];
+		const std::vector<depth_level> &levels = depth.side_levels(s);
+		if (depth_updates_)
+		{
+			changes.clear();
+			for_each_depth_change(s, inst.printed[(int)s], levels, [&changes](const depth_level &level)
+			{
+				changes.push_back(level);
+			});
+			inst.printed[(int)s] = levels;
+		}
+		else
+		{
+			changes = levels;
+		}
+		changed |= !changes.empty();
+	}
+
+	//an update with nothing in it isn't worth printing
+	if (depth_updates_ && !changed)
+	{
+		return;
+	}
+
+	//in descending price, as the book is printed: asks from the furthest in, then
+	//bids from the touch out
+	output.depth_begin(inst.stats.symbol, depth_updates_);
+	const std::vector<depth_level> &asks = depth_changes_[(int)side::ask];
+	for (auto level = asks.rbegin(); level != asks.rend(); ++level)
+	{
+		output.depth_price(side::ask, *level);
+	}
+	for (const auto &level : depth_changes_[(int)side::bid])
+	{
+		output.depth_price(side::bid, level);
+	}
+	output.depth_end();
+}
+
+template <typename Output>
+void feedhandler::conflate(Output &output, const decoded_message &decoded, instrument &inst)
+{
+	const orderbook &ob = *inst.book;
+	const uint64_t changes = conflation_ == conflation_mode::top ? ob.get_top_changes() : ob.get_midpoint_changes();
+	if (changes == inst.seen_changes)
+	{
+		return;
+	}
+	inst.seen_changes = changes;
+
+	if (windowed_)
+	{
+		inst.pending_line.assign(decoded.line, decoded.len);
+		if (!inst.pending)
+		{
+			inst.pending = true;
+			pending_.push_back(&inst);
+		}
+		return;
+	}
+
+	output.line(decoded.line, decoded.len);
+	output.midpoint(inst.printed_midpoint = ob.get_midpoint());
+}
+
+template <typename Output>
+void feedhandler::next_window_message(Output &output)
+{
+	if (window_messages_ != 0)
+	{
+		if (window_count_ == window_messages_)
+		{
+			end_window(output);
+			window_count_ = 0;
+		}
+		++window_count_;
+	}
+	else
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (now - window_start_ >= window_time_)
+		{
+			end_window(output);
+			window_start_ = now;
+		}
+	}
+}
+
+template <typename Output>
+void feedhandler::end_window(Output &output)
+{
+	for (instrument *inst : pending_)
+	{
+		inst->pending = false;
+		const double midpoint = inst->book->get_midpoint();
+		if (conflation_ == conflation_mode::midpoint && midpoint == inst->printed_midpoint)
+		{
+			continue;
+		}
+		output.line(inst->pending_line.data(), inst->pending_line.size());
+		output.midpoint(inst->printed_midpoint = midpoint);
+	}
+	pending_.clear();
 }
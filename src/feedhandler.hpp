@@ -1,32 +1,312 @@
-
 #ifndef _FEEDHANDLER_H_
 #define _FEEDHANDLER_H_
 
 #include "orderbook.hpp"
+#include "book_checkpoint.hpp"
+#include "message_parser.hpp"
+#include "output_sink.hpp"
+#include "async_output.hpp"
+#include "latency_histogram.hpp"
+#include "live_metrics.hpp"
+#include "symbol_directory.hpp"
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//which adds, modifies and removes have their midpoint printed
+enum class conflation_mode
+{
+	none,		//every one
+	top,		//those that changed the best level of either side
+	midpoint	//those that changed the midpoint
+};
+
+struct feedhandler_options
+{
+	//prices in the feed are converted to ticks of this size as they're parsed
+	tick_size ticks;
+
+	//where the book's nodes come from, and how orders are looked up by id
+	node_pool_options pool;
+	order_index_options index;
+
+	//0 for a feed of one instrument in the plain format. otherwise every line starts
+	//with the symbol of its instrument, e.g. "VOD.L,A,1,B,100,10.5", and there's
+	//room for this many instruments, each with its own book and a pool of the size
+	//above. the books are all built up front
+	size_t max_instruments = 0;
+
+	//0 to print the whole book every so often. otherwise print the best this many
+	//levels of each side, added up, which the books keep as they change; and with
+	//depth_updates, only the levels that have changed since the book was last printed
+	size_t depth_levels = 0;
+	bool depth_updates = false;
+
+	//lines that aren't printed under conflation aren't echoed either. with a window of
+	//either so many messages or so many microseconds, nothing is printed as the touch
+	//changes; instead at the end of each window, every instrument whose touch changed
+	//in it has the last line that changed it printed, with the midpoint, unless the
+	//midpoint is the one it last printed and that's all that's being watched. trades
+	//and unparsable lines are printed as ever. a time window ends with the first
+	//message after it's up, or a flush
+	conflation_mode conflation = conflation_mode::none;
+	size_t conflation_window_messages = 0;
+	uint64_t conflation_window_us = 0;
+
+	//format and write the output on a separate thread, fed through a ring of this
+	//many records
+	bool async = false;
+	size_t async_ring_records = async_output::default_capacity;
+
+	//if set, the counters are copied into this shared memory slot every so many
+	//messages, and on a flush
+	live_metrics_slot *live_metrics = nullptr;
+	size_t live_metrics_messages = 4096;
+};
+
+#ifdef FEEDHANDLER_LATENCY
+//with FEEDHANDLER_LATENCY defined, each message that gets as far as a book is timed
+//with the tsc through each stage: parsing its line, applying it to the book, and
+//printing what it changed (or handing it to the output thread). without it, none of
+//this is compiled in
+struct feed_latencies
+{
+	enum stage
+	{
+		parse,
+		apply,
+		output,
+		stages
+	};
+	static constexpr size_t message_types = (size_t)message_type::trade + 1;
+
+	//in tsc ticks
+	latency_histogram histograms[stages][message_types];
+
+	latency_histogram &at(stage s, message_type type) { return histograms[s][(size_t)type]; }
+	const latency_histogram &at(stage s, message_type type) const { return histograms[s][(size_t)type]; }
+
+	feed_latencies &operator+=(const feed_latencies &other)
+	{
+		for (size_t s = 0; s < stages; ++s)
+		{
+			for (size_t type = 0; type < message_types; ++type)
+			{
+				histograms[s][type] += other.histograms[s][type];
+			}
+		}
+		return *this;
+	}
+};
+#endif
+
+//what print_stats reports, gathered up so that the stats of several feedhandlers
+//can be merged
+struct feed_stats
+{
+	struct instrument
+	{
+		//the symbol as it appears in the feed, empty for a single instrument feed
+		std::string symbol;
+
+		int messages = 0;
+		int unparsable = 0;
+		int trades = 0;
+		uint64_t traded_volume = 0;
+
+		//from the instrument's book when the stats were taken
+		int bid_orders = 0;
+		int ask_orders = 0;
+		int book_errors = 0;
+	};
+
+	int messages = 0;	//every line, parsed or not
+	int unparsable = 0;
+	orderbook::error_stats book_errors;
+
+	//the rest is only reported for a multi instrument feed
+	bool multi_instrument = false;
+	size_t instrument_capacity = 0;
+	int unknown_instruments = 0;
+
+	//in order of first sighting
+	std::vector<instrument> instruments;
+
+#ifdef FEEDHANDLER_LATENCY
+	feed_latencies latencies;
+#endif
+};
+
+//the error stats, the instrument stats for a multi instrument feed, and the latencies
+//if they're being timed
+void write_feed_stats(output_sink &out, const feed_stats &stats);
+
+//a line taken as far as it can be without going near any books: the symbol split off
+//a multi instrument line, and the rest parsed
+struct decoded_message
+{
+	//the whole line, which has to outlive the decoded message
+	const char *line = nullptr;
+	size_t len = 0;
+
+	//multi instrument feeds only; null if the line has no symbol
+	const char *symbol = nullptr;
+	size_t symbol_len = 0;
+
+	//false if the line, bar any symbol, couldn't be parsed
+	bool parsed = false;
+	parsed_message msg;
+
+#ifdef FEEDHANDLER_LATENCY
+	//how long parsing took, which is counted when the message is applied so that
+	//decoding can stay on a thread of its own
+	uint64_t parse_ticks = 0;
+#endif
+};
 
 class feedhandler
 {
 public:
 	//initialise with how often to print the orderbook and the stream to write it to
-	feedhandler(int ob_print_frequency, std::ostream &os);
+	feedhandler(int ob_print_frequency, std::ostream &os, const feedhandler_options &options = feedhandler_options());
+
+	//waits for any checkpoint still being written
+	~feedhandler();
 
-	//print stats on the feed we've been processing
+	//print stats on the feed we've been processing, and flush everything out
 	void print_stats() const;
 
+	//the stats print_stats reports, bar those of the async output
+	feed_stats get_stats() const;
+
+	//output is buffered; push everything so far out to the stream
+	void flush();
+
 	//process the message
 	void process_message(const std::string &line);
 
-private:
-	void record_failure();
+	//process the message held in line[0, len); the line needn't be null terminated
+	void process_message(const char *line, size_t len);
+
+	//process_message in two halves. decoding only reads the feedhandler's settings,
+	//so it can be done on another thread to the one applying messages, as long as
+	//the messages are applied in feed order
+	void decode_message(const char *line, size_t len, decoded_message &decoded) const;
+	void apply_message(const decoded_message &decoded);
+
+	//checkpoint the books, and what's been counted of the feed, as of input_offset,
+	//which is where the feed would be picked up from after a restore. the feed only
+	//waits while the books are copied out; the file's written on a thread of its
+	//own, which the next checkpoint waits for if it's still going. the depth last
+	//printed for depth updates and the state of a conflation window aren't kept, so
+	//a resumed feed only prints the same as an uninterrupted one without them
+	//returns false if the last checkpoint couldn't be written
+	bool checkpoint(const char *filename, uint64_t input_offset, checkpoint_offset offset_kind);
+
+	//wait for the last checkpoint to be written; returns false if it couldn't be
+	bool wait_for_checkpoint();
+
+	//load a checkpoint into a feedhandler with the same settings that hasn't been
+	//given any messages, and say where the feed it was taken from left off
+	//returns false if it can't be read or doesn't fit, which leaves the books part
+	//restored
+	bool restore(const char *filename, uint64_t &input_offset, checkpoint_offset &offset_kind);
+
+private: //types
+	struct instrument
+	{
+		std::unique_ptr<orderbook> book;
+		feed_stats::instrument stats;
+
+		//each side's depth as it was last printed, for depth updates
+		std::vector<depth_level> printed[2];
+
+		//for conflation: the book's count of changes when last looked at, the
+		//midpoint last printed, and in a window, the last line to change the touch
+		uint64_t seen_changes = 0;
+		double printed_midpoint = 0;
+		bool pending = false;
+		std::string pending_line;
+	};
+
+private: //methods
+	//apply the message, writing its output through either an inline_output or
+	//the async_output
+	template <typename Output>
+	void apply_message(Output &output, const decoded_message &decoded);
+
+	//print the instrument's book as depth, rather than in full
+	template <typename Output>
+	void print_depth(Output &output, instrument &inst);
+
+	//print the midpoint after an add, modify or remove if it's to be printed now, or
+	//hold the line back for the end of the window
+	template <typename Output>
+	void conflate(Output &output, const decoded_message &decoded, instrument &inst);
+
+	//copy the counters into the live metrics slot
+	void publish_live_metrics();
+
+	//end the window if it's up, before the next message goes in
+	template <typename Output>
+	void next_window_message(Output &output);
+
+	//print the latest line of each instrument whose touch changed in the window
+	template <typename Output>
+	void end_window(Output &output);
 
 private: //state
 	const int ob_print_frequency_;
-	std::ostream &os_;
+	const bool depth_updates_;
+
+	//the depth levels being printed, gathered up for a side at a time
+	std::vector<depth_level> depth_changes_[2];
+
+	const conflation_mode conflation_;
+	const bool windowed_;
+	const size_t window_messages_;
+	const std::chrono::steady_clock::duration window_time_;
+
+	//the window so far, and the instruments with a line held back in it, in the order
+	//their touches first changed
+	size_t window_count_ = 0;
+	std::chrono::steady_clock::time_point window_start_;
+	std::vector<instrument *> pending_;
+
+	//buffered in front of the stream we were given; mutable so that stats can be flushed
+	mutable output_sink out_;
+
+	//set if the output is formatted on its own thread, in which case out_ is only
+	//used for the stats
+	std::unique_ptr<async_output> async_;
+
+	message_parser parser_;
+
+	//a multi instrument feed's symbols are interned as indexes into instruments_
+	const bool multi_instrument_;
+	symbol_directory symbols_;
+	std::vector<instrument> instruments_;
 
-	orderbook ob_;
 	int parse_failure_count_ = 0;
+	int unknown_instrument_count_ = 0;
 	int messages_processed_ = 0;
+
+#ifdef FEEDHANDLER_LATENCY
+	feed_latencies latencies_;
+#endif
+
+	live_metrics_slot *const live_metrics_;
+	const size_t live_metrics_messages_;
+	size_t messages_since_published_ = 0;
+
+	//the last checkpoint, and the thread writing it out
+	checkpoint_builder checkpoint_;
+	std::string checkpoint_filename_;
+	std::thread checkpoint_writer_;
+	bool checkpoint_written_ = true;
 };
 
 #endif
@@ -7,43 +7,583 @@
 //============================================================================
 
 #include "feedhandler.hpp"
+#include "sharded_feedhandler.hpp"
+#include "pipelined_replay.hpp"
+#include "parallel_replay.hpp"
+#include "mapped_file.hpp"
+#include "capture_replay.hpp"
+#include "live_metrics.hpp"
+#include "perf_counters.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <unistd.h>
 
 using namespace std;
 
+namespace
+{
+	void usage()
+	{
+		std::cout << "Must supply filename" << std::endl;
+		std::cout << "usage: feedhandler [-m|-P|-j threads|-b] [-d decimals] [-p pool_mb] [-H] [-i hashed|direct] [-a] [-r ring_records] [-e]" << std::endl;
+		std::cout << "           [-n levels [-u]] [-C top|midpoint [-w messages|-W micros]]" << std::endl;
+		std::cout << "           [-k checkpoint_filename [-K messages] [-R]] [-l metrics_name]" << std::endl;
+		std::cout << "           [-s max_instruments] [-t shards] [-c cpu,cpu...] [-o output_prefix] <filename>" << std::endl;
+		std::cout << "  -m  memory-map the file instead of reading it line by line" << std::endl;
+		std::cout << "  -P  read, parse and apply the file on three pipelined threads" << std::endl;
+		std::cout << "  -j  memory-map the file and parse it on this many threads, 0 for one per core" << std::endl;
+		std::cout << "  -b  the file is a binary capture written by the converter; its tick size and" << std::endl;
+		std::cout << "      instruments are taken from it" << std::endl;
+		std::cout << "  -d  number of decimal places in a tick, e.g. 2 for a 0.01 tick (default 2)" << std::endl;
+		std::cout << "  -p  megabytes to reserve for the book's order and level nodes (default 16)" << std::endl;
+		std::cout << "  -H  back the node pool with huge pages where available" << std::endl;
+		std::cout << "  -i  order id index: hashed for any ids (default), direct for dense ids" << std::endl;
+		std::cout << "  -n  print the best this many levels of the book, rather than every order" << std::endl;
+		std::cout << "  -u  print only the levels that changed since the book was last printed; needs -n" << std::endl;
+		std::cout << "  -C  only print the midpoint after a message that changed the best level of" << std::endl;
+		std::cout << "      either side (top), or the midpoint itself (midpoint)" << std::endl;
+		std::cout << "  -w  with -C, print the latest change of each instrument once every this many messages" << std::endl;
+		std::cout << "  -W  with -C, print the latest change of each instrument once every this many microseconds" << std::endl;
+		std::cout << "  -k  the file checkpoints are written to, and restored from" << std::endl;
+		std::cout << "  -K  checkpoint the books every this many messages; needs -k, and not -u, -w or -W" << std::endl;
+		std::cout << "  -R  restore the books from the checkpoint and carry on from where it was taken; needs -k" << std::endl;
+		std::cout << "  -a  format and write the output on its own thread" << std::endl;
+		std::cout << "  -r  records in the ring feeding the output thread (default " << async_output::default_capacity << ")" << std::endl;
+		std::cout << "  -l  publish the counters to the shared memory segment of this name as the feed" << std::endl;
+		std::cout << "      is replayed, for the metrics tool to watch" << std::endl;
+		std::cout << "  -e  count cycles, instructions, cache and branch misses over the replay, on every" << std::endl;
+		std::cout << "      thread, and report them per message after the stats" << std::endl;
+		std::cout << "  -s  lines start with an instrument symbol; book up to this many instruments" << std::endl;
+		std::cout << "  -t  spread the instruments over this many threads; needs -s" << std::endl;
+		std::cout << "  -c  cpus to pin the threads to, in turn" << std::endl;
+		std::cout << "  -o  write each thread's output to <output_prefix>.<n> rather than dropping it" << std::endl;
+	}
+
+	//parse a comma separated list of cpus
+	bool parse_cpus(const char *text, std::vector<int> &cpus)
+	{
+		while (*text)
+		{
+			char *end;
+			const long cpu = strtol(text, &end, 10);
+			if (end == text || cpu < 0 || cpu >= CPU_SETSIZE || (*end != ',' && *end != '\0'))
+			{
+				return false;
+			}
+			cpus.push_back(static_cast<int>(cpu));
+			text = *end ? end + 1 : end;
+		}
+		return !cpus.empty();
+	}
+
+	//checkpoints taken as the feed's replayed, and where a restored one left off
+	struct checkpointing
+	{
+		const char *filename = nullptr;
+		int every = 0;	//messages between checkpoints, 0 for none
+		int count = 0;
+		uint64_t resume_from = 0;	//bytes into a text feed, or records into a capture
+	};
+
+	bool checkpoint_due(checkpointing &cp)
+	{
+		if (cp.every == 0 || ++cp.count != cp.every)
+		{
+			return false;
+		}
+		cp.count = 0;
+		return true;
+	}
+
+	void take_checkpoint(feedhandler &fh, const checkpointing &cp, uint64_t offset, checkpoint_offset offset_kind)
+	{
+		if (!fh.checkpoint(cp.filename, offset, offset_kind))
+		{
+			std::cout << "Failed writing checkpoint " << cp.filename << std::endl;
+		}
+	}
+
+	void end_checkpoints(feedhandler &fh, const checkpointing &cp)
+	{
+		if (!fh.wait_for_checkpoint())
+		{
+			std::cout << "Failed writing checkpoint " << cp.filename << std::endl;
+		}
+	}
+
+	//shards aren't checkpointed, which is checked for up front
+	void take_checkpoint(sharded_feedhandler &, const checkpointing &, uint64_t, checkpoint_offset)
+	{
+
+	}
+
+	void end_checkpoints(sharded_feedhandler &, const checkpointing &)
+	{
+
+	}
+
+	//replay the file through a line-by-line stream
+	template <typename Handler>
+	bool replay_stream(const char *filename, Handler &fh, checkpointing &cp)
+	{
+		ifstream infile;
+		infile.open(filename);
+		if (!infile.is_open())
+		{
+			std::cout << "Cannot open file " << filename << std::endl;
+			return false;
+		}
+		std::cout << "Successfully opened file " << filename << std::endl;
+
+		infile.seekg(0, std::ios::end);
+		const std::streamoff size = infile.tellg();
+		if (size < 0 || cp.resume_from > static_cast<uint64_t>(size) || !infile.seekg(cp.resume_from))
+		{
+			std::cout << "Checkpoint was taken further in than the end of " << filename << std::endl;
+			return false;
+		}
+
+		//tellg can't be trusted once the last line has hit the end of the file, so
+		//the offset is counted up a line, and its newline if it had one, at a time
+		uint64_t offset = cp.resume_from;
+		std::string line;
+		while (getline(infile, line))
+		{
+			offset += line.size() + (infile.eof() ? 0 : 1);
+			if (line.empty())
+			{
+				continue;
+			}
+			fh.process_message(line);
+			if (checkpoint_due(cp))
+			{
+				take_checkpoint(fh, cp, offset, checkpoint_offset::bytes);
+			}
+		}
+		fh.flush();
+		end_checkpoints(fh, cp);
+
+		infile.close();
+		return true;
+	}
+
+	//replay the file by mapping it and handing out slices of the mapping
+	template <typename Handler>
+	bool replay_mapped(const char *filename, Handler &fh, checkpointing &cp)
+	{
+		mapped_file infile;
+		if (!infile.open(filename))
+		{
+			std::cout << "Cannot open file " << filename << std::endl;
+			return false;
+		}
+		std::cout << "Successfully opened file " << filename << std::endl;
+
+		if (cp.resume_from > infile.size())
+		{
+			std::cout << "Checkpoint was taken further in than the end of " << filename << std::endl;
+			return false;
+		}
+
+		for_each_line(infile.data() + cp.resume_from, infile.size() - cp.resume_from, [&](const char *line, size_t len)
+		{
+			fh.process_message(line, len);
+			if (checkpoint_due(cp))
+			{
+				take_checkpoint(fh, cp, line + len - infile.data(), checkpoint_offset::bytes);
+			}
+		});
+		fh.flush();
+		end_checkpoints(fh, cp);
+		return true;
+	}
+
+	//replay the file through a read/parse/apply pipeline
+	bool replay_pipelined(const char *filename, feedhandler &fh)
+	{
+		pipelined_replay pipeline;
+		if (!pipeline.open(filename))
+		{
+			std::cout << "Cannot open file " << filename << std::endl;
+			return false;
+		}
+		std::cout << "Successfully opened file " << filename << std::endl;
+
+		pipeline.run(fh);
+		fh.flush();
+		return true;
+	}
+
+	//replay the file by parsing chunks of it in parallel
+	bool replay_parallel(const char *filename, unsigned threads, feedhandler &fh)
+	{
+		parallel_options options;
+		options.threads = threads;
+		parallel_replay replay(options);
+		if (!replay.open(filename))
+		{
+			std::cout << "Cannot open file " << filename << std::endl;
+			return false;
+		}
+		std::cout << "Successfully opened file " << filename << std::endl;
+
+		replay.run(fh);
+		fh.flush();
+		return true;
+	}
+
+	//a feedhandler takes a capture's messages as they are; a sharded feedhandler
+	//parses on its shards, so it's handed the line
+	void replay_record(feedhandler &fh, const decoded_message &decoded)
+	{
+		fh.apply_message(decoded);
+	}
+
+	void replay_record(sharded_feedhandler &fh, const decoded_message &decoded)
+	{
+		fh.process_message(decoded.line, decoded.len);
+	}
+
+	//replay a capture, whose records are already parsed
+	template <typename Handler>
+	bool replay_capture(const capture_reader &capture, Handler &fh, checkpointing &cp)
+	{
+		if (cp.resume_from > capture.record_count())
+		{
+			std::cout << "Checkpoint was taken further in than the end of the capture" << std::endl;
+			return false;
+		}
+
+		uint64_t records = cp.resume_from;
+		const bool ok = for_each_capture_message(capture, [&](const decoded_message &decoded)
+		{
+			replay_record(fh, decoded);
+			++records;
+			if (checkpoint_due(cp))
+			{
+				take_checkpoint(fh, cp, records, checkpoint_offset::records);
+			}
+		}, cp.resume_from);
+		fh.flush();
+		end_checkpoints(fh, cp);
+		if (!ok)
+		{
+			std::cout << "Capture has a bad record" << std::endl;
+		}
+		return ok;
+	}
+
+	//the pipeline and the parallel parse only drive a single feedhandler, which is
+	//checked for up front
+	bool replay_pipelined(const char *, sharded_feedhandler &)
+	{
+		return false;
+	}
+
+	bool replay_parallel(const char *, unsigned, sharded_feedhandler &)
+	{
+		return false;
+	}
+
+	//the counters per message, after the feed's stats
+	void write_perf_report(std::ostream &os, const perf_counters::reading &counted, int messages)
+	{
+		os << "PERF COUNTERS (per message, all threads, user space):" << '\n';
+		os << "  messages: " << messages << '\n';
+		for (int c = 0; c < perf_counters::counter_count; ++c)
+		{
+			os << "  " << perf_counters::name((perf_counters::counter)c) << ": ";
+			if (!counted.counted[c])
+			{
+				os << "not available" << '\n';
+				continue;
+			}
+			os << (messages == 0 ? 0 : counted.values[c] / messages);
+			if (c == perf_counters::instructions && counted.counted[perf_counters::cycles] && counted.values[perf_counters::cycles] != 0)
+			{
+				os << " (" << counted.values[c] / counted.values[perf_counters::cycles] << " per cycle)";
+			}
+			os << '\n';
+		}
+		os << std::endl;
+	}
+
+	enum class replay_mode
+	{
+		stream,
+		mapped,
+		pipelined,
+		parallel,
+		capture
+	};
+
+	//counters is null if the replay isn't being profiled
+	template <typename Handler>
+	int replay(const char *filename, replay_mode mode, unsigned threads, const capture_reader &capture, checkpointing &cp,
+			perf_counters *counters, Handler &fh)
+	{
+		if (counters)
+		{
+			counters->start();
+		}
+
+		bool ok = false;
+		switch (mode)
+		{
+		case replay_mode::stream: ok = replay_stream(filename, fh, cp); break;
+		case replay_mode::mapped: ok = replay_mapped(filename, fh, cp); break;
+		case replay_mode::pipelined: ok = replay_pipelined(filename, fh); break;
+		case replay_mode::parallel: ok = replay_parallel(filename, threads, fh); break;
+		case replay_mode::capture: ok = replay_capture(capture, fh, cp); break;
+		}
+		if (counters)
+		{
+			counters->stop();
+		}
+		if (!ok)
+		{
+			return 1;
+		}
+
+		fh.print_stats();
+		if (counters)
+		{
+			write_perf_report(std::cerr, counters->read(), fh.get_stats().messages);
+		}
+		return 0;
+	}
+}
+
 int main(int argc, char **argv) {
 
-	if (argc != 2)
+	replay_mode mode = replay_mode::stream;
+	int parse_threads = 0;
+	int tick_decimals = 2;
+	int pool_mb = 16;
+	int ring_records = async_output::default_capacity;
+	int max_instruments = 0;
+	int depth_levels = 0;
+	long long window_messages = 0;
+	long long window_us = 0;
+	int shards = 0;
+	const char *output_prefix = nullptr;
+	checkpointing checkpoints;
+	bool restore = false;
+	bool profile = false;
+	const char *metrics_name = nullptr;
+	feedhandler_options options;
+	sharded_options sharding;
+	int opt;
+	while ((opt = getopt(argc, argv, "mPj:bd:p:Hi:n:uC:w:W:k:K:Rar:el:s:t:c:o:")) != -1)
 	{
-		std::cout << "Must supply filename" << std::endl;
+		switch (opt)
+		{
+		case 'm': mode = replay_mode::mapped; break;
+		case 'P': mode = replay_mode::pipelined; break;
+		case 'j': mode = replay_mode::parallel; parse_threads = atoi(optarg); break;
+		case 'b': mode = replay_mode::capture; break;
+		case 'd': tick_decimals = atoi(optarg); break;
+		case 'p': pool_mb = atoi(optarg); break;
+		case 'H': options.pool.hugepages = true; break;
+		case 'i':
+			if (strcmp(optarg, "hashed") == 0) options.index.kind = order_index_kind::hashed;
+			else if (strcmp(optarg, "direct") == 0) options.index.kind = order_index_kind::direct;
+			else { usage(); return 1; }
+			break;
+		case 'n': depth_levels = atoi(optarg); break;
+		case 'u': options.depth_updates = true; break;
+		case 'C':
+			if (strcmp(optarg, "top") == 0) options.conflation = conflation_mode::top;
+			else if (strcmp(optarg, "midpoint") == 0) options.conflation = conflation_mode::midpoint;
+			else { usage(); return 1; }
+			break;
+		case 'w': window_messages = atoll(optarg); break;
+		case 'W': window_us = atoll(optarg); break;
+		case 'k': checkpoints.filename = optarg; break;
+		case 'K': checkpoints.every = atoi(optarg); break;
+		case 'R': restore = true; break;
+		case 'a': options.async = true; break;
+		case 'r': ring_records = atoi(optarg); break;
+		case 'e': profile = true; break;
+		case 'l': metrics_name = optarg; break;
+		case 's': max_instruments = atoi(optarg); break;
+		case 't': shards = atoi(optarg); break;
+		case 'c':
+			if (!parse_cpus(optarg, sharding.cpus)) { usage(); return 1; }
+			break;
+		case 'o': output_prefix = optarg; break;
+		default: usage(); return 1;
+		}
+	}
+
+	if (tick_decimals < 0 || tick_decimals > tick_size::max_decimals)
+	{
+		std::cout << "Tick decimals must be between 0 and " << tick_size::max_decimals << std::endl;
+		return 1;
+	}
+
+	if (pool_mb < 0)
+	{
+		std::cout << "Pool size can't be negative" << std::endl;
+		return 1;
+	}
+	options.pool.capacity_bytes = static_cast<size_t>(pool_mb) << 20;
+
+	if (depth_levels < 0 || (options.depth_updates && depth_levels == 0))
+	{
+		std::cout << "Depth updates need a number of levels" << std::endl;
+		return 1;
+	}
+	options.depth_levels = depth_levels;
+
+	if (window_messages < 0 || window_us < 0 || (window_messages != 0 && window_us != 0)
+			|| ((window_messages != 0 || window_us != 0) && options.conflation == conflation_mode::none))
+	{
+		std::cout << "A conflation window is either messages or microseconds, and needs -C" << std::endl;
+		return 1;
+	}
+	options.conflation_window_messages = window_messages;
+	options.conflation_window_us = window_us;
+
+	if (ring_records <= 0)
+	{
+		std::cout << "Ring must have room for some records" << std::endl;
 		return 1;
 	}
+	options.async_ring_records = ring_records;
 
-	ifstream infile;
-	infile.open(argv[1]);
-	if (!infile.is_open())
+	if (max_instruments < 0)
 	{
-		std::cout << "Cannot open file " << argv[1] << std::endl;
+		std::cout << "Number of instruments can't be negative" << std::endl;
 		return 1;
 	}
-	std::cout << "Successfully opened file " << argv[1] << std::endl;
 
-	feedhandler fh(10, std::cerr);
-	std::string line;
-	while (!infile.eof() && !infile.bad())
+	if (optind != argc - 1)
 	{
-		getline(infile, line);
-		if (line.empty())
+		usage();
+		return 1;
+	}
+	const char *filename = argv[optind];
+
+	//a capture says what it holds, so it's opened before anything's built for it
+	options.ticks = tick_size(tick_decimals);
+	capture_reader capture;
+	if (mode == replay_mode::capture)
+	{
+		if (!capture.open(filename))
+		{
+			std::cout << "Cannot open capture " << filename << std::endl;
+			return 1;
+		}
+		std::cout << "Successfully opened file " << filename << std::endl;
+
+		options.ticks = capture.ticks();
+		max_instruments = capture.symbol_count() == 0 ? 0 : std::max<int>(max_instruments, capture.symbol_count());
+	}
+	options.max_instruments = max_instruments;
+
+	if (shards < 0 || (shards > 0 && max_instruments == 0))
+	{
+		std::cout << "Sharding needs a multi instrument feed" << std::endl;
+		return 1;
+	}
+	if (shards > 0 && (mode == replay_mode::pipelined || mode == replay_mode::parallel))
+	{
+		std::cout << "Only plain and memory-mapped replays can feed shards" << std::endl;
+		return 1;
+	}
+	if (checkpoints.every < 0 || ((checkpoints.every != 0 || restore) && !checkpoints.filename))
+	{
+		std::cout << "Checkpoints need a file" << std::endl;
+		return 1;
+	}
+	if ((checkpoints.every != 0 || restore) && (shards > 0 || mode == replay_mode::pipelined || mode == replay_mode::parallel))
+	{
+		std::cout << "Only a plain, memory-mapped or capture replay without shards can be checkpointed" << std::endl;
+		return 1;
+	}
+	if ((checkpoints.every != 0 || restore) && (options.depth_updates || window_messages != 0 || window_us != 0))
+	{
+		std::cout << "Depth updates and conflation windows can't be checkpointed" << std::endl;
+		return 1;
+	}
+	if (parse_threads < 0)
+	{
+		std::cout << "Number of parse threads can't be negative" << std::endl;
+		return 1;
+	}
+
+	//a slot for each shard's feedhandler, or the one
+	live_metrics_writer metrics;
+	if (metrics_name)
+	{
+		if (!metrics.open(metrics_name, std::max(shards, 1)))
+		{
+			std::cout << "Cannot create shared memory segment " << metrics_name << std::endl;
+			return 1;
+		}
+		options.live_metrics = metrics.slot(0);
+	}
+
+	//opened before anything starts a thread, so that every thread is counted
+	perf_counters counters;
+	if (profile)
+	{
+		std::string error;
+		if (!counters.open(error))
 		{
-			continue;
+			std::cout << "Hardware counters unavailable, replaying without them: " << error << std::endl;
+			profile = false;
 		}
-		fh.process_message(line);
 	}
 
-	infile.close();
+	if (shards == 0)
+	{
+		feedhandler fh(10, std::cerr, options);
+		if (restore)
+		{
+			checkpoint_offset offset_kind;
+			if (!fh.restore(checkpoints.filename, checkpoints.resume_from, offset_kind)
+					|| offset_kind != (mode == replay_mode::capture ? checkpoint_offset::records : checkpoint_offset::bytes))
+			{
+				std::cout << "Cannot restore checkpoint " << checkpoints.filename << std::endl;
+				return 1;
+			}
+			std::cout << "Restored checkpoint " << checkpoints.filename << std::endl;
+		}
+		return replay(filename, mode, parse_threads, capture, checkpoints, profile ? &counters : nullptr, fh);
+	}
 
-	fh.print_stats();
+	//each shard's output goes to its own file, or nowhere
+	std::vector<std::unique_ptr<std::ostream>> outputs;
+	std::vector<std::ostream *> shard_streams;
+	for (int i = 0; i < shards; ++i)
+	{
+		if (output_prefix)
+		{
+			const std::string name = std::string(output_prefix) + "." + std::to_string(i);
+			outputs.emplace_back(new std::ofstream(name));
+			if (!*outputs.back())
+			{
+				std::cout << "Cannot open file " << name << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			outputs.emplace_back(new std::ostream(nullptr));
+		}
+		shard_streams.push_back(outputs.back().get());
+	}
 
-	return 0;
+	sharding.feed = options;
+	sharding.shards = shards;
+	sharded_feedhandler fh(10, std::cerr, shard_streams, sharding);
+	return replay(filename, mode, parse_threads, capture, checkpoints, profile ? &counters : nullptr, fh);
 }
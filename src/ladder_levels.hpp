@@ -0,0 +1,369 @@
+#ifndef __LADDER_LEVELS_H__
+#define __LADDER_LEVELS_H__
+
+#include "side_policy.hpp"
+#include "map_levels.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+//one side of the book kept as a dense ladder of price levels covering a window of
+//ticks around the touch, so adding and removing near-touch levels is an array index
+//and finding the next best level is a bit scan rather than a tree walk.
+//
+//the window is a power of two and levels live in slot (price & mask), so moving the
+//window only touches the levels that cross its edges. prices that fall outside the
+//window live in an overflow tree. the window is recentred on a new price when that
+//price would become the best on the side, and on the best overflow level whenever
+//the window runs out of levels, so it follows the market as it drifts.
+//
+//levels move when they cross between the window and the overflow tree; callers pass
+//an on_move(price_level &) callback to hear about the level's new address.
+struct ladder_levels_options
+{
+	//number of ticks covered by the dense window; rounded up to a power of two
+	unsigned window_ticks = 4096;
+};
+
+template <typename Side>
+class ladder_levels
+{
+public:
+	typedef ladder_levels_options options;
+
+	//level nodes in the overflow tree, and all order nodes, come from the given pool
+	//if there is one
+	explicit ladder_levels(const options &opts = options(), node_pool *pool = nullptr)
+		: overflow_(map_levels_options(), pool)
+	{
+		size_t window = 64;
+		while (window < opts.window_ticks)
+		{
+			window <<= 1;
+		}
+		mask_ = window - 1;
+		slots_.assign(window, price_level(pool_allocator<book_order>(pool)));
+		occupied_.resize(window / 64);
+	}
+
+	bool empty() const { return ladder_count_ == 0 && overflow_.empty(); }
+	int size() const { return ladder_count_ + overflow_.size(); }
+
+	//number of levels currently held in the dense window
+	int window_size() const { return ladder_count_; }
+
+	price_level *find(price_t price)
+	{
+		return const_cast<price_level *>(static_cast<const ladder_levels<Side> *>(this)->find(price));
+	}
+
+	const price_level *find(price_t price) const
+	{
+		if (!in_window(price))
+		{
+			return overflow_.find(price);
+		}
+		const size_t slot = slot_of(price);
+		return is_occupied(slot) ? &slots_[slot] : nullptr;
+	}
+
+	//get the level at the given price, creating it if needed
+	template <typename OnMove>
+	price_level &insert(price_t price, OnMove on_move)
+	{
+		if (!in_window(price))
+		{
+			if (price_level *level = overflow_.find(price))
+			{
+				return *level;
+			}
+
+			//a new best price far from the window pulls the window over to it;
+			//anything else can wait in the overflow tree
+			price_t best;
+			if (ladder_count_ != 0 && !(ladder_best(best) && better(price, best)))
+			{
+				return overflow_.insert(price, on_move);
+			}
+			recentre(price, on_move);
+		}
+
+		const size_t slot = slot_of(price);
+		if (!is_occupied(slot))
+		{
+			set_occupied(slot);
+			++ladder_count_;
+		}
+		return slots_[slot];
+	}
+
+	//drop the (now empty) level at the given price
+	template <typename OnMove>
+	void erase(price_t price, OnMove on_move)
+	{
+		if (!in_window(price))
+		{
+			overflow_.erase(price, on_move);
+			return;
+		}
+
+		const size_t slot = slot_of(price);
+		clear_slot(slot);
+		--ladder_count_;
+
+		//the window's empty, so follow the market out to the best of what's left
+		price_t best;
+		if (ladder_count_ == 0 && overflow_.best_price(best))
+		{
+			recentre(best, on_move);
+		}
+	}
+
+	//cursors over the levels; each returns false if there's no such level
+	bool best_price(price_t &price) const
+	{
+		price_t from_window, from_overflow;
+		const bool have_window = ladder_best(from_window);
+		const bool have_overflow = overflow_.best_price(from_overflow);
+		return pick(have_window, from_window, have_overflow, from_overflow, true, price);
+	}
+
+	bool worst_price(price_t &price) const
+	{
+		price_t from_window, from_overflow;
+		const bool have_window = ladder_worst(from_window);
+		const bool have_overflow = overflow_.worst_price(from_overflow);
+		return pick(have_window, from_window, have_overflow, from_overflow, false, price);
+	}
+
+	bool next_worse(price_t &price) const
+	{
+		price_t from_window = price, from_overflow = price;
+		const bool have_window = ladder_next(from_window, false);
+		const bool have_overflow = overflow_.next_worse(from_overflow);
+		return pick(have_window, from_window, have_overflow, from_overflow, true, price);
+	}
+
+	bool next_better(price_t &price) const
+	{
+		price_t from_window = price, from_overflow = price;
+		const bool have_window = ladder_next(from_window, true);
+		const bool have_overflow = overflow_.next_better(from_overflow);
+		return pick(have_window, from_window, have_overflow, from_overflow, false, price);
+	}
+
+	//call f(price, level) from the best level to the worst until it returns false
+	template <typename F>
+	void for_each_level(F f) const
+	{
+		price_t price;
+		for (bool more = best_price(price); more; more = next_worse(price))
+		{
+			if (!f(price, *find(price)))
+			{
+				return;
+			}
+		}
+	}
+
+private: //methods
+	static bool better(price_t left, price_t right) { return Side::better(left, right); }
+
+	//true if better prices are higher, i.e. this is the bid side
+	static bool better_is_up() { return Side::value == side::bid; }
+
+	bool in_window(price_t price) const
+	{
+		return static_cast<uint64_t>(price - base_) <= mask_;
+	}
+
+	size_t slot_of(price_t price) const
+	{
+		return static_cast<uint64_t>(price) & mask_;
+	}
+
+	bool is_occupied(size_t slot) const { return (occupied_[slot >> 6] >> (slot & 63)) & 1; }
+	void set_occupied(size_t slot) { occupied_[slot >> 6] |= uint64_t(1) << (slot & 63); }
+	void clear_occupied(size_t slot) { occupied_[slot >> 6] &= ~(uint64_t(1) << (slot & 63)); }
+
+	//empty out a slot, keeping its allocator so that it's ready for reuse
+	void clear_slot(size_t slot)
+	{
+		price_level &level = slots_[slot];
+		level.total_volume = 0;
+		level.order_count = 0;
+		level.orders.clear();
+		clear_occupied(slot);
+	}
+
+	//offset (from the given window base) of the first occupied slot at or above the
+	//given offset, or -1 if there isn't one
+	int64_t scan_up(price_t base, int64_t offset) const
+	{
+		int64_t remaining = static_cast<int64_t>(mask_) + 1 - offset;
+		size_t slot = slot_of(base + offset);
+		while (remaining > 0)
+		{
+			const size_t bit = slot & 63;
+			uint64_t bits = occupied_[slot >> 6] >> bit;
+			const int64_t span = std::min<int64_t>(64 - bit, remaining);
+			if (span < 64)
+			{
+				bits &= (uint64_t(1) << span) - 1;
+			}
+			if (bits)
+			{
+				return offset + __builtin_ctzll(bits);
+			}
+			offset += span;
+			remaining -= span;
+			slot = (slot + span) & mask_;
+		}
+		return -1;
+	}
+
+	//offset of the first occupied slot at or below the given offset, or -1
+	int64_t scan_down(price_t base, int64_t offset) const
+	{
+		int64_t remaining = offset + 1;
+		size_t slot = slot_of(base + offset);
+		while (remaining > 0)
+		{
+			const size_t bit = slot & 63;
+			uint64_t bits = occupied_[slot >> 6] << (63 - bit);
+			const int64_t span = std::min<int64_t>(bit + 1, remaining);
+			if (span < 64)
+			{
+				bits &= ~((uint64_t(1) << (64 - span)) - 1);
+			}
+			if (bits)
+			{
+				return offset - __builtin_clzll(bits);
+			}
+			offset -= span;
+			remaining -= span;
+			slot = (slot - span) & mask_;
+		}
+		return -1;
+	}
+
+	bool ladder_best(price_t &price) const
+	{
+		if (ladder_count_ == 0) return false;
+		price = base_ + (better_is_up() ? scan_down(base_, mask_) : scan_up(base_, 0));
+		return true;
+	}
+
+	bool ladder_worst(price_t &price) const
+	{
+		if (ladder_count_ == 0) return false;
+		price = base_ + (better_is_up() ? scan_up(base_, 0) : scan_down(base_, mask_));
+		return true;
+	}
+
+	//move price to the nearest window level strictly above (up) or below it
+	bool ladder_next(price_t &price, bool towards_better) const
+	{
+		if (ladder_count_ == 0) return false;
+
+		const bool up = (towards_better == better_is_up());
+		const int64_t window = static_cast<int64_t>(mask_) + 1;
+		int64_t offset;
+		if (up)
+		{
+			offset = std::max<int64_t>(price - base_ + 1, 0);
+			offset = offset >= window ? -1 : scan_up(base_, offset);
+		}
+		else
+		{
+			offset = std::min<int64_t>(price - base_ - 1, window - 1);
+			offset = offset < 0 ? -1 : scan_down(base_, offset);
+		}
+		if (offset < 0) return false;
+		price = base_ + offset;
+		return true;
+	}
+
+	//choose between a window level and an overflow level, preferring the better
+	//one if prefer_better, otherwise the worse one
+	bool pick(bool have_left, price_t left, bool have_right, price_t right, bool prefer_better, price_t &price) const
+	{
+		if (!have_left && !have_right) return false;
+		if (!have_right || (have_left && better(left, right) == prefer_better))
+		{
+			price = left;
+		}
+		else
+		{
+			price = right;
+		}
+		return true;
+	}
+
+	//move the window so that it's centred on the given price, shuffling levels
+	//between the window and the overflow tree as they cross its edges
+	template <typename OnMove>
+	void recentre(price_t anchor, OnMove on_move)
+	{
+		const price_t old_base = base_;
+		const int64_t window = static_cast<int64_t>(mask_) + 1;
+		base_ = anchor - window / 2;
+
+		//push out the window levels that have fallen off the edge
+		for (int64_t offset = ladder_count_ ? scan_up(old_base, 0) : -1; offset >= 0;
+				offset = offset + 1 < window ? scan_up(old_base, offset + 1) : -1)
+		{
+			const price_t price = old_base + offset;
+			if (in_window(price))
+			{
+				continue;
+			}
+			const size_t slot = slot_of(price);
+			price_level &moved = overflow_.insert(price, on_move);
+			moved = std::move(slots_[slot]);
+			clear_slot(slot);
+			--ladder_count_;
+			on_move(moved);
+		}
+
+		//and pull in the overflow levels that are now inside it, which sit together
+		//in the overflow tree's best-to-worst order
+		price_t price;
+		for (bool more = overflow_.best_price(price); more; )
+		{
+			const price_t current = price;
+			more = overflow_.next_worse(price);
+			if (!in_window(current))
+			{
+				if (better(base_ + (better_is_up() ? 0 : window - 1), current))
+				{
+					break;
+				}
+				continue;
+			}
+
+			const size_t slot = slot_of(current);
+			slots_[slot] = std::move(*overflow_.find(current));
+			set_occupied(slot);
+			++ladder_count_;
+			overflow_.erase(current, on_move);
+			on_move(slots_[slot]);
+		}
+	}
+
+private: //state
+	//the window starts at base_ and covers mask_ + 1 ticks
+	price_t base_ = 0;
+	size_t mask_ = 0;
+
+	//one level per tick in the window, and a bit per slot saying whether it's in use
+	std::vector<price_level> slots_;
+	std::vector<uint64_t> occupied_;
+	int ladder_count_ = 0;
+
+	//levels outside the window
+	map_levels<Side> overflow_;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef __LATENCY_HISTOGRAM_H__
+#define __LATENCY_HISTOGRAM_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//the cpu's time stamp counter: a couple of dozen cycles to read, with no system call,
+//and on anything recent it ticks at a constant rate whatever the core's clock does.
+//elsewhere it's the steady clock in nanoseconds
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//how many tsc ticks there are to a nanosecond, timed against the steady clock the first
+//time it's asked for, which takes a few milliseconds
+inline double tsc_ticks_per_ns()
+{
+	static const double ticks_per_ns = []()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t start_ticks = read_tsc();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		const uint64_t ticks = read_tsc() - start_ticks;
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		return ns > 0 ? (double)ticks / ns : 1.0;
+#else
+		return 1.0;
+#endif
+	}();
+	return ticks_per_ns;
+}
+
+//counts of latencies in buckets that are linear within each power of two, as an hdr
+//histogram's are, so that every value's kept to within 1/sub_buckets of itself. the
+//buckets are a fixed array: recording is a bit scan, a shift and an increment, and
+//never allocates
+class latency_histogram
+{
+public:
+	static constexpr unsigned sub_bucket_bits = 5;
+	static constexpr uint64_t sub_buckets = 1 << sub_bucket_bits;
+
+	//values of 2^max_bits and up are counted in the last bucket, but still make the max
+	static constexpr unsigned max_bits = 40;
+	static constexpr size_t bucket_count = (max_bits - sub_bucket_bits + 1) * sub_buckets;
+
+	void record(uint64_t value)
+	{
+		++counts_[bucket_of(value)];
+		++count_;
+		max_ = std::max(max_, value);
+	}
+
+	uint64_t count() const { return count_; }
+	uint64_t max() const { return max_; }
+
+	//the value that the given fraction of those recorded are at or under, as the top
+	//of the bucket it falls in; 0 if there's nothing recorded
+	uint64_t value_at(double quantile) const
+	{
+		if (count_ == 0)
+		{
+			return 0;
+		}
+
+		const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(quantile * count_ + 0.999999));
+		uint64_t seen = 0;
+		for (size_t bucket = 0; bucket < bucket_count; ++bucket)
+		{
+			seen += counts_[bucket];
+			if (seen >= rank)
+			{
+				return std::min(highest_in(bucket), max_);
+			}
+		}
+		return max_;
+	}
+
+	//for totting up the histograms of several feedhandlers
+	latency_histogram &operator+=(const latency_histogram &other)
+	{
+		for (size_t bucket = 0; bucket < bucket_count; ++bucket)
+		{
+			counts_[bucket] += other.counts_[bucket];
+		}
+		count_ += other.count_;
+		max_ = std::max(max_, other.max_);
+		return *this;
+	}
+
+	//values under sub_buckets get a bucket each; above that, each power of two is split
+	//into sub_buckets buckets by the bits under its top one
+	static size_t bucket_of(uint64_t value)
+	{
+		value = std::min(value, (uint64_t(1) << max_bits) - 1);
+		if (value < sub_buckets)
+		{
+			return value;
+		}
+		const unsigned top_bit = 63 - __builtin_clzll(value);
+		const unsigned shift = top_bit - sub_bucket_bits;
+		return shift * sub_buckets + (value >> shift);
+	}
+
+	//the range of values counted in a bucket
+	static uint64_t lowest_in(size_t bucket)
+	{
+		if (bucket < sub_buckets)
+		{
+			return bucket;
+		}
+		const unsigned shift = bucket / sub_buckets - 1;
+		return (bucket - shift * sub_buckets) << shift;
+	}
+
+	static uint64_t highest_in(size_t bucket)
+	{
+		if (bucket < sub_buckets)
+		{
+			return bucket;
+		}
+		const unsigned shift = bucket / sub_buckets - 1;
+		return lowest_in(bucket) + (uint64_t(1) << shift) - 1;
+	}
+
+private: //state
+	uint64_t counts_[bucket_count] = {};
+	uint64_t count_ = 0;
+	uint64_t max_ = 0;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef __LIVE_METRICS_H__
+#define __LIVE_METRICS_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//the counters a running feedhandler publishes for other processes to watch, in a
+//posix shared memory segment laid out as:
+//  live_metrics_header
+//  slot_count live_metrics_slots, one for each feedhandler, so one for each shard
+//each slot has a single writer, the thread applying its feedhandler's messages, which
+//copies its counters in with relaxed stores every so many messages: plain stores to
+//cache lines that no other thread writes, with no lock and no system call. readers
+//load them whenever they like, and may see one publish half done
+
+static const char live_metrics_magic[8] = {'F', 'H', 'M', 'E', 'T', 'R', 'I', 'C'};
+static const uint32_t live_metrics_version = 1;
+
+struct live_metrics_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_count;
+	int64_t pid;	//of the feedhandler, so a reader can tell if it's gone
+	uint8_t reserved[40];
+};
+static_assert(sizeof(live_metrics_header) == 64, "the live metrics header is a cache line");
+
+//the same counters as values, as a reader takes them out of a slot or adds them up
+struct live_metrics_snapshot
+{
+	uint64_t publishes = 0;
+	uint64_t messages = 0;	//every line, parsed or not
+	uint64_t unparsable = 0;
+	uint64_t unknown_instruments = 0;
+	uint64_t instruments = 0;
+	uint64_t trades = 0;
+	uint64_t traded_volume = 0;
+	uint64_t bid_orders = 0;
+	uint64_t ask_orders = 0;
+
+	//the books' error stats
+	uint64_t duplicate_order_ids = 0;
+	uint64_t trade_without_order = 0;
+	uint64_t removes_without_order = 0;
+	uint64_t modifies_without_order = 0;
+	uint64_t crossed_book_no_trades = 0;
+	uint64_t invalid_inputs = 0;
+
+	uint64_t book_errors() const
+	{
+		return duplicate_order_ids + trade_without_order + removes_without_order
+				+ modifies_without_order + crossed_book_no_trades + invalid_inputs;
+	}
+
+	live_metrics_snapshot &operator+=(const live_metrics_snapshot &other)
+	{
+		publishes += other.publishes;
+		messages += other.messages;
+		unparsable += other.unparsable;
+		unknown_instruments += other.unknown_instruments;
+		instruments += other.instruments;
+		trades += other.trades;
+		traded_volume += other.traded_volume;
+		bid_orders += other.bid_orders;
+		ask_orders += other.ask_orders;
+		duplicate_order_ids += other.duplicate_order_ids;
+		trade_without_order += other.trade_without_order;
+		removes_without_order += other.removes_without_order;
+		modifies_without_order += other.modifies_without_order;
+		crossed_book_no_trades += other.crossed_book_no_trades;
+		invalid_inputs += other.invalid_inputs;
+		return *this;
+	}
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "live metrics are shared between processes, so can't take locks");
+
+//a slot starts on a cache line of its own so that no two writers share one
+struct alignas(64) live_metrics_slot
+{
+	std::atomic<uint64_t> publishes;
+	std::atomic<uint64_t> messages;
+	std::atomic<uint64_t> unparsable;
+	std::atomic<uint64_t> unknown_instruments;
+	std::atomic<uint64_t> instruments;
+	std::atomic<uint64_t> trades;
+	std::atomic<uint64_t> traded_volume;
+	std::atomic<uint64_t> bid_orders;
+	std::atomic<uint64_t> ask_orders;
+	std::atomic<uint64_t> duplicate_order_ids;
+	std::atomic<uint64_t> trade_without_order;
+	std::atomic<uint64_t> removes_without_order;
+	std::atomic<uint64_t> modifies_without_order;
+	std::atomic<uint64_t> crossed_book_no_trades;
+	std::atomic<uint64_t> invalid_inputs;
+
+	//writer only
+	void publish(const live_metrics_snapshot &s)
+	{
+		messages.store(s.messages, std::memory_order_relaxed);
+		unparsable.store(s.unparsable, std::memory_order_relaxed);
+		unknown_instruments.store(s.unknown_instruments, std::memory_order_relaxed);
+		instruments.store(s.instruments, std::memory_order_relaxed);
+		trades.store(s.trades, std::memory_order_relaxed);
+		traded_volume.store(s.traded_volume, std::memory_order_relaxed);
+		bid_orders.store(s.bid_orders, std::memory_order_relaxed);
+		ask_orders.store(s.ask_orders, std::memory_order_relaxed);
+		duplicate_order_ids.store(s.duplicate_order_ids, std::memory_order_relaxed);
+		trade_without_order.store(s.trade_without_order, std::memory_order_relaxed);
+		removes_without_order.store(s.removes_without_order, std::memory_order_relaxed);
+		modifies_without_order.store(s.modifies_without_order, std::memory_order_relaxed);
+		crossed_book_no_trades.store(s.crossed_book_no_trades, std::memory_order_relaxed);
+		invalid_inputs.store(s.invalid_inputs, std::memory_order_relaxed);
+		publishes.store(publishes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	live_metrics_snapshot load() const
+	{
+		live_metrics_snapshot s;
+		s.publishes = publishes.load(std::memory_order_relaxed);
+		s.messages = messages.load(std::memory_order_relaxed);
+		s.unparsable = unparsable.load(std::memory_order_relaxed);
+		s.unknown_instruments = unknown_instruments.load(std::memory_order_relaxed);
+		s.instruments = instruments.load(std::memory_order_relaxed);
+		s.trades = trades.load(std::memory_order_relaxed);
+		s.traded_volume = traded_volume.load(std::memory_order_relaxed);
+		s.bid_orders = bid_orders.load(std::memory_order_relaxed);
+		s.ask_orders = ask_orders.load(std::memory_order_relaxed);
+		s.duplicate_order_ids = duplicate_order_ids.load(std::memory_order_relaxed);
+		s.trade_without_order = trade_without_order.load(std::memory_order_relaxed);
+		s.removes_without_order = removes_without_order.load(std::memory_order_relaxed);
+		s.modifies_without_order = modifies_without_order.load(std::memory_order_relaxed);
+		s.crossed_book_no_trades = crossed_book_no_trades.load(std::memory_order_relaxed);
+		s.invalid_inputs = invalid_inputs.load(std::memory_order_relaxed);
+		return s;
+	}
+};
+static_assert(sizeof(live_metrics_slot) % 64 == 0, "live metrics slots are whole cache lines");
+
+//shared memory names are a single leading slash and then no more
+inline std::string live_metrics_path(const char *name)
+{
+	return name[0] == '/' ? std::string(name) : "/" + std::string(name);
+}
+
+//creates the segment and unlinks it again when done, so it's only there while the
+//feedhandler is
+class live_metrics_writer
+{
+public:
+	live_metrics_writer() = default;
+	~live_metrics_writer() { close(); }
+
+	live_metrics_writer(const live_metrics_writer &) = delete;
+	live_metrics_writer &operator=(const live_metrics_writer &) = delete;
+
+	//create the named segment with room for the given number of slots, all zeroed,
+	//replacing any left behind by a feedhandler that didn't exit cleanly
+	//returns false if it can't be created or mapped
+	bool open(const char *name, size_t slots)
+	{
+		close();
+		path_ = live_metrics_path(name);
+		shm_unlink(path_.c_str());
+		const int fd = shm_open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (fd < 0)
+		{
+			path_.clear();
+			return false;
+		}
+
+		size_ = sizeof(live_metrics_header) + slots * sizeof(live_metrics_slot);
+		void *addr = ftruncate(fd, size_) == 0 ? mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (addr == MAP_FAILED)
+		{
+			shm_unlink(path_.c_str());
+			path_.clear();
+			return false;
+		}
+
+		//a new segment is all zeroes, which is what every counter starts at
+		data_ = static_cast<char *>(addr);
+		live_metrics_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, live_metrics_magic, sizeof(live_metrics_magic));
+		header.version = live_metrics_version;
+		header.slot_count = slots;
+		header.pid = getpid();
+		memcpy(data_, &header, sizeof(header));
+		return true;
+	}
+
+	void close()
+	{
+		if (data_)
+		{
+			munmap(data_, size_);
+			shm_unlink(path_.c_str());
+			data_ = nullptr;
+			path_.clear();
+		}
+	}
+
+	live_metrics_slot *slot(size_t i) { return reinterpret_cast<live_metrics_slot *>(data_ + sizeof(live_metrics_header)) + i; }
+
+private: //state
+	std::string path_;
+	char *data_ = nullptr;
+	size_t size_ = 0;
+};
+
+//a read-only mapping of a feedhandler's segment
+class live_metrics_reader
+{
+public:
+	live_metrics_reader() = default;
+	~live_metrics_reader() { close(); }
+
+	live_metrics_reader(const live_metrics_reader &) = delete;
+	live_metrics_reader &operator=(const live_metrics_reader &) = delete;
+
+	//returns false if there's no such segment or it isn't one a feedhandler wrote
+	bool open(const char *name)
+	{
+		close();
+		const int fd = shm_open(live_metrics_path(name).c_str(), O_RDONLY, 0);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		void *addr = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(live_metrics_header))
+		{
+			addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if (addr == MAP_FAILED)
+		{
+			return false;
+		}
+		data_ = static_cast<const char *>(addr);
+		size_ = st.st_size;
+
+		memcpy(&header_, data_, sizeof(header_));
+		if (memcmp(header_.magic, live_metrics_magic, sizeof(live_metrics_magic)) != 0
+				|| header_.version != live_metrics_version
+				|| header_.slot_count > (size_ - sizeof(live_metrics_header)) / sizeof(live_metrics_slot))
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if (data_)
+		{
+			munmap(const_cast<char *>(data_), size_);
+			data_ = nullptr;
+		}
+	}
+
+	const live_metrics_header &header() const { return header_; }
+	size_t slot_count() const { return header_.slot_count; }
+
+	live_metrics_snapshot slot(size_t i) const
+	{
+		return (reinterpret_cast<const live_metrics_slot *>(data_ + sizeof(live_metrics_header)) + i)->load();
+	}
+
+	//every slot added up
+	live_metrics_snapshot total() const
+	{
+		live_metrics_snapshot s;
+		for (size_t i = 0; i < slot_count(); ++i)
+		{
+			s += slot(i);
+		}
+		return s;
+	}
+
+private: //state
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+	live_metrics_header header_;
+};
+
+#endif
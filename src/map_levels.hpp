@@ -0,0 +1,117 @@
+#ifndef __MAP_LEVELS_H__
+#define __MAP_LEVELS_H__
+
+#include "side_policy.hpp"
+#include "price_level.hpp"
+
+#include <map>
+#include <tuple>
+#include <utility>
+
+//map_levels has nothing to configure
+struct map_levels_options {};
+
+//one side of the book kept as a tree of price levels, best price first.
+//levels never move once created, so they're never relocated
+template <typename Side>
+class map_levels
+{
+public:
+	typedef map_levels_options options;
+
+	using price_to_level = std::map<price_t, price_level, typename Side::compare,
+			pool_allocator<std::pair<const price_t, price_level>>>;
+
+	//level nodes, and the order nodes queued in them, come from the given pool if there is one
+	explicit map_levels(const options & = options(), node_pool *pool = nullptr)
+		: levels_(typename Side::compare(), typename price_to_level::allocator_type(pool))
+	{
+
+	}
+
+	bool empty() const { return levels_.empty(); }
+	int size() const { return levels_.size(); }
+
+	price_level *find(price_t price)
+	{
+		const auto iter = levels_.find(price);
+		return iter == levels_.end() ? nullptr : &iter->second;
+	}
+
+	const price_level *find(price_t price) const
+	{
+		const auto iter = levels_.find(price);
+		return iter == levels_.end() ? nullptr : &iter->second;
+	}
+
+	//get the level at the given price, creating it if needed
+	template <typename OnMove>
+	price_level &insert(price_t price, OnMove)
+	{
+		//look before emplacing, as emplace would build (and throw away) a node every time
+		auto iter = levels_.lower_bound(price);
+		if (iter == levels_.end() || levels_.key_comp()(price, iter->first))
+		{
+			const pool_allocator<book_order> order_alloc(levels_.get_allocator());
+			iter = levels_.emplace_hint(iter, std::piecewise_construct,
+					std::forward_as_tuple(price), std::forward_as_tuple(order_alloc));
+		}
+		return iter->second;
+	}
+
+	//drop the (now empty) level at the given price
+	template <typename OnMove>
+	void erase(price_t price, OnMove)
+	{
+		levels_.erase(price);
+	}
+
+	//cursors over the levels; each returns false if there's no such level
+	bool best_price(price_t &price) const
+	{
+		if (levels_.empty()) return false;
+		price = levels_.begin()->first;
+		return true;
+	}
+
+	bool worst_price(price_t &price) const
+	{
+		if (levels_.empty()) return false;
+		price = levels_.rbegin()->first;
+		return true;
+	}
+
+	bool next_worse(price_t &price) const
+	{
+		const auto iter = levels_.upper_bound(price);
+		if (iter == levels_.end()) return false;
+		price = iter->first;
+		return true;
+	}
+
+	bool next_better(price_t &price) const
+	{
+		auto iter = levels_.lower_bound(price);
+		if (iter == levels_.begin()) return false;
+		price = (--iter)->first;
+		return true;
+	}
+
+	//call f(price, level) from the best level to the worst until it returns false
+	template <typename F>
+	void for_each_level(F f) const
+	{
+		for (const auto &level : levels_)
+		{
+			if (!f(level.first, level.second))
+			{
+				return;
+			}
+		}
+	}
+
+private:
+	price_to_level levels_;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//call cb(const char *line, size_t len) for every non-empty line in data[0, size),
+//without the trailing newline. the final line needn't be newline terminated.
+template <typename Callback>
+void for_each_line(const char *data, size_t size, Callback cb)
+{
+	const char *p = data;
+	const char *const end = data + size;
+	while (p < end)
+	{
+		const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+		if (!eol)
+		{
+			eol = end;
+		}
+		if (eol != p)
+		{
+			cb(p, static_cast<size_t>(eol - p));
+		}
+		p = eol + 1;
+	}
+}
+
+//read-only view of a whole file, mapped into memory so that lines can be handed
+//out as pointer/length slices without copying them anywhere
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	~mapped_file() { close(); }
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	//map the given file; returns false if it can't be opened or mapped
+	bool open(const char *filename)
+	{
+		close();
+
+		const int fd = ::open(filename, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		//an empty file is valid, there's just nothing to map
+		size_ = st.st_size;
+		if (size_ != 0)
+		{
+			void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr == MAP_FAILED)
+			{
+				::close(fd);
+				size_ = 0;
+				return false;
+			}
+			data_ = static_cast<const char *>(addr);
+
+			//we only ever walk the file front to back so ask for aggressive readahead
+			madvise(addr, size_, MADV_SEQUENTIAL);
+		}
+
+		//the mapping stays valid after the descriptor is closed
+		::close(fd);
+		return true;
+	}
+
+	void close()
+	{
+		if (data_)
+		{
+			munmap(const_cast<char *>(data_), size_);
+		}
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	const char *data() const { return data_; }
+	size_t size() const { return size_; }
+
+	//call cb(const char *line, size_t len) for every non-empty line in the file,
+	//without the trailing newline. the final line needn't be newline terminated.
+	template <typename Callback>
+	void for_each_line(Callback cb) const
+	{
+		::for_each_line(data_, size_, cb);
+	}
+
+private:
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+};
+
+#endif
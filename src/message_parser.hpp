@@ -0,0 +1,248 @@
+#ifndef __MESSAGE_PARSER_H__
+#define __MESSAGE_PARSER_H__
+
+#include "enums.hpp"
+#include "price.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+
+enum class message_type
+{
+	add,
+	modify,
+	remove,
+	trade
+};
+
+//a single decoded feed line; trades only fill in volume and price
+struct parsed_message
+{
+	message_type type = message_type::trade;
+	side order_side = side::bid;
+	int order_id = 0;
+	int volume = 0;
+	price_t price = 0;
+};
+
+//single-pass, allocation-free parser for the feed's csv lines:
+//  A|M|X,<order id>,B|S,<volume>,<price>
+//  T,<volume>,<price>
+//dispatches on the first byte and parses numbers without going near the locale.
+//accepts exactly what the old sscanf formats did for well-formed numbers (optional
+//leading whitespace and sign, decimal prices with an optional exponent) and rejects
+//anything trailing the price, so a line is unparsable in the same cases as before.
+//prices are converted straight to ticks of the given size, so a price that isn't on
+//a tick is unparsable, as are out-of-range integers and inf/nan/hex prices.
+class message_parser
+{
+public:
+	explicit message_parser(tick_size ticks = tick_size())
+		: ticks_(ticks)
+	{
+
+	}
+
+	const tick_size &get_tick_size() const { return ticks_; }
+
+	//returns false if the line can't be parsed, in which case msg is unspecified
+	bool parse(const char *line, size_t len, parsed_message &msg) const
+	{
+		const char *p = line;
+		const char *const end = line + len;
+		if (p == end)
+		{
+			return false;
+		}
+
+		switch (*p++)
+		{
+		case 'T':
+			msg.type = message_type::trade;
+			return expect(p, end, ',')
+					&& parse_int(p, end, msg.volume)
+					&& expect(p, end, ',')
+					&& parse_price(p, end, msg.price)
+					&& p == end;
+		case 'A': msg.type = message_type::add; break;
+		case 'M': msg.type = message_type::modify; break;
+		case 'X': msg.type = message_type::remove; break;
+		default: return false;
+		}
+
+		if (!expect(p, end, ',') || !parse_int(p, end, msg.order_id) || !expect(p, end, ','))
+		{
+			return false;
+		}
+
+		//the side is a single character with no whitespace skipping, as with %c
+		if (p == end)
+		{
+			return false;
+		}
+		switch (*p++)
+		{
+		case 'B': msg.order_side = side::bid; break;
+		case 'S': msg.order_side = side::ask; break;
+		default: return false;
+		}
+
+		return expect(p, end, ',')
+				&& parse_int(p, end, msg.volume)
+				&& expect(p, end, ',')
+				&& parse_price(p, end, msg.price)
+				&& p == end;
+	}
+
+private:
+	static bool is_space(char c)
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	static bool is_digit(char c)
+	{
+		return static_cast<unsigned char>(c - '0') < 10;
+	}
+
+	static void skip_space(const char *&p, const char *end)
+	{
+		while (p != end && is_space(*p)) ++p;
+	}
+
+	static bool expect(const char *&p, const char *end, char c)
+	{
+		if (p == end || *p != c)
+		{
+			return false;
+		}
+		++p;
+		return true;
+	}
+
+	//%d equivalent: optional whitespace, optional sign, at least one digit
+	static bool parse_int(const char *&p, const char *end, int &out)
+	{
+		skip_space(p, end);
+
+		bool negative = false;
+		if (p != end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p++ == '-');
+		}
+		if (p == end || !is_digit(*p))
+		{
+			return false;
+		}
+
+		int64_t n = 0;
+		while (p != end && is_digit(*p))
+		{
+			n = n * 10 + (*p++ - '0');
+			if (n > static_cast<int64_t>(INT_MAX) + 1)
+			{
+				return false;
+			}
+		}
+		if (negative)
+		{
+			n = -n;
+		}
+		if (n > INT_MAX)
+		{
+			return false;
+		}
+		out = static_cast<int>(n);
+		return true;
+	}
+
+	//%lf equivalent for plain decimals: [ws][sign](digits[.digits]|.digits)[(e|E)[sign][digits]]
+	//converted exactly to ticks rather than to a double
+	bool parse_price(const char *&p, const char *end, price_t &out) const
+	{
+		skip_space(p, end);
+
+		bool negative = false;
+		if (p != end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p++ == '-');
+		}
+
+		//accumulate up to 19 significant digits in an integer mantissa, tracking
+		//the power of ten that has to be applied to it
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		int significant = 0;
+		bool truncated = false;
+		for (; p != end && is_digit(*p); ++p, ++digits)
+		{
+			if (significant < max_significant)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) ++significant;
+			}
+			else
+			{
+				++exponent;
+				truncated |= (*p != '0');
+			}
+		}
+		if (p != end && *p == '.')
+		{
+			for (++p; p != end && is_digit(*p); ++p, ++digits)
+			{
+				if (significant < max_significant)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) ++significant;
+					--exponent;
+				}
+				else
+				{
+					truncated |= (*p != '0');
+				}
+			}
+		}
+		if (digits == 0)
+		{
+			return false;
+		}
+
+		if (p != end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negative_exponent = false;
+			if (p != end && (*p == '-' || *p == '+'))
+			{
+				negative_exponent = (*p++ == '-');
+			}
+			//an exponent marker with no digits is consumed and ignored, matching glibc's scanf
+			int explicit_exponent = 0;
+			for (; p != end && is_digit(*p); ++p)
+			{
+				if (explicit_exponent < 100000)
+				{
+					explicit_exponent = explicit_exponent * 10 + (*p - '0');
+				}
+			}
+			exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+		}
+
+		//more than 19 significant digits can't be on a tick or fit in a price
+		price_t ticks;
+		if (truncated || !ticks_.to_ticks(mantissa, exponent, ticks))
+		{
+			return false;
+		}
+		out = negative ? -ticks : ticks;
+		return true;
+	}
+
+	static const int max_significant = 19;
+
+	tick_size ticks_;
+};
+
+#endif
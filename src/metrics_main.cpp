@@ -0,0 +1,127 @@
+//============================================================================
+// Name        : metrics_main.cpp
+// Description : watches the counters a feedhandler run with -l publishes, and
+//               prints their rates every so often until it exits
+//============================================================================
+
+#include "live_metrics.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace
+{
+	void usage()
+	{
+		std::cout << "usage: metrics [-i interval_ms] [-n samples] [-s] <metrics_name>" << std::endl;
+		std::cout << "  -i  milliseconds between samples (default 1000)" << std::endl;
+		std::cout << "  -n  stop after this many samples, 0 to carry on until the feedhandler exits (default 0)" << std::endl;
+		std::cout << "  -s  print each shard's counters as well as the total" << std::endl;
+	}
+
+	bool writer_alive(const live_metrics_reader &reader)
+	{
+		return kill(reader.header().pid, 0) == 0 || errno == EPERM;
+	}
+
+	//per second over the interval, for the counters that keep going up; as they are
+	//for those that go up and down
+	void print_sample(const char *label, const live_metrics_snapshot &now, const live_metrics_snapshot &before, double seconds)
+	{
+		const auto rate = [seconds](uint64_t later, uint64_t earlier) { return (uint64_t)((later - earlier) / seconds); };
+		std::cout << label << "messages/s " << rate(now.messages, before.messages)
+				<< ", unparseable/s " << rate(now.unparsable, before.unparsable)
+				<< ", book errors/s " << rate(now.book_errors(), before.book_errors())
+				<< ", trades/s " << rate(now.trades, before.trades)
+				<< " | orders " << now.bid_orders << " bid " << now.ask_orders << " ask"
+				<< ", instruments " << now.instruments
+				<< ", messages " << now.messages
+				<< ", errors " << now.book_errors() + now.unparsable
+				<< " (duplicate ids " << now.duplicate_order_ids
+				<< ", trades without order " << now.trade_without_order
+				<< ", removes without order " << now.removes_without_order
+				<< ", modifies without order " << now.modifies_without_order
+				<< ", crossed " << now.crossed_book_no_trades
+				<< ", invalid " << now.invalid_inputs
+				<< ", unknown instruments " << now.unknown_instruments << ")" << std::endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int interval_ms = 1000;
+	long long samples = 0;
+	bool per_shard = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "i:n:s")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i': interval_ms = atoi(optarg); break;
+		case 'n': samples = atoll(optarg); break;
+		case 's': per_shard = true; break;
+		default: usage(); return 1;
+		}
+	}
+	if (optind != argc - 1 || interval_ms <= 0 || samples < 0)
+	{
+		usage();
+		return 1;
+	}
+	const char *name = argv[optind];
+
+	live_metrics_reader reader;
+	if (!reader.open(name))
+	{
+		std::cout << "Cannot open shared memory segment " << name << "; is a feedhandler running with -l " << name << "?" << std::endl;
+		return 1;
+	}
+	std::cout << "Watching feedhandler " << reader.header().pid << ", " << reader.slot_count() << " slot(s)" << std::endl;
+
+	std::vector<live_metrics_snapshot> before(reader.slot_count());
+	for (size_t i = 0; i < reader.slot_count(); ++i)
+	{
+		before[i] = reader.slot(i);
+	}
+	auto last = std::chrono::steady_clock::now();
+	for (long long n = 0; samples == 0 || n < samples; ++n)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+
+		//the last publish is taken even once it's gone, since the mapping stays
+		const bool alive = writer_alive(reader);
+		const auto now = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(now - last).count();
+		last = now;
+
+		live_metrics_snapshot total, total_before;
+		for (size_t i = 0; i < reader.slot_count(); ++i)
+		{
+			const live_metrics_snapshot slot = reader.slot(i);
+			if (per_shard && reader.slot_count() > 1)
+			{
+				const std::string label = "  shard " + std::to_string(i) + ": ";
+				print_sample(label.c_str(), slot, before[i], seconds);
+			}
+			total += slot;
+			total_before += before[i];
+			before[i] = slot;
+		}
+		print_sample("", total, total_before, seconds);
+
+		if (!alive)
+		{
+			std::cout << "Feedhandler " << reader.header().pid << " has exited" << std::endl;
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,218 @@
+#ifndef __NODE_POOL_H__
+#define __NODE_POOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include <sys/mman.h>
+
+//sizing for a node_pool
+struct node_pool_options
+{
+	//bytes of node storage to reserve up front; 0 means every node comes off the heap
+	size_t capacity_bytes = 16 << 20;
+
+	//back the pool with huge pages if the system has them, to cut tlb misses
+	bool hugepages = false;
+};
+
+//fixed arena for the small, same-sized nodes that node-based containers allocate
+//one at a time. the arena is mapped once at construction and carved up by bumping
+//a pointer; freed nodes go onto a freelist for their size class and are handed out
+//again before any fresh memory is used, so once a book has warmed up its adds and
+//removes never reach malloc.
+//
+//anything too big for a size class, or that doesn't fit once the arena is full,
+//goes to the heap instead and is counted in heap_allocations().
+class node_pool
+{
+public:
+	//nodes are handed out in multiples of this, which also keeps them aligned
+	static const size_t granularity = 16;
+	static const size_t max_node_size = 256;
+
+	explicit node_pool(const node_pool_options &opts = node_pool_options())
+	{
+		if (opts.capacity_bytes == 0)
+		{
+			return;
+		}
+
+		void *addr = MAP_FAILED;
+		if (opts.hugepages)
+		{
+			//explicit huge pages need to be reserved by the admin, so this can fail
+			const size_t huge_page = 2 << 20;
+			capacity_ = (opts.capacity_bytes + huge_page - 1) & ~(huge_page - 1);
+			addr = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			hugepages_ = addr != MAP_FAILED;
+		}
+		if (addr == MAP_FAILED)
+		{
+			capacity_ = opts.capacity_bytes;
+			addr = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (addr == MAP_FAILED)
+			{
+				capacity_ = 0;
+				return;
+			}
+
+			//fall back to transparent huge pages, which the kernel may or may not honour
+			if (opts.hugepages)
+			{
+				madvise(addr, capacity_, MADV_HUGEPAGE);
+			}
+		}
+		base_ = static_cast<char *>(addr);
+		next_ = base_;
+	}
+
+	~node_pool()
+	{
+		if (base_)
+		{
+			munmap(base_, capacity_);
+		}
+	}
+
+	node_pool(const node_pool &) = delete;
+	node_pool &operator=(const node_pool &) = delete;
+
+	void *allocate(size_t bytes)
+	{
+		const size_t size_class = class_of(bytes);
+		if (size_class < num_classes)
+		{
+			//reuse a freed node if there is one
+			if (free_node *node = freelists_[size_class])
+			{
+				freelists_[size_class] = node->next;
+				return node;
+			}
+
+			//otherwise carve a new one off the arena
+			const size_t size = (size_class + 1) * granularity;
+			if (base_ && static_cast<size_t>(base_ + capacity_ - next_) >= size)
+			{
+				void *node = next_;
+				next_ += size;
+				return node;
+			}
+		}
+
+		++heap_allocations_;
+		return ::operator new(bytes);
+	}
+
+	void deallocate(void *p, size_t bytes)
+	{
+		if (!owns(p))
+		{
+			::operator delete(p);
+			return;
+		}
+
+		free_node *node = static_cast<free_node *>(p);
+		const size_t size_class = class_of(bytes);
+		node->next = freelists_[size_class];
+		freelists_[size_class] = node;
+	}
+
+	//bytes reserved for the arena, and how much of it has been carved up so far
+	size_t capacity() const { return capacity_; }
+	size_t used() const { return next_ - base_; }
+
+	//whether the arena ended up on explicit huge pages
+	bool hugepages() const { return hugepages_; }
+
+	//number of allocations that had to go to the heap
+	uint64_t heap_allocations() const { return heap_allocations_; }
+
+private: //types
+	struct free_node
+	{
+		free_node *next;
+	};
+
+	static const size_t num_classes = max_node_size / granularity;
+
+private: //methods
+	static size_t class_of(size_t bytes)
+	{
+		return bytes == 0 ? 0 : (bytes - 1) / granularity;
+	}
+
+	bool owns(const void *p) const
+	{
+		return p >= base_ && p < base_ + capacity_;
+	}
+
+private: //state
+	char *base_ = nullptr;
+	char *next_ = nullptr;
+	size_t capacity_ = 0;
+	bool hugepages_ = false;
+
+	free_node *freelists_[num_classes] = {};
+	uint64_t heap_allocations_ = 0;
+};
+
+//standard allocator that takes its nodes from a node_pool; without a pool it's just
+//the heap
+template <typename T>
+class pool_allocator
+{
+public:
+	typedef T value_type;
+
+	//nodes follow their container when it's moved or swapped
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	explicit pool_allocator(node_pool *pool = nullptr) : pool_(pool) {}
+
+	template <typename U>
+	pool_allocator(const pool_allocator<U> &other) : pool_(other.pool()) {}
+
+	T *allocate(size_t n)
+	{
+		if (!pool_)
+		{
+			return static_cast<T *>(::operator new(n * sizeof(T)));
+		}
+		return static_cast<T *>(pool_->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T *p, size_t n)
+	{
+		if (!pool_)
+		{
+			::operator delete(p);
+			return;
+		}
+		pool_->deallocate(p, n * sizeof(T));
+	}
+
+	node_pool *pool() const { return pool_; }
+
+private:
+	node_pool *pool_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const pool_allocator<T> &left, const pool_allocator<U> &right)
+{
+	return left.pool() == right.pool();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const pool_allocator<T> &left, const pool_allocator<U> &right)
+{
+	return left.pool() != right.pool();
+}
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef __ORDER_INDEX_H__
+#define __ORDER_INDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+//maps an order id to where the order lives in the book. it's touched on every add,
+//modify and remove so there are two flat implementations to pick from, neither of
+//which allocates per order:
+//  hashed - open addressing with linear probing, for any id space
+//  direct - a paged array indexed by the id itself, for dense ids (e.g. ids that
+//           count up from one, as the simulator's do)
+//order ids are never negative; the book rejects those before they get here
+enum class order_index_kind
+{
+	hashed,
+	direct
+};
+
+struct order_index_options
+{
+	order_index_kind kind = order_index_kind::hashed;
+
+	//number of live orders to size the hashed index for up front, so that it doesn't
+	//have to grow while the book is warming up
+	size_t expected_orders = 4096;
+};
+
+//open addressing hash table with linear probing. erasing shifts the rest of the
+//probe run back a slot instead of leaving a tombstone, so lookups never have to
+//walk past dead entries and the table never needs cleaning up.
+template <typename Value>
+class hashed_order_index
+{
+public:
+	explicit hashed_order_index(size_t expected = 0)
+	{
+		size_t capacity = 16;
+		while (capacity * max_load_num < expected * max_load_den)
+		{
+			capacity <<= 1;
+		}
+		resize(capacity);
+	}
+
+	size_t size() const { return size_; }
+
+	//entries the table has room for before it next grows past its load limit
+	size_t capacity() const { return slots_.size() * max_load_num / max_load_den; }
+
+	Value *find(int key)
+	{
+		for (size_t i = home(key); ; i = (i + 1) & mask_)
+		{
+			if (slots_[i].key == key)
+			{
+				return &slots_[i].value;
+			}
+			if (slots_[i].key == empty_key)
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	//add a default value for the key; returns null if the key's already there
+	Value *insert(int key)
+	{
+		if ((size_ + 1) * max_load_den > slots_.size() * max_load_num)
+		{
+			grow();
+		}
+
+		size_t i = home(key);
+		for (; slots_[i].key != empty_key; i = (i + 1) & mask_)
+		{
+			if (slots_[i].key == key)
+			{
+				return nullptr;
+			}
+		}
+		slots_[i].key = key;
+		slots_[i].value = Value();
+		++size_;
+		return &slots_[i].value;
+	}
+
+	void erase(int key)
+	{
+		size_t hole = home(key);
+		while (slots_[hole].key != key)
+		{
+			if (slots_[hole].key == empty_key)
+			{
+				return;
+			}
+			hole = (hole + 1) & mask_;
+		}
+
+		//pull back any later entry in the run that would be unreachable past the hole
+		for (size_t i = (hole + 1) & mask_; slots_[i].key != empty_key; i = (i + 1) & mask_)
+		{
+			//distance from each slot back to its entry's home; an entry can move into
+			//the hole only if that doesn't put it before its home
+			const size_t wanted = home(slots_[i].key);
+			if (((i - wanted) & mask_) >= ((i - hole) & mask_))
+			{
+				slots_[hole] = slots_[i];
+				hole = i;
+			}
+		}
+		slots_[hole].key = empty_key;
+		--size_;
+	}
+
+private: //types
+	struct slot
+	{
+		int key = empty_key;
+		Value value;
+	};
+
+	static const int empty_key = -1;
+
+	//grow once the table is more than 7/10 full
+	static const size_t max_load_num = 7;
+	static const size_t max_load_den = 10;
+
+private: //methods
+	size_t home(int key) const
+	{
+		//fibonacci hashing spreads runs of consecutive ids across the table
+		return (static_cast<uint64_t>(static_cast<uint32_t>(key)) * 0x9E3779B97F4A7C15ull) >> shift_;
+	}
+
+	void resize(size_t capacity)
+	{
+		slots_.assign(capacity, slot());
+		mask_ = capacity - 1;
+		shift_ = 64;
+		for (size_t c = capacity; c > 1; c >>= 1)
+		{
+			--shift_;
+		}
+	}
+
+	void grow()
+	{
+		std::vector<slot> old;
+		old.swap(slots_);
+		resize(old.size() * 2);
+		for (const auto &entry : old)
+		{
+			if (entry.key != empty_key)
+			{
+				size_t i = home(entry.key);
+				while (slots_[i].key != empty_key)
+				{
+					i = (i + 1) & mask_;
+				}
+				slots_[i] = entry;
+			}
+		}
+	}
+
+private: //state
+	std::vector<slot> slots_;
+	size_t mask_ = 0;
+	int shift_ = 64;
+	size_t size_ = 0;
+};
+
+//array indexed directly by order id, so a lookup is a single read. it's split into
+//pages that are only allocated once an id in their range turns up, and that are
+//recycled once all of their orders have gone, so ids that keep counting up don't
+//keep costing memory.
+template <typename Value>
+class paged_order_index
+{
+public:
+	static const int page_bits = 12;
+	static const size_t page_size = size_t(1) << page_bits;
+
+	paged_order_index()
+		//one entry for every page in the non-negative int range. it's zeroed lazily
+		//by the os, so untouched parts of the id space cost nothing
+		: directory_(static_cast<page **>(calloc(directory_size, sizeof(page *))))
+	{
+		if (!directory_)
+		{
+			throw std::bad_alloc();
+		}
+	}
+
+	~paged_order_index()
+	{
+		free(directory_);
+	}
+
+	paged_order_index(const paged_order_index &) = delete;
+	paged_order_index &operator=(const paged_order_index &) = delete;
+
+	size_t size() const { return size_; }
+
+	//entries in all the pages allocated so far, in use or waiting to be recycled
+	size_t capacity() const { return pages_.size() * page_size; }
+
+	Value *find(int key)
+	{
+		page *p = directory_[key >> page_bits];
+		if (!p)
+		{
+			return nullptr;
+		}
+		slot &s = p->slots[key & (page_size - 1)];
+		return s.used ? &s.value : nullptr;
+	}
+
+	//add a default value for the key; returns null if the key's already there
+	Value *insert(int key)
+	{
+		page *&p = directory_[key >> page_bits];
+		if (!p)
+		{
+			p = new_page();
+		}
+		slot &s = p->slots[key & (page_size - 1)];
+		if (s.used)
+		{
+			return nullptr;
+		}
+		s.used = true;
+		s.value = Value();
+		++p->live;
+		++size_;
+		return &s.value;
+	}
+
+	void erase(int key)
+	{
+		page *&p = directory_[key >> page_bits];
+		if (!p)
+		{
+			return;
+		}
+		slot &s = p->slots[key & (page_size - 1)];
+		if (!s.used)
+		{
+			return;
+		}
+		s.used = false;
+		--size_;
+
+		//hand back pages that have emptied out
+		if (--p->live == 0)
+		{
+			free_pages_.push_back(p);
+			p = nullptr;
+		}
+	}
+
+private: //types
+	struct slot
+	{
+		bool used = false;
+		Value value;
+	};
+
+	struct page
+	{
+		slot slots[page_size];
+		size_t live = 0;
+	};
+
+	static const size_t directory_size = (size_t(INT32_MAX) >> page_bits) + 1;
+
+private: //methods
+	page *new_page()
+	{
+		if (!free_pages_.empty())
+		{
+			page *p = free_pages_.back();
+			free_pages_.pop_back();
+			return p;
+		}
+
+		pages_.emplace_back(new page());
+
+		//make sure handing the page back later never has to allocate
+		free_pages_.reserve(pages_.size());
+		return pages_.back().get();
+	}
+
+private: //state
+	page **directory_;
+	std::vector<std::unique_ptr<page>> pages_;
+	std::vector<page *> free_pages_;
+	size_t size_ = 0;
+};
+
+//the order index a book uses, picked when the book is built. the choice is a
+//branch that always goes the same way, so it costs next to nothing per lookup
+template <typename Value>
+class order_index
+{
+public:
+	explicit order_index(const order_index_options &opts = order_index_options())
+		: kind_(opts.kind),
+		  hashed_(opts.kind == order_index_kind::hashed ? opts.expected_orders : 0)
+	{
+		if (kind_ == order_index_kind::direct)
+		{
+			direct_.reset(new paged_order_index<Value>());
+		}
+	}
+
+	order_index_kind kind() const { return kind_; }
+
+	size_t size() const { return kind_ == order_index_kind::direct ? direct_->size() : hashed_.size(); }
+
+	//how many entries the index has allocated room for; it only changes when the
+	//index has to go to the heap
+	size_t capacity() const { return kind_ == order_index_kind::direct ? direct_->capacity() : hashed_.capacity(); }
+
+	//the value for the key, or null if there isn't one
+	Value *find(int key)
+	{
+		return kind_ == order_index_kind::direct ? direct_->find(key) : hashed_.find(key);
+	}
+
+	//add a default value for the key; returns null if the key's already there
+	Value *insert(int key)
+	{
+		return kind_ == order_index_kind::direct ? direct_->insert(key) : hashed_.insert(key);
+	}
+
+	void erase(int key)
+	{
+		if (kind_ == order_index_kind::direct)
+		{
+			direct_->erase(key);
+		}
+		else
+		{
+			hashed_.erase(key);
+		}
+	}
+
+private:
+	order_index_kind kind_;
+	hashed_order_index<Value> hashed_;
+	std::unique_ptr<paged_order_index<Value>> direct_;
+};
+
+#endif
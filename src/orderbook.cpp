@@ -5,92 +5,65 @@
  *      Author: ger
  */
 #include "orderbook.hpp"
+#include "feed_output.hpp"
 
-void orderbook::print_ob(std::ostream &os) const
+template <template <typename> class Levels>
+template <typename Stream>
+void basic_orderbook<Levels>::print_levels(Stream &os) const
 {
-	//march through the two sides, printing each of their details in descending price order
-	auto ask_iter = rbegin(side::ask);
-	auto bid_iter = begin(side::bid);
-
-	const auto end_ask = rend(side::ask);
-	const auto end_bid = end(side::bid);
-	double curr_price = 0;
-	while (ask_iter != end_ask && bid_iter != end_bid)
-	{
-		const auto ask_price = ask_iter->first;
-		const auto bid_price = bid_iter->first;
-		if (ask_price >= bid_price)
-		{
-			if (ask_price != curr_price)
-			{
-				curr_price = ask_price;
-				os << std::endl;
-				os << curr_price;
-			}
-			os << " S " << ask_iter->second;
-			++ask_iter;
-		}
-		else
-		{
-			if (bid_price != curr_price)
-			{
-				curr_price = bid_price;
-				os << std::endl;
-				os << curr_price;
-			}
-			os << " B " << bid_iter->second;
-			++bid_iter;
-		}
-	}
-	while (ask_iter != end_ask)
+	book_printer<Stream> printer(os, ticks_);
+	for_each_order_by_price([&printer](side s, price_t price, int volume)
 	{
-		const auto ask_price = ask_iter->first;
-		if (ask_price != curr_price)
-		{
-			curr_price = ask_price;
-			os << std::endl;
-			os << curr_price;
-		}
-		os << " S " << ask_iter->second;
-		++ask_iter;
-	}
-	while (bid_iter != end_bid)
-	{
-		const auto bid_price = bid_iter->first;
-		if (bid_price != curr_price)
-		{
-			curr_price = bid_price;
-			os << std::endl;
-			os << curr_price;
-		}
-		os << " B " << bid_iter->second;
-		++bid_iter;
-	}
-	os << std::endl;
+		printer.order(s, price, volume);
+	});
+	printer.finish();
 }
 
-const orderbook::ordered_price_to_volumes::value_type *orderbook::get_order_in_position(side s, unsigned position) const
+template <template <typename> class Levels>
+void basic_orderbook<Levels>::print_ob(std::ostream &os) const
 {
-	if (side_to_price_to_vols_[(int)s].size() <= position)
-	{
-		return nullptr;
-	}
+	print_levels(os);
+}
 
-	auto iter = side_to_price_to_vols_[(int)s].begin();
-	for (unsigned i = 0; i < position; ++i) ++iter;
-	return &(*iter);
+template <template <typename> class Levels>
+void basic_orderbook<Levels>::print_ob(output_sink &os) const
+{
+	print_levels(os);
 }
 
-int orderbook::get_volume(side s, double price) const
+template <template <typename> class Levels>
+const book_order *basic_orderbook<Levels>::get_order_in_position(side s, unsigned position) const
 {
-	const auto orders_at_price = side_to_price_to_vols_[(int)s].equal_range(price);
-	return std::accumulate(orders_at_price.first, orders_at_price.second,
-			0,
-			[](int accumulated, const ordered_price_to_volumes::value_type &elem)
-			{
-				return accumulated + elem.second;
-			});
+	if (order_counts_[(int)s] <= (int)position)
+	{
+		return nullptr;
+	}
+	return s == side::bid
+			? order_in_position(bid_levels_, position)
+			: order_in_position(ask_levels_, position);
 }
 
+template <template <typename> class Levels>
+template <typename SideLevels>
+const book_order *basic_orderbook<Levels>::order_in_position(const SideLevels &levels, unsigned position) const
+{
+	//skip whole levels using their order counts, then walk the one we land in
+	const book_order *found = nullptr;
+	levels.for_each_level([&](price_t, const price_level &level)
+	{
+		if (position >= (unsigned)level.order_count)
+		{
+			position -= level.order_count;
+			return true;
+		}
 
+		auto iter = level.orders.begin();
+		for (unsigned i = 0; i < position; ++i) ++iter;
+		found = &(*iter);
+		return false;
+	});
+	return found;
+}
 
+template class basic_orderbook<map_levels>;
+template class basic_orderbook<ladder_levels>;
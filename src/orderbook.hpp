@@ -2,79 +2,172 @@
 #ifndef __ORDERBOOK_H__
 #define __ORDERBOOK_H__
 
+#include "book_depth.hpp"
 #include "enums.hpp"
-
-#include <unordered_map>
-#include <map>
+#include "price.hpp"
+#include "price_level.hpp"
+#include "map_levels.hpp"
+#include "ladder_levels.hpp"
+#include "order_index.hpp"
+#include "output_sink.hpp"
+
+#include <memory>
 #include <vector>
 #include <list>
 #include <cstdint>
 #include <algorithm>
-#include <functional>
 #include <iostream>
 
-inline bool order_ascending(double left, double right)
-{
-	return left < right;
-}
-
-inline bool order_descending(double left, double right)
-{
-	return right < left;
-}
-
-class orderbook
+//the order book, generic over how each side stores its price levels:
+//  map_levels - a tree of levels, for any price distribution
+//  ladder_levels - a dense tick ladder around the touch, for liquid instruments
+//both expose the same interface so they can be swapped and benchmarked head to head.
+//each side's levels are their own type, specialised on bid_side or ask_side, so the
+//side is decided once per event rather than on every price comparison
+template <template <typename> class Levels>
+class basic_orderbook
 {
 public:
-	orderbook()
-		: best_prices_(2)
+	typedef Levels<bid_side> bid_levels;
+	typedef Levels<ask_side> ask_levels;
+	typedef typename bid_levels::options level_options;
+
+	//every order and level node the book needs comes out of a pool of the given size,
+	//and orders are found by id through the given kind of index
+	explicit basic_orderbook(tick_size ticks = tick_size(), const level_options &options = level_options(),
+			const node_pool_options &pool_options = node_pool_options(),
+			const order_index_options &index_options = order_index_options())
+		: ticks_(ticks),
+		  pool_(new node_pool(pool_options)),
+		  bid_levels_(options, pool_.get()),
+		  ask_levels_(options, pool_.get()),
+		  order_counts_(2),
+		  order_id_to_details_(index_options),
+		  best_prices_(2)
 	{
-		//bids are ordered from highest to lowest
-		side_to_price_to_vols_.emplace_back(order_descending);
 
-		//asks are ordered lowest to highest
-		side_to_price_to_vols_.emplace_back(order_ascending);
 	}
 
-	~orderbook() = default;
+	~basic_orderbook() = default;
+
+	//the containers all point into the pool, so the book can't be copied
+	basic_orderbook(const basic_orderbook &) = delete;
+	basic_orderbook &operator=(const basic_orderbook &) = delete;
 
-	//in C++11 multimap guarantees stable ordering of elements with duplicate keys
-	typedef std::function<bool(double, double)> comparator;
-	using ordered_price_to_volumes = std::multimap<double, int, comparator>;
+	//each side's levels, which can be walked from the best price with for_each_level
+	//or with the best_price/next_worse style cursors
+	const bid_levels &bids() const { return bid_levels_; }
+	const ask_levels &asks() const { return ask_levels_; }
 
-	//iterators to each side's levels
-	ordered_price_to_volumes::const_iterator begin(side s) const { return side_to_price_to_vols_[(int)s].begin(); }
-	ordered_price_to_volumes::const_iterator end(side s) const { return side_to_price_to_vols_[(int)s].end(); }
+	//the pool the book's nodes come from, for its allocation stats
+	const node_pool &get_node_pool() const { return *pool_; }
 
-	ordered_price_to_volumes::const_reverse_iterator rbegin(side s) const { return side_to_price_to_vols_[(int)s].rbegin(); }
-	ordered_price_to_volumes::const_reverse_iterator rend(side s) const { return side_to_price_to_vols_[(int)s].rend(); }
+	//how many orders the id index has room for, which only grows when it allocates
+	size_t get_order_index_capacity() const { return order_id_to_details_.capacity(); }
+
+	//the price grid this book is kept in
+	const tick_size &get_tick_size() const { return ticks_; }
 
 	//print the orderbook to the given stream
 	void print_ob(std::ostream &os) const;
+	void print_ob(output_sink &os) const;
+
+	//call f(side, price, volume) for every order in the order the book is printed in:
+	//descending price, asks before bids at the same price, bids oldest first and
+	//asks newest first
+	template <typename F>
+	void for_each_order_by_price(F f) const
+	{
+		//march through the two sides, walking the asks backwards from the far touch
+		price_t ask_price = 0, bid_price = 0;
+		bool more_asks = ask_levels_.worst_price(ask_price);
+		bool more_bids = bid_levels_.best_price(bid_price);
+
+		while (more_asks || more_bids)
+		{
+			if (more_asks && (!more_bids || ask_price >= bid_price))
+			{
+				const price_level &level = *ask_levels_.find(ask_price);
+				for (auto order = level.orders.rbegin(); order != level.orders.rend(); ++order)
+				{
+					f(side::ask, ask_price, order->volume);
+				}
+				more_asks = ask_levels_.next_better(ask_price);
+			}
+			else
+			{
+				const price_level &level = *bid_levels_.find(bid_price);
+				for (const auto &order : level.orders)
+				{
+					f(side::bid, bid_price, order.volume);
+				}
+				more_bids = bid_levels_.next_worse(bid_price);
+			}
+		}
+	}
+
+	//keep the best this many levels of each side to hand, for get_depth; 0 to stop
+	void set_depth_levels(size_t levels) { depth_.set_levels(levels); }
+
+	//the depth kept since set_depth_levels, brought up to date. only the sides
+	//that changed near the touch since last time are re-read
+	const book_depth &get_depth() const
+	{
+		if (depth_.is_stale(side::bid))
+		{
+			depth_.refresh(side::bid, bid_levels_);
+		}
+		if (depth_.is_stale(side::ask))
+		{
+			depth_.refresh(side::ask, ask_levels_);
+		}
+		return depth_;
+	}
 
 	//check if the book is crossed
 	bool is_crossed() const { return best_prices_[(int)side::bid] >= best_prices_[(int)side::ask]; }
 
-	//get the calculated midpoint
-	double get_midpoint() const	{ return midpoint_; }
+	//get the calculated midpoint as a price, or zero if there isn't a valid one
+	double get_midpoint() const	{ return ticks_.to_price(touch_sum_) * 0.5; }
+
+	//running counts of the changes to the top of the book: to the best level of either
+	//side (its price, volume or orders), and to the midpoint. compare them either side
+	//of an event to tell whether it moved the touch
+	uint64_t get_top_changes() const { return top_changes_; }
+	uint64_t get_midpoint_changes() const { return midpoint_changes_; }
 
-	//retrieve the order on the given side/in the given position
+	//retrieve the order on the given side/in the given position, counting through
+	//the levels in price then time priority
 	//returns null if that position does not exist
-	const ordered_price_to_volumes::value_type *get_order_in_position(side s, unsigned position) const;
+	const book_order *get_order_in_position(side s, unsigned position) const;
 
 	//get the number of orders on the given side
-	int get_order_count_on_side(side s) const { return side_to_price_to_vols_[(int)s].size(); }
+	int get_order_count_on_side(side s) const { return order_counts_[(int)s]; }
 
-	//get the best price on the given side
-	double get_best_price(side s) const	{ return best_prices_[(int)s]; }
+	//get the number of distinct prices on the given side
+	int get_level_count_on_side(side s) const { return s == side::bid ? bid_levels_.size() : ask_levels_.size(); }
+
+	//get the best price on the given side, in ticks
+	price_t get_best_price(side s) const	{ return best_prices_[(int)s]; }
 
 	//get the total volume at the given price point
-	int get_volume(side s, double price) const;
+	int get_volume(side s, price_t price) const
+	{
+		const price_level *level = find_level(s, price);
+		return level ? level->total_volume : 0;
+	}
+
+	//get the number of orders at the given price point
+	int get_order_count(side s, price_t price) const
+	{
+		const price_level *level = find_level(s, price);
+		return level ? level->order_count : 0;
+	}
 
 	//the trade stats that we've seen
 	struct trade_stats
 	{
-		double last_trade_price = 0.0;
+		price_t last_trade_price = 0;
 		uint64_t cumulative_trade_volume = 0;
 	};
 	const trade_stats &get_current_trade_stats() const
@@ -91,6 +184,24 @@ public:
 		int modifies_without_order = 0;
 		int crossed_book_no_trades = 0;
 		int invalid_inputs = 0;
+
+		//for totting up the stats of several books
+		error_stats &operator+=(const error_stats &other)
+		{
+			duplicate_order_ids += other.duplicate_order_ids;
+			trade_without_order += other.trade_without_order;
+			removes_without_order += other.removes_without_order;
+			modifies_without_order += other.modifies_without_order;
+			crossed_book_no_trades += other.crossed_book_no_trades;
+			invalid_inputs += other.invalid_inputs;
+			return *this;
+		}
+
+		int total() const
+		{
+			return duplicate_order_ids + trade_without_order + removes_without_order
+					+ modifies_without_order + crossed_book_no_trades + invalid_inputs;
+		}
 	};
 	const error_stats &get_error_stats() const
 	{
@@ -99,7 +210,7 @@ public:
 
 	//trade message seen; update the error/trade stats, won't affect the book
 	//returns false if any issue detected
-	bool on_trade(double price, int volume)
+	bool on_trade(price_t price, int volume)
 	{
 		if (!is_crossed())
 		{
@@ -129,7 +240,68 @@ public:
 	//apply the given modification to the order id
 	//returns false if any issues found, in which case nothing will have been applied
 	//if the volume has gone to zero the order will be removed
-	bool on_order_modify(side s, int order_id, double price, int volume)
+	bool on_order_modify(side s, int order_id, price_t price, int volume)
+	{
+		return s == side::bid
+				? modify_order<bid_side>(order_id, price, volume)
+				: modify_order<ask_side>(order_id, price, volume);
+	}
+
+	//remove the given order id from the book
+	//returns false if any issue detected
+	bool on_order_remove(side s, int order_id)
+	{
+		return s == side::bid
+				? remove_order<bid_side>(order_id)
+				: remove_order<ask_side>(order_id);
+	}
+
+	//add the given details to the book
+	//returns false if any issues found, e.g. duplicate or conflicting data
+	bool on_order_add(side s, int order_id, price_t price, int volume)
+	{
+		return s == side::bid
+				? add_order<bid_side>(order_id, price, volume)
+				: add_order<ask_side>(order_id, price, volume);
+	}
+
+	//for rebuilding a book from a checkpoint: put the order back at the back of its
+	//level without bringing the best prices up to date or counting any errors, then
+	//finish with end_restore once they're all in. orders have to be put back in time
+	//priority within their level
+	//returns false if the order's invalid or its id is already in the book
+	bool restore_order(side s, int order_id, price_t price, int volume)
+	{
+		return s == side::bid
+				? restore_to_level<bid_side>(order_id, price, volume)
+				: restore_to_level<ask_side>(order_id, price, volume);
+	}
+
+	void end_restore(const trade_stats &trades, const error_stats &errors)
+	{
+		update_best_prices<bid_side>();
+		update_best_prices<ask_side>();
+		trade_stats_ = trades;
+		error_stats_ = errors;
+	}
+
+
+private: //types
+	//where an order lives: its level and its position in that level's queue
+	struct order_location
+	{
+		side order_side = side::bid;
+		price_level *level = nullptr;
+		order_queue::iterator order;
+	};
+
+private: //methods
+	bid_levels &levels_of(bid_side) { return bid_levels_; }
+	ask_levels &levels_of(ask_side) { return ask_levels_; }
+
+	//the side-specific halves of on_order_modify/remove/add
+	template <typename Side>
+	bool modify_order(int order_id, price_t price, int volume)
 	{
 		if (!check_validity(order_id, price, volume))
 		{
@@ -137,16 +309,16 @@ public:
 		}
 
 		//if it doesn't exist something is wrong
-		auto result = order_id_to_details_.find(order_id);
-		if (result == order_id_to_details_.end())
+		order_location *found = order_id_to_details_.find(order_id);
+		if (!found)
 		{
 			++error_stats_.modifies_without_order;
 			return false;
 		}
 
 		//side isn't right, something is wrong
-		std::pair<side, ordered_price_to_volumes::iterator> &side_and_iter = result->second;
-		if (side_and_iter.first != s)
+		order_location &location = *found;
+		if (location.order_side != Side::value)
 		{
 			++error_stats_.modifies_without_order;
 			return false;
@@ -155,31 +327,32 @@ public:
 		//if the new volume is zero this is actually a remove instead
 		if (volume == 0)
 		{
-			side_to_price_to_vols_[(int)side_and_iter.first].erase(side_and_iter.second);
+			remove_from_level<Side>(location);
 
 			//and now remove the order
-			order_id_to_details_.erase(result);
+			order_id_to_details_.erase(order_id);
 
-			update_best_prices(s);
+			update_best_prices<Side>();
 		}
-		//if the price didn't change we can just update the volume
-		else if (side_and_iter.second->first == price)
+		//if the price didn't change we can just update the volume, keeping priority
+		else if (location.order->price == price)
 		{
-			side_and_iter.second->second = volume;
+			location.level->total_volume += volume - location.order->volume;
+			location.order->volume = volume;
+			note_level_change<Side>(price);
 		}
-		//but if it did change we have to remove, re-insert and re-calculate best bid/offer
+		//but if it did change we have to move it to the back of the new level and re-calculate best bid/offer
 		else
 		{
-			side_to_price_to_vols_[(int)s].erase(side_and_iter.second);
-			side_and_iter.second = side_to_price_to_vols_[(int)s].emplace(price, volume);
-			update_best_prices(s);
+			remove_from_level<Side>(location);
+			add_to_level<Side>(order_id, price, volume, location);
+			update_best_prices<Side>();
 		}
 		return true;
 	}
 
-	//remove the given order id from the book
-	//returns false if any issue detected
-	bool on_order_remove(side s, int order_id)
+	template <typename Side>
+	bool remove_order(int order_id)
 	{
 		if (!check_validity(order_id))
 		{
@@ -187,32 +360,31 @@ public:
 		}
 
 		//if it doesn't exist something is wrong
-		auto result = order_id_to_details_.find(order_id);
-		if (result == order_id_to_details_.end())
+		const order_location *found = order_id_to_details_.find(order_id);
+		if (!found)
 		{
 			++error_stats_.removes_without_order;
 			return false;
 		}
 
-		//remove the price
-		const std::pair<side, ordered_price_to_volumes::iterator> &side_and_iter = result->second;
-		if (side_and_iter.first != s)
+		//remove the order from its level
+		const order_location &location = *found;
+		if (location.order_side != Side::value)
 		{
 			++error_stats_.removes_without_order;
 			return false;
 		}
-		side_to_price_to_vols_[(int)side_and_iter.first].erase(side_and_iter.second);
+		remove_from_level<Side>(location);
 
 		//and now remove the order
-		order_id_to_details_.erase(result);
+		order_id_to_details_.erase(order_id);
 
-		update_best_prices(s);
+		update_best_prices<Side>();
 		return true;
 	}
 
-	//add the given details to the book
-	//returns false if any issues found, e.g. duplicate or conflicting data
-	bool on_order_add(side s, int order_id, double price, int volume)
+	template <typename Side>
+	bool add_order(int order_id, price_t price, int volume)
 	{
 		if (!check_validity(order_id, price, volume))
 		{
@@ -220,32 +392,113 @@ public:
 		}
 
 		//if it exists already then something's wrong
-		auto result = order_id_to_details_.insert(std::make_pair(order_id, std::make_pair(s, ordered_price_to_volumes::iterator())));
-		if (!result.second)
+		order_location *location = order_id_to_details_.insert(order_id);
+		if (!location)
 		{
 			++error_stats_.duplicate_order_ids;
 			return false;
 		}
 
-		//we're good to add it to the side map and link them up
-		result.first->second.second = side_to_price_to_vols_[(int)s].emplace(price, volume);
+		//we're good to add it to its level and link them up
+		location->order_side = Side::value;
+		add_to_level<Side>(order_id, price, volume, *location);
 
-		update_best_prices(s);
+		update_best_prices<Side>();
 		return true;
 	}
 
+	template <typename Side>
+	bool restore_to_level(int order_id, price_t price, int volume)
+	{
+		if (order_id < 0 || price < 0 || volume < 0)
+		{
+			return false;
+		}
+		order_location *location = order_id_to_details_.insert(order_id);
+		if (!location)
+		{
+			return false;
+		}
+		location->order_side = Side::value;
+		add_to_level<Side>(order_id, price, volume, *location);
+		return true;
+	}
 
-private: //methods
-	//something has modified our book, update the best price for that side and do the midpoint as well
-	void update_best_prices(side s)
+	const price_level *find_level(side s, price_t price) const
+	{
+		return s == side::bid ? bid_levels_.find(price) : ask_levels_.find(price);
+	}
+
+	template <typename Stream>
+	void print_levels(Stream &os) const;
+
+	//the order in the given position on one side, counting through its levels
+	template <typename SideLevels>
+	const book_order *order_in_position(const SideLevels &levels, unsigned position) const;
+
+	//called when the level storage moves a level; repoint its orders at the new address
+	void relink_level(price_level &level)
 	{
-		if (side_to_price_to_vols_[(int)s].empty())
+		for (const auto &order : level.orders)
 		{
-			best_prices_[(int)s] = 0;
+			order_id_to_details_.find(order.order_id)->level = &level;
 		}
-		else
+	}
+
+	//queue the order at the back of its price level, creating the level if needed
+	template <typename Side>
+	void add_to_level(int order_id, price_t price, int volume, order_location &location)
+	{
+		price_level &level = levels_of(Side()).insert(price, [this](price_level &moved) { relink_level(moved); });
+		location.level = &level;
+		location.order = level.orders.insert(level.orders.end(), book_order{order_id, price, volume});
+		level.total_volume += volume;
+		++level.order_count;
+		++order_counts_[(int)Side::value];
+		note_level_change<Side>(price);
+	}
+
+	//take the order out of its level, dropping the level if it's now empty
+	template <typename Side>
+	void remove_from_level(const order_location &location)
+	{
+		price_level &level = *location.level;
+		const price_t price = location.order->price;
+		level.total_volume -= location.order->volume;
+		--level.order_count;
+		--order_counts_[(int)Side::value];
+		level.orders.erase(location.order);
+
+		if (level.order_count == 0)
+		{
+			levels_of(Side()).erase(price, [this](price_level &moved) { relink_level(moved); });
+		}
+		note_level_change<Side>(price);
+	}
+
+	//called before the best prices are brought up to date, so a level at or better than
+	//the side's best price is the touch, or is about to become it
+	template <typename Side>
+	void note_level_change(price_t price)
+	{
+		const price_t best = best_prices_[(int)Side::value];
+		if (best == 0 || !Side::better(best, price))
+		{
+			++top_changes_;
+		}
+		if (depth_.levels() != 0)
+		{
+			depth_.on_level_change<Side>(price);
+		}
+	}
+
+	//something has modified our book, update the best price for that side and do the midpoint as well
+	template <typename Side>
+	void update_best_prices()
+	{
+		if (!levels_of(Side()).best_price(best_prices_[(int)Side::value]))
 		{
-			best_prices_[(int)s] = side_to_price_to_vols_[(int)s].begin()->first;
+			best_prices_[(int)Side::value] = 0;
 		}
 		update_midpoint();
 	}
@@ -253,27 +506,28 @@ private: //methods
 	//update the midpoint every time a price changes
 	void update_midpoint()
 	{
+		const price_t previous = touch_sum_;
+
 		//assume that midpoint is not valid if the book is crossed
-		if (is_crossed())
+		//if either side is zero the midpoint is also zero
+		if (is_crossed() || best_prices_[(int)side::ask] == 0 || best_prices_[(int)side::bid] == 0)
 		{
-			midpoint_ = 0;
-			return;
+			touch_sum_ = 0;
 		}
-
-		//if either side is zero the midpoint is also zero
-		if (best_prices_[(int)side::ask] == 0 || best_prices_[(int)side::bid] == 0)
+		else
 		{
-			midpoint_ = 0;
-			return;
+			//ok do the calculation; it's kept as twice the midpoint so it stays in whole ticks
+			touch_sum_ = best_prices_[(int)side::bid] + best_prices_[(int)side::ask];
 		}
 
-		//ok do the calculation
-		const double diff = best_prices_[(int)side::ask] - best_prices_[(int)side::bid];
-		midpoint_ = best_prices_[(int)side::bid] + (diff * 0.5);
+		if (touch_sum_ != previous)
+		{
+			++midpoint_changes_;
+		}
 	}
 
 	//check the validity of an incoming order event
-	bool check_validity(int order_id, double price, int size)
+	bool check_validity(int order_id, price_t price, int size)
 	{
 		if (order_id < 0 || price < 0 || size < 0)
 		{
@@ -294,21 +548,45 @@ private: //methods
 	}
 
 private: //state
+	tick_size ticks_;
+
+	//where all of the containers below get their nodes from; it has to outlive them
+	std::unique_ptr<node_pool> pool_;
+
 	error_stats error_stats_;
 	trade_stats trade_stats_;
 
-	//2-element vector (one per side) containing the price-to-volumes mappings
-	std::vector<ordered_price_to_volumes> side_to_price_to_vols_;
+	//the price levels on each side
+	bid_levels bid_levels_;
+	ask_levels ask_levels_;
 
-	//mapping of the order id to where the order details can be found in the price-to-volumes mappings
-	std::unordered_map<int, std::pair<side, ordered_price_to_volumes::iterator>> order_id_to_details_;
+	//2-element vector (one per side) containing the number of resting orders
+	std::vector<int> order_counts_;
+
+	//mapping of the order id to where the order details can be found in the price levels
+	order_index<order_location> order_id_to_details_;
 
 	//2-element vector (one per side) containing the current best prices
-	std::vector<double> best_prices_;
+	std::vector<price_t> best_prices_;
+
+	//the sum of the two touch prices (i.e. twice the midpoint), updated every time a
+	//touch price changes. zero if there isn't a valid midpoint
+	price_t touch_sum_ = 0;
 
-	//the current midpoint, updated every time a touch price changes.
-	double midpoint_ = 0.0;
+	//see get_top_changes
+	uint64_t top_changes_ = 0;
+	uint64_t midpoint_changes_ = 0;
+
+	//the best levels of each side, if they're being kept; brought up to date as
+	//they're asked for, hence mutable
+	mutable book_depth depth_;
 };
 
+//the default book keeps its levels in a tree
+typedef basic_orderbook<map_levels> orderbook;
+
+//a book that keeps its near-touch levels in a dense tick ladder
+typedef basic_orderbook<ladder_levels> ladder_orderbook;
+
 #endif
 
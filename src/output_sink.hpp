@@ -0,0 +1,135 @@
+#ifndef __OUTPUT_SINK_H__
+#define __OUTPUT_SINK_H__
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+//buffered text output in front of a std::ostream. everything is formatted into a
+//large buffer with std::to_chars and handed to the stream in one write when the
+//buffer fills or flush() is called, rather than a write (and a flush) per line.
+//
+//the formatting matches what operator<< on a default std::ostream would produce, so
+//output is byte-for-byte the same; doubles come out like printf's %g with the default
+//precision of 6. nothing reaches the stream until a flush, so callers need to flush at
+//the points where they want the output to be visible.
+class output_sink
+{
+public:
+	static constexpr size_t default_capacity = 1 << 20;
+
+	//longest anything formatted by to_chars here can be, e.g. -1.23457e-308
+	static constexpr size_t max_number_chars = 32;
+
+	explicit output_sink(std::ostream &os, size_t capacity = default_capacity)
+		: os_(os),
+		  capacity_(capacity < max_number_chars ? max_number_chars : capacity),
+		  buffer_(new char[capacity_])
+	{
+
+	}
+
+	~output_sink() { flush(); }
+
+	output_sink(const output_sink &) = delete;
+	output_sink &operator=(const output_sink &) = delete;
+
+	//hand everything buffered so far to the stream, and flush that too
+	void flush()
+	{
+		drain();
+		os_.flush();
+	}
+
+	void write(const char *data, size_t len)
+	{
+		if (len > capacity_ - size_)
+		{
+			drain();
+
+			//too big to be worth buffering
+			if (len > capacity_)
+			{
+				os_.write(data, len);
+				return;
+			}
+		}
+		memcpy(buffer_.get() + size_, data, len);
+		size_ += len;
+	}
+
+	output_sink &operator<<(const char *s)
+	{
+		write(s, strlen(s));
+		return *this;
+	}
+
+	output_sink &operator<<(const std::string &s)
+	{
+		write(s.data(), s.size());
+		return *this;
+	}
+
+	output_sink &operator<<(char c)
+	{
+		reserve(1);
+		buffer_[size_++] = c;
+		return *this;
+	}
+
+	output_sink &operator<<(int value) { return format(value); }
+	output_sink &operator<<(long value) { return format(value); }
+	output_sink &operator<<(long long value) { return format(value); }
+	output_sink &operator<<(unsigned value) { return format(value); }
+	output_sink &operator<<(unsigned long value) { return format(value); }
+	output_sink &operator<<(unsigned long long value) { return format(value); }
+
+	output_sink &operator<<(double value)
+	{
+		reserve(max_number_chars);
+		char *const begin = buffer_.get() + size_;
+		size_ += std::to_chars(begin, begin + max_number_chars, value, std::chars_format::general, 6).ptr - begin;
+		return *this;
+	}
+
+	//bytes waiting to be written
+	size_t buffered() const { return size_; }
+
+private: //methods
+	void reserve(size_t len)
+	{
+		if (len > capacity_ - size_)
+		{
+			drain();
+		}
+	}
+
+	void drain()
+	{
+		if (size_ != 0)
+		{
+			os_.write(buffer_.get(), size_);
+			size_ = 0;
+		}
+	}
+
+	template <typename Integer>
+	output_sink &format(Integer value)
+	{
+		reserve(max_number_chars);
+		char *const begin = buffer_.get() + size_;
+		size_ += std::to_chars(begin, begin + max_number_chars, value).ptr - begin;
+		return *this;
+	}
+
+private: //state
+	std::ostream &os_;
+	const size_t capacity_;
+	std::unique_ptr<char[]> buffer_;
+	size_t size_ = 0;
+};
+
+#endif
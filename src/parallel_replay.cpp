@@ -0,0 +1,109 @@
+#include "parallel_replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+parallel_replay::parallel_replay(const parallel_options &options)
+		: options_(options),
+		  threads_(options.threads ? options.threads : std::max(std::thread::hardware_concurrency(), 1u))
+{
+	slot_count_ = std::max(threads_ * std::max(options_.chunks_per_thread, 1u), 2u);
+	slots_.reset(new slot[slot_count_]);
+}
+
+bool parallel_replay::open(const char *filename)
+{
+	if (!file_.open(filename))
+	{
+		return false;
+	}
+	const size_t chunk_bytes = std::max<size_t>(options_.chunk_bytes, 1);
+	chunks_ = (file_.size() + chunk_bytes - 1) / chunk_bytes;
+	return true;
+}
+
+void parallel_replay::run(feedhandler &fh)
+{
+	next_chunk_.store(0);
+	applied_.store(0);
+	for (size_t i = 0; i < slot_count_; ++i)
+	{
+		slots_[i].chunk.store(-1);
+	}
+
+	std::vector<std::thread> pool;
+	for (unsigned i = 0; i < threads_; ++i)
+	{
+		pool.emplace_back(&parallel_replay::decode_chunks, this, std::cref(fh));
+	}
+
+	for (size_t chunk = 0; chunk < chunks_; ++chunk)
+	{
+		slot &s = slots_[chunk % slot_count_];
+		while (s.chunk.load(std::memory_order_acquire) != static_cast<long>(chunk))
+		{
+			std::this_thread::yield();
+		}
+		for (const auto &msg : s.messages)
+		{
+			fh.apply_message(msg);
+		}
+		applied_.store(chunk + 1, std::memory_order_release);
+	}
+
+	for (auto &t : pool)
+	{
+		t.join();
+	}
+}
+
+size_t parallel_replay::line_start(size_t offset) const
+{
+	if (offset == 0)
+	{
+		return 0;
+	}
+	if (offset >= file_.size())
+	{
+		return file_.size();
+	}
+
+	//a line starts at the offset if the byte before it ends one
+	const char *data = file_.data();
+	const char *eol = static_cast<const char *>(memchr(data + offset - 1, '\n', file_.size() - offset + 1));
+	return eol ? eol + 1 - data : file_.size();
+}
+
+void parallel_replay::decode_chunks(const feedhandler &fh)
+{
+	const size_t chunk_bytes = std::max<size_t>(options_.chunk_bytes, 1);
+	for (;;)
+	{
+		const size_t chunk = next_chunk_.fetch_add(1, std::memory_order_relaxed);
+		if (chunk >= chunks_)
+		{
+			return;
+		}
+
+		//the slot is free once the chunk that last used it has been applied
+		while (chunk >= applied_.load(std::memory_order_acquire) + slot_count_)
+		{
+			std::this_thread::yield();
+		}
+
+		slot &s = slots_[chunk % slot_count_];
+		s.messages.clear();
+		const size_t begin = line_start(chunk * chunk_bytes);
+		const size_t end = line_start((chunk + 1) * chunk_bytes);
+		if (begin < end)
+		{
+			for_each_line(file_.data() + begin, end - begin, [&s, &fh](const char *line, size_t len)
+			{
+				s.messages.emplace_back();
+				fh.decode_message(line, len, s.messages.back());
+			});
+		}
+		s.chunk.store(static_cast<long>(chunk), std::memory_order_release);
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef __PARALLEL_REPLAY_H__
+#define __PARALLEL_REPLAY_H__
+
+#include "feedhandler.hpp"
+#include "mapped_file.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct parallel_options
+{
+	//threads decoding chunks; 0 for one per core
+	unsigned threads = 0;
+
+	//bytes of the file in each chunk
+	size_t chunk_bytes = 4 << 20;
+
+	//decoded chunks allowed to wait to be applied, per thread, which bounds the
+	//memory used however big the file is
+	unsigned chunks_per_thread = 2;
+};
+
+//replays a file through a feedhandler by decoding it on a pool of threads. the file
+//is mapped and cut into chunks of whole lines; the threads take chunks in turn and
+//decode every line of one into that chunk's vector of decoded messages, while the
+//thread calling run() applies the vectors in file order. decoding is stateless, and
+//everything that counts or writes anything happens in the apply, so the output and
+//the stats are the same as replaying the file line by line.
+//
+//a chunk is the lines that start within its stretch of bytes, so each thread finds
+//its chunk's bounds by itself, without scanning the file up front. a decoded chunk
+//waits in one of a fixed ring of slots until it's applied; a thread that gets too
+//far ahead waits for its slot to come free.
+class parallel_replay
+{
+public:
+	explicit parallel_replay(const parallel_options &options = parallel_options());
+
+	parallel_replay(const parallel_replay &) = delete;
+	parallel_replay &operator=(const parallel_replay &) = delete;
+
+	//returns false if the file can't be opened
+	bool open(const char *filename);
+
+	//replay the whole file through the feedhandler, which mustn't be used by
+	//anything else until we're done
+	void run(feedhandler &fh);
+
+	unsigned thread_count() const { return threads_; }
+
+private: //types
+	struct slot
+	{
+		//the chunk whose messages are ready in the slot, or -1
+		std::atomic<long> chunk{-1};
+		std::vector<decoded_message> messages;
+	};
+
+private: //methods
+	//where the first line starting at or after the offset begins
+	size_t line_start(size_t offset) const;
+
+	//a pool thread
+	void decode_chunks(const feedhandler &fh);
+
+private: //state
+	const parallel_options options_;
+	const unsigned threads_;
+	mapped_file file_;
+	size_t chunks_ = 0;
+
+	std::unique_ptr<slot[]> slots_;
+	size_t slot_count_ = 0;
+
+	//the next chunk to be taken by a thread, and how many have been applied
+	std::atomic<size_t> next_chunk_{0};
+	std::atomic<size_t> applied_{0};
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//the cpu's hardware event counters, through perf_event_open, for this thread and
+//every thread it starts once the counters are open. only user space is counted, which
+//is all that a perf_event_paranoid of 2, the usual default, allows.
+//
+//whether any counters can be had depends on the kernel, the cpu and whether there's a
+//hypervisor in the way, so each one that can't be opened is just left out; open() only
+//fails if none of them can be
+class perf_counters
+{
+public:
+	enum counter
+	{
+		cycles,
+		instructions,
+		l1d_misses,
+		llc_misses,
+		branch_misses,
+		counter_count
+	};
+
+	static const char *name(counter c)
+	{
+		static const char *names[counter_count] = {"cycles", "instructions", "L1d read misses", "LLC misses", "branch misses"};
+		return names[c];
+	}
+
+	//what the counters have counted; those that aren't open are left at 0
+	struct reading
+	{
+		bool counted[counter_count] = {};
+		double values[counter_count] = {};
+	};
+
+	perf_counters()
+	{
+		for (int &fd : fds_)
+		{
+			fd = -1;
+		}
+	}
+
+	~perf_counters()
+	{
+		for (const int fd : fds_)
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+		}
+	}
+
+	perf_counters(const perf_counters &) = delete;
+	perf_counters &operator=(const perf_counters &) = delete;
+
+	//open the counters, stopped. returns false with the reason the first one gave if
+	//none of them could be opened
+	bool open(std::string &error)
+	{
+		bool any = false;
+		for (int c = 0; c < counter_count; ++c)
+		{
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			describe((counter)c, attr);
+			attr.disabled = 1;
+			attr.inherit = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+
+			//scaled up by how long the counter was on the cpu, in case there are more
+			//counters than the cpu has room for and they have to take turns
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			fds_[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+			if (fds_[c] >= 0)
+			{
+				any = true;
+			}
+			else if (error.empty())
+			{
+				const int reason = errno;
+				error = std::string("perf_event_open: ") + strerror(reason);
+				if (reason == EACCES || reason == EPERM)
+				{
+					error += " (see /proc/sys/kernel/perf_event_paranoid)";
+				}
+				else if (reason == ENOENT || reason == EOPNOTSUPP)
+				{
+					error += " (the cpu has no such counters, or a hypervisor is hiding them)";
+				}
+			}
+		}
+		if (any)
+		{
+			error.clear();
+		}
+		return any;
+	}
+
+	//start counting from zero
+	void start()
+	{
+		for (const int fd : fds_)
+		{
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+	}
+
+	void stop()
+	{
+		for (const int fd : fds_)
+		{
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+	}
+
+	//what's been counted since start(), including by threads that have since finished
+	reading read() const
+	{
+		reading r;
+		for (int c = 0; c < counter_count; ++c)
+		{
+			//value, time enabled, time running
+			uint64_t values[3];
+			if (fds_[c] < 0 || ::read(fds_[c], values, sizeof(values)) != sizeof(values))
+			{
+				continue;
+			}
+			r.counted[c] = true;
+			r.values[c] = values[2] == 0 ? 0 : values[0] * ((double)values[1] / values[2]);
+		}
+		return r;
+	}
+
+private: //methods
+	static void describe(counter c, perf_event_attr &attr)
+	{
+		const auto cache_miss = [&attr](uint64_t cache)
+		{
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		};
+
+		attr.type = PERF_TYPE_HARDWARE;
+		switch (c)
+		{
+		case cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+		case instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+		case l1d_misses: cache_miss(PERF_COUNT_HW_CACHE_L1D); break;
+		case llc_misses: cache_miss(PERF_COUNT_HW_CACHE_LL); break;
+		case branch_misses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+		case counter_count: break;
+		}
+	}
+
+private: //state
+	int fds_[counter_count];
+};
+
+#endif
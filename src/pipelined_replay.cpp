@@ -0,0 +1,155 @@
+#include "pipelined_replay.hpp"
+#include "mapped_file.hpp"
+
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	//the next item from the ring, waiting for one if need be
+	template <typename T>
+	T take(spsc_ring<T> &ring)
+	{
+		T *item;
+		while (!(item = ring.front()))
+		{
+			std::this_thread::yield();
+		}
+		const T value = *item;
+		ring.pop();
+		return value;
+	}
+}
+
+pipelined_replay::pipelined_replay(const pipeline_options &options)
+		: options_(options),
+		  blocks_(options.blocks < 2 ? 2 : options.blocks),
+		  to_decode_(blocks_.size()),
+		  to_apply_(blocks_.size()),
+		  free_(blocks_.size())
+{
+	for (auto &b : blocks_)
+	{
+		b.data.reset(new char[options_.block_bytes]);
+	}
+}
+
+pipelined_replay::~pipelined_replay()
+{
+	if (fd_ >= 0)
+	{
+		::close(fd_);
+	}
+}
+
+bool pipelined_replay::open(const char *filename)
+{
+	fd_ = ::open(filename, O_RDONLY);
+	if (fd_ < 0)
+	{
+		return false;
+	}
+	posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+	return true;
+}
+
+void pipelined_replay::run(feedhandler &fh)
+{
+	//every block starts off with the reader
+	for (auto &b : blocks_)
+	{
+		b.last = false;
+		free_.push(&b);
+	}
+
+	std::thread reader(&pipelined_replay::read_blocks, this);
+	std::thread decoder(&pipelined_replay::decode_blocks, this, std::cref(fh));
+
+	for (;;)
+	{
+		block *b = take(to_apply_);
+		for (const auto &msg : b->messages)
+		{
+			fh.apply_message(msg);
+		}
+		if (b->last)
+		{
+			break;
+		}
+		free_.push(b);
+	}
+
+	reader.join();
+	decoder.join();
+}
+
+void pipelined_replay::read_blocks()
+{
+	//the start of a line that didn't fit in the last block, which opens the next
+	std::vector<char> carry;
+	for (;;)
+	{
+		block *b = take(free_);
+		memcpy(b->data.get(), carry.data(), carry.size());
+		size_t size = carry.size();
+		carry.clear();
+
+		//fill the block; a read error is taken as the end of the file
+		bool eof = false;
+		while (size < options_.block_bytes)
+		{
+			const ssize_t n = ::read(fd_, b->data.get() + size, options_.block_bytes - size);
+			if (n <= 0)
+			{
+				eof = true;
+				break;
+			}
+			size += n;
+		}
+
+		//end the block on a whole line and hold the rest back for the next one.
+		//a line longer than a whole block has to be split
+		b->size = size;
+		if (!eof)
+		{
+			const char *data = b->data.get();
+			const char *eol = static_cast<const char *>(memrchr(data, '\n', size));
+			if (eol)
+			{
+				b->size = eol + 1 - data;
+				carry.assign(eol + 1, data + size);
+			}
+		}
+
+		b->last = eof;
+		to_decode_.push(b);
+		if (eof)
+		{
+			return;
+		}
+	}
+}
+
+void pipelined_replay::decode_blocks(const feedhandler &fh)
+{
+	for (;;)
+	{
+		block *b = take(to_decode_);
+		b->messages.clear();
+		for_each_line(b->data.get(), b->size, [b, &fh](const char *line, size_t len)
+		{
+			b->messages.emplace_back();
+			fh.decode_message(line, len, b->messages.back());
+		});
+
+		const bool last = b->last;
+		to_apply_.push(b);
+		if (last)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef __PIPELINED_REPLAY_H__
+#define __PIPELINED_REPLAY_H__
+
+#include "feedhandler.hpp"
+#include "spsc_ring.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct pipeline_options
+{
+	//size of each block read from the file, and how many there are in flight
+	size_t block_bytes = 1 << 20;
+	unsigned blocks = 8;
+};
+
+//replays a file through a feedhandler in three stages, each on its own thread:
+//  read - fills large blocks from the file, each ending on a whole line
+//  decode - splits a block into lines and decodes each one with decode_message
+//  apply - applies the decoded messages to the books and writes the output
+//the stages hand whole blocks to each other over single-producer/single-consumer
+//rings, so the cost of the handover is spread over a block's worth of lines, and
+//the apply stage hands them back to the reader once it's done with them. the
+//decoded messages point into their block's text, so nothing is copied.
+//
+//the apply stage is the thread calling run(), and the output is the same as
+//processing the file line by line.
+class pipelined_replay
+{
+public:
+	explicit pipelined_replay(const pipeline_options &options = pipeline_options());
+	~pipelined_replay();
+
+	pipelined_replay(const pipelined_replay &) = delete;
+	pipelined_replay &operator=(const pipelined_replay &) = delete;
+
+	//returns false if the file can't be opened
+	bool open(const char *filename);
+
+	//replay the whole file through the feedhandler, which mustn't be used by
+	//anything else until we're done
+	void run(feedhandler &fh);
+
+private: //types
+	struct block
+	{
+		std::unique_ptr<char[]> data;
+		size_t size = 0;
+
+		//the final block of the file
+		bool last = false;
+
+		//filled in by the decode stage; kept between uses for its capacity
+		std::vector<decoded_message> messages;
+	};
+
+private: //methods
+	void read_blocks();
+	void decode_blocks(const feedhandler &fh);
+
+private: //state
+	const pipeline_options options_;
+	int fd_ = -1;
+
+	std::vector<block> blocks_;
+	spsc_ring<block *> to_decode_;
+	spsc_ring<block *> to_apply_;
+	spsc_ring<block *> free_;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef __PRICE_H__
+#define __PRICE_H__
+
+#include <cstdint>
+#include <cmath>
+
+//prices are held as a whole number of ticks everywhere inside the book; they only
+//become doubles at the output edge
+typedef int64_t price_t;
+
+//the price grid of an instrument. the tick is a power of ten, e.g. 2 decimals
+//gives a tick of 0.01 and a price of 12.34 is held as 1234 ticks
+class tick_size
+{
+public:
+	static const int max_decimals = 9;
+
+	explicit tick_size(int decimals = 2)
+		: decimals_(decimals)
+	{
+		for (int i = 0; i < decimals_; ++i)
+		{
+			ticks_per_unit_ *= 10;
+		}
+	}
+
+	int decimals() const { return decimals_; }
+	int64_t ticks_per_unit() const { return ticks_per_unit_; }
+
+	//convert ticks back to a price for output. dividing by the exact integer scale
+	//gives the correctly rounded double, i.e. the same as parsing the decimal text
+	double to_price(price_t ticks) const
+	{
+		return ticks / static_cast<double>(ticks_per_unit_);
+	}
+
+	//nearest tick to a double price; for callers that start from a double rather
+	//than from feed text
+	price_t to_ticks(double price) const
+	{
+		return std::llround(price * ticks_per_unit_);
+	}
+
+	//exact conversion of mantissa * 10^exponent to ticks
+	//returns false if the price isn't on a tick or doesn't fit
+	bool to_ticks(uint64_t mantissa, int exponent, price_t &ticks) const
+	{
+		int shift = exponent + decimals_;
+		if (mantissa == 0)
+		{
+			ticks = 0;
+			return true;
+		}
+
+		//digits below the tick must all be zero
+		for (; shift < 0; ++shift)
+		{
+			if (mantissa % 10 != 0)
+			{
+				return false;
+			}
+			mantissa /= 10;
+		}
+		for (; shift > 0; --shift)
+		{
+			if (mantissa > static_cast<uint64_t>(INT64_MAX) / 10)
+			{
+				return false;
+			}
+			mantissa *= 10;
+		}
+		if (mantissa > static_cast<uint64_t>(INT64_MAX))
+		{
+			return false;
+		}
+		ticks = static_cast<price_t>(mantissa);
+		return true;
+	}
+
+private:
+	int decimals_;
+	int64_t ticks_per_unit_ = 1;
+};
+
+#endif
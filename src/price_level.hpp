@@ -0,0 +1,32 @@
+#ifndef __PRICE_LEVEL_H__
+#define __PRICE_LEVEL_H__
+
+#include "price.hpp"
+#include "node_pool.hpp"
+
+#include <list>
+
+//a single resting order
+struct book_order
+{
+	int order_id;
+	price_t price;
+	int volume;
+};
+
+//the orders at one price, in time priority, with their nodes taken from the book's pool
+typedef std::list<book_order, pool_allocator<book_order>> order_queue;
+
+//all of the orders resting at one price, in time priority, along with their
+//aggregate volume so that depth queries don't have to walk the orders
+struct price_level
+{
+	price_level() = default;
+	explicit price_level(const pool_allocator<book_order> &alloc) : orders(alloc) {}
+
+	int total_volume = 0;
+	int order_count = 0;
+	order_queue orders;
+};
+
+#endif
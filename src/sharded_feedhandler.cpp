@@ -0,0 +1,268 @@
+#include "sharded_feedhandler.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace
+{
+	bool pin_to_cpu(int cpu)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+	}
+}
+
+sharded_feedhandler::sharded_feedhandler(int ob_print_frequency, std::ostream &stats_os,
+		const std::vector<std::ostream *> &shard_streams, const sharded_options &options)
+		: out_(stats_os),
+		  parser_(options.feed.ticks),
+		  symbols_(std::max<size_t>(options.feed.max_instruments, 1))
+{
+	//no more shards than instruments, or some would never get any
+	const size_t max_instruments = symbols_.capacity();
+	const size_t shards = std::max<size_t>(std::min<size_t>(options.shards, max_instruments), 1);
+
+	for (size_t i = 0; i < shards; ++i)
+	{
+		shards_.emplace_back(new shard(options.queue_records));
+		shard &s = *shards_.back();
+		if (!options.cpus.empty())
+		{
+			s.cpu = options.cpus[i % options.cpus.size()];
+		}
+
+		//room for exactly the instruments that the round robin will give this shard,
+		//so that a shard turns away the same symbols as the dispatcher
+		feedhandler_options feed = options.feed;
+		feed.max_instruments = (max_instruments - i + shards - 1) / shards;
+		feed.live_metrics = options.feed.live_metrics ? options.feed.live_metrics + i : nullptr;
+		s.thread = std::thread(&sharded_feedhandler::run, this, std::ref(s), ob_print_frequency,
+				std::ref(*shard_streams[i]), feed);
+	}
+}
+
+sharded_feedhandler::~sharded_feedhandler()
+{
+	flush();
+	stopping_.store(true, std::memory_order_release);
+	for (auto &s : shards_)
+	{
+		s->thread.join();
+	}
+}
+
+void sharded_feedhandler::process_message(const std::string &line)
+{
+	process_message(line.data(), line.size());
+}
+
+void sharded_feedhandler::process_message(const char *line, size_t len)
+{
+	//only a line that parses makes an instrument of its symbol, as in the shards'
+	//own feedhandlers, so a bad line can't use up an id that a good one needs. lines
+	//without a symbol we can take go to the first shard, which will find them
+	//unparsable just as we did
+	decoded_message decoded;
+	decoded.line = line;
+	decoded.len = len;
+	const char *comma = static_cast<const char *>(memchr(line, ',', len));
+	int id = -1;
+	if (comma)
+	{
+		decoded.symbol = line;
+		decoded.symbol_len = comma - line;
+		const char *rest = comma + 1;
+#ifdef FEEDHANDLER_LATENCY
+		const uint64_t start = read_tsc();
+		decoded.parsed = parser_.parse(rest, line + len - rest, decoded.msg);
+		decoded.parse_ticks = read_tsc() - start;
+#else
+		decoded.parsed = parser_.parse(rest, line + len - rest, decoded.msg);
+#endif
+		id = decoded.parsed
+				? symbols_.find_or_add(decoded.symbol, decoded.symbol_len)
+				: symbols_.find(decoded.symbol, decoded.symbol_len);
+	}
+	shard &s = *shards_[id < 0 ? 0 : id % shards_.size()];
+	push_line(s, decoded);
+	++s.lines;
+}
+
+void sharded_feedhandler::push_line(shard &s, const decoded_message &decoded)
+{
+	const char *line = decoded.line;
+	size_t len = decoded.len;
+
+	shard_record record;
+	record.type = shard_record::kind::line_part;
+	while (len > shard_record::max_text)
+	{
+		record.count = shard_record::max_text;
+		memcpy(record.text, line, shard_record::max_text);
+		s.queue.push(record);
+		line += shard_record::max_text;
+		len -= shard_record::max_text;
+	}
+
+	record.type = shard_record::kind::line;
+	record.count = static_cast<uint8_t>(len);
+	record.has_symbol = decoded.symbol != nullptr;
+	const size_t too_long = symbol_directory::max_symbol_length + 1;
+	record.symbol_len = static_cast<uint8_t>(decoded.symbol_len < too_long ? decoded.symbol_len : too_long);
+	record.parsed = decoded.parsed;
+	record.msg = decoded.msg;
+#ifdef FEEDHANDLER_LATENCY
+	record.parse_ticks = decoded.parse_ticks;
+#endif
+	memcpy(record.text, line, len);
+	s.queue.push(record);
+}
+
+void sharded_feedhandler::flush()
+{
+	//let the shards all work through their queues at once, then wait for them
+	shard_record record;
+	record.type = shard_record::kind::flush;
+	for (auto &s : shards_)
+	{
+		s->queue.push(record);
+	}
+	for (auto &s : shards_)
+	{
+		s->queue.wait_until_empty();
+	}
+}
+
+feed_stats sharded_feedhandler::get_stats()
+{
+	flush();
+
+	std::vector<feed_stats> shard_stats;
+	size_t instruments = 0;
+	for (auto &s : shards_)
+	{
+		shard_stats.push_back(s->handler->get_stats());
+		instruments += shard_stats.back().instruments.size();
+	}
+
+	feed_stats merged;
+	merged.multi_instrument = true;
+	merged.instruments.resize(instruments);
+	for (size_t i = 0; i < shard_stats.size(); ++i)
+	{
+		const feed_stats &stats = shard_stats[i];
+		merged.messages += stats.messages;
+		merged.unparsable += stats.unparsable;
+		merged.book_errors += stats.book_errors;
+		merged.instrument_capacity += stats.instrument_capacity;
+		merged.unknown_instruments += stats.unknown_instruments;
+#ifdef FEEDHANDLER_LATENCY
+		merged.latencies += stats.latencies;
+#endif
+
+		//a shard's nth instrument was the nth to be dealt to it, which puts it
+		//back in the overall order of first sighting
+		for (size_t n = 0; n < stats.instruments.size(); ++n)
+		{
+			merged.instruments[n * shard_stats.size() + i] = stats.instruments[n];
+		}
+	}
+	return merged;
+}
+
+void sharded_feedhandler::print_stats()
+{
+	write_feed_stats(out_, get_stats());
+
+	out_ << "SHARD STATS:" << '\n';
+	for (size_t i = 0; i < shards_.size(); ++i)
+	{
+		const shard &s = *shards_[i];
+		const auto &queue_stats = s.queue.get_producer_stats();
+		out_ << "  shard " << i << ": lines " << s.lines
+				<< ", queue capacity " << queue_stats.capacity
+				<< ", high-water mark " << queue_stats.high_water_mark
+				<< ", dispatcher stalls " << queue_stats.stalls;
+		if (s.cpu < 0)
+		{
+			out_ << ", unpinned";
+		}
+		else
+		{
+			out_ << ", cpu " << s.cpu << (s.pinned ? "" : " (pinning failed)");
+		}
+		out_ << '\n';
+	}
+	out_ << '\n';
+	out_.flush();
+}
+
+void sharded_feedhandler::run(shard &s, int ob_print_frequency, std::ostream &os, const feedhandler_options &options)
+{
+	//pin before building the books, so that their memory is first touched, and
+	//so allocated, from the cpu that will use it
+	if (s.cpu >= 0)
+	{
+		s.pinned = pin_to_cpu(s.cpu);
+	}
+	s.handler.reset(new feedhandler(ob_print_frequency, os, options));
+
+	//where a line that came in pieces is put back together
+	std::string pending;
+	for (;;)
+	{
+		const shard_record *record = s.queue.front();
+		if (!record)
+		{
+			//we're only stopped once the queue has been drained
+			if (stopping_.load(std::memory_order_acquire))
+			{
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+
+		switch (record->type)
+		{
+		case shard_record::kind::line_part:
+			pending.append(record->text, record->count);
+			break;
+		case shard_record::kind::line:
+		{
+			//the dispatcher's decoding, pointed at our copy of the line
+			decoded_message decoded;
+			if (pending.empty())
+			{
+				decoded.line = record->text;
+				decoded.len = record->count;
+			}
+			else
+			{
+				pending.append(record->text, record->count);
+				decoded.line = pending.data();
+				decoded.len = pending.size();
+			}
+			decoded.symbol = record->has_symbol ? decoded.line : nullptr;
+			decoded.symbol_len = record->symbol_len;
+			decoded.parsed = record->parsed;
+			decoded.msg = record->msg;
+#ifdef FEEDHANDLER_LATENCY
+			decoded.parse_ticks = record->parse_ticks;
+#endif
+			s.handler->apply_message(decoded);
+			pending.clear();
+			break;
+		}
+		case shard_record::kind::flush:
+			s.handler->flush();
+			break;
+		}
+		s.queue.pop();
+	}
+}
@@ -0,0 +1,145 @@
+#ifndef __SHARDED_FEEDHANDLER_H__
+#define __SHARDED_FEEDHANDLER_H__
+
+#include "feedhandler.hpp"
+#include "message_parser.hpp"
+#include "output_sink.hpp"
+#include "spsc_ring.hpp"
+#include "symbol_directory.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct sharded_options
+{
+	//what each shard's feedhandler is built with. the feed must be multi instrument,
+	//and max_instruments is the total across all the shards. live_metrics, if set, is
+	//the first of a slot for each shard
+	feedhandler_options feed;
+
+	unsigned shards = 2;
+
+	//lines each shard's queue can hold
+	size_t queue_records = 1 << 14;
+
+	//cpus to pin the shards' threads to, shard i to cpus[i % cpus.size()]; empty
+	//to leave them to the scheduler
+	std::vector<int> cpus;
+};
+
+//applies a multi instrument feed across several threads. the thread calling
+//process_message is the dispatcher: it splits off each line's symbol and parses
+//the rest, interns the symbol if the line parsed, and hands the line and the
+//parsed message over a single-producer/single-consumer queue to the shard that
+//owns that instrument. each shard is a thread running its own feedhandler over a
+//disjoint set of books, which applies the message without parsing it again, so
+//there's no sharing between shards at all.
+//
+//instruments are dealt out to the shards round robin in order of first sighting.
+//every message for an instrument goes through the same queue, so each instrument's
+//messages are applied in feed order; there's no ordering between instruments.
+//each shard writes its output to its own stream, and print_stats merges the stats
+//of all of them.
+class sharded_feedhandler
+{
+public:
+	//shard i writes its output to *shard_streams[i], which must outlive us
+	sharded_feedhandler(int ob_print_frequency, std::ostream &stats_os,
+			const std::vector<std::ostream *> &shard_streams, const sharded_options &options);
+
+	//drains the queues, then stops the shards
+	~sharded_feedhandler();
+
+	sharded_feedhandler(const sharded_feedhandler &) = delete;
+	sharded_feedhandler &operator=(const sharded_feedhandler &) = delete;
+
+	unsigned shard_count() const { return shards_.size(); }
+
+	//dispatch the message to its shard
+	void process_message(const std::string &line);
+	void process_message(const char *line, size_t len);
+
+	//wait for every shard to catch up, and flush their output
+	void flush();
+
+	//flush, then print the merged stats of all the shards, followed by how each
+	//shard's queue fared
+	void print_stats();
+
+	//flush, then merge the shards' stats
+	feed_stats get_stats();
+
+private: //types
+	//one line, or a piece of one, on its way to a shard. a line's last record also
+	//carries what the dispatcher made of it, so the shard doesn't parse it again
+	struct shard_record
+	{
+		enum class kind : uint8_t
+		{
+			line_part,	//more to follow
+			line,
+			flush
+		};
+
+		static constexpr unsigned max_text = 64;
+
+		kind type = kind::flush;
+		uint8_t count = 0;
+
+		//whether the line has a comma, where the symbol ends if so (anything too
+		//long for a symbol is cut to one past the longest), and whether the rest
+		//of the line parsed into msg
+		bool has_symbol = false;
+		uint8_t symbol_len = 0;
+		bool parsed = false;
+		parsed_message msg;
+#ifdef FEEDHANDLER_LATENCY
+		uint64_t parse_ticks = 0;
+#endif
+
+		char text[max_text];
+	};
+
+	struct shard
+	{
+		explicit shard(size_t queue_records)
+			: queue(queue_records)
+		{
+
+		}
+
+		spsc_ring<shard_record> queue;
+		std::thread thread;
+
+		//only touched by the dispatcher
+		uint64_t lines = 0;
+
+		//set by the shard's thread before it takes anything off the queue
+		std::unique_ptr<feedhandler> handler;
+		bool pinned = false;
+		int cpu = -1;
+	};
+
+private: //methods
+	void push_line(shard &s, const decoded_message &decoded);
+
+	//a shard's thread
+	void run(shard &s, int ob_print_frequency, std::ostream &os, const feedhandler_options &options);
+
+private: //state
+	output_sink out_;
+
+	//the dispatcher's view of the symbols, which decides the shards
+	message_parser parser_;
+	symbol_directory symbols_;
+
+	std::vector<std::unique_ptr<shard>> shards_;
+	std::atomic<bool> stopping_{false};
+};
+
+#endif
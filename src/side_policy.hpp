@@ -0,0 +1,31 @@
+#ifndef __SIDE_POLICY_H__
+#define __SIDE_POLICY_H__
+
+#include "enums.hpp"
+#include "price.hpp"
+
+#include <functional>
+
+//compile-time description of a side of the book, so that containers for each side
+//can be specialised on it and their price comparisons inlined
+
+//bids are ordered from highest to lowest
+struct bid_side
+{
+	static const side value = side::bid;
+	typedef std::greater<price_t> compare;
+
+	//true if left is a better price than right for this side
+	static bool better(price_t left, price_t right) { return left > right; }
+};
+
+//asks are ordered lowest to highest
+struct ask_side
+{
+	static const side value = side::ask;
+	typedef std::less<price_t> compare;
+
+	static bool better(price_t left, price_t right) { return left < right; }
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+//bounded lock-free queue between exactly one producer thread and one consumer thread.
+//
+//each side owns one index and only reads the other's when it has to: the producer
+//keeps a cached copy of the consumer's position and only reloads it when the ring
+//looks full, and vice versa, so in the steady state neither side touches the other's
+//cache line. the indices live on separate cache lines to avoid false sharing.
+//
+//the consumer looks at the front item in place and pops it once it's done with it,
+//so the producer can tell when an item has been fully dealt with and not just taken.
+//
+//push() waits for room when the ring is full and keeps stats on how often that
+//happened and how full the ring got, so that the ring can be sized from them
+template <typename T>
+class spsc_ring
+{
+public:
+	struct producer_stats
+	{
+		size_t capacity = 0;
+		size_t high_water_mark = 0;	//most items seen waiting in the ring
+		uint64_t pushes = 0;
+		uint64_t stalls = 0;	//pushes that found the ring full
+	};
+
+	//how often push() looks at how full the ring is; every push would mean pulling
+	//in the consumer's cache line each time
+	static const uint64_t occupancy_sample_interval = 64;
+
+	//capacity is rounded up to a power of two
+	explicit spsc_ring(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		mask_ = size - 1;
+		slots_.reset(new T[size]);
+		stats_.capacity = size;
+	}
+
+	spsc_ring(const spsc_ring &) = delete;
+	spsc_ring &operator=(const spsc_ring &) = delete;
+
+	size_t capacity() const { return mask_ + 1; }
+
+	//producer: add an item, or return false if the ring is full
+	bool try_push(const T &item)
+	{
+		const size_t head = producer_.index.load(std::memory_order_relaxed);
+		if (head - producer_.cached_other > mask_)
+		{
+			producer_.cached_other = consumer_.index.load(std::memory_order_acquire);
+			if (head - producer_.cached_other > mask_)
+			{
+				return false;
+			}
+		}
+		slots_[head & mask_] = item;
+		producer_.index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//producer: add an item, yielding until there's room for it
+	void push(const T &item)
+	{
+		if (!try_push(item))
+		{
+			++stats_.stalls;
+			stats_.high_water_mark = capacity();
+			while (!try_push(item))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (++stats_.pushes % occupancy_sample_interval == 0)
+		{
+			stats_.high_water_mark = std::max(stats_.high_water_mark, size());
+		}
+	}
+
+	//producer: wait until the consumer has popped everything pushed so far
+	void wait_until_empty() const
+	{
+		while (!empty())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	//only stable while the producer isn't pushing
+	const producer_stats &get_producer_stats() const { return stats_; }
+
+	//consumer: the oldest item, or null if the ring is empty
+	T *front()
+	{
+		const size_t tail = consumer_.index.load(std::memory_order_relaxed);
+		if (tail == consumer_.cached_other)
+		{
+			consumer_.cached_other = producer_.index.load(std::memory_order_acquire);
+			if (tail == consumer_.cached_other)
+			{
+				return nullptr;
+			}
+		}
+		return &slots_[tail & mask_];
+	}
+
+	//consumer: drop the item returned by front(), handing its slot back
+	void pop()
+	{
+		consumer_.index.store(consumer_.index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	//number of items in the ring at some point during the call; exact if neither side
+	//is running
+	size_t size() const
+	{
+		const size_t tail = consumer_.index.load(std::memory_order_acquire);
+		return producer_.index.load(std::memory_order_acquire) - tail;
+	}
+
+	bool empty() const { return size() == 0; }
+
+private: //types
+	//one side's position, and its view of the other side's
+	struct alignas(64) position
+	{
+		std::atomic<size_t> index{0};
+		size_t cached_other = 0;
+	};
+
+private: //state
+	position producer_;
+	position consumer_;
+
+	size_t mask_ = 0;
+	std::unique_ptr<T[]> slots_;
+
+	//only touched by the producer
+	producer_stats stats_;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef __SYMBOL_DIRECTORY_H__
+#define __SYMBOL_DIRECTORY_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//interns instrument symbols as small dense ids, 0, 1, 2... in order of first sighting,
+//so that everything per instrument can live in a vector indexed by id.
+//
+//symbols are packed into two words and looked up in an open addressed table, so
+//finding one is a hash of two words and a compare, with no strings involved. the
+//table is sized for the most instruments we'll take when it's built and never grows;
+//a symbol seen for the first time mid-session costs an insert and nothing more.
+//a feed tends to carry runs of messages for the same instrument, so the last symbol
+//found is checked first.
+class symbol_directory
+{
+public:
+	static const size_t max_symbol_length = 16;
+
+	explicit symbol_directory(size_t max_symbols)
+		: max_symbols_(max_symbols)
+	{
+		size_t slots = 16;
+		while (slots < max_symbols * 2)
+		{
+			slots <<= 1;
+		}
+		slots_.resize(slots);
+		mask_ = slots - 1;
+		names_.reserve(max_symbols);
+	}
+
+	//the id of the symbol in text[0, len), adding it if it's new
+	//returns -1 if the symbol is empty, too long, or new when we're already full
+	int find_or_add(const char *text, size_t len)
+	{
+		if (len == 0 || len > max_symbol_length)
+		{
+			return -1;
+		}
+		const key k = make_key(text, len);
+		if (last_id_ >= 0 && k == last_key_)
+		{
+			return last_id_;
+		}
+
+		size_t i = hash(k) & mask_;
+		for (; slots_[i].id >= 0; i = (i + 1) & mask_)
+		{
+			if (slots_[i].symbol == k)
+			{
+				return remember(k, slots_[i].id);
+			}
+		}
+
+		if (names_.size() == max_symbols_)
+		{
+			return -1;
+		}
+		slots_[i].symbol = k;
+		slots_[i].id = static_cast<int>(names_.size());
+		names_.emplace_back(text, len);
+		return remember(k, slots_[i].id);
+	}
+
+	//the id of the symbol in text[0, len) if we've seen it, without adding it
+	//returns -1 if it's not in the directory
+	int find(const char *text, size_t len) const
+	{
+		if (len == 0 || len > max_symbol_length)
+		{
+			return -1;
+		}
+		const key k = make_key(text, len);
+		if (last_id_ >= 0 && k == last_key_)
+		{
+			return last_id_;
+		}
+
+		for (size_t i = hash(k) & mask_; slots_[i].id >= 0; i = (i + 1) & mask_)
+		{
+			if (slots_[i].symbol == k)
+			{
+				return slots_[i].id;
+			}
+		}
+		return -1;
+	}
+
+	const std::string &name(int id) const { return names_[id]; }
+
+	size_t size() const { return names_.size(); }
+	size_t capacity() const { return max_symbols_; }
+
+private: //types
+	//the symbol's bytes, zero padded
+	struct key
+	{
+		uint64_t words[2] = {0, 0};
+
+		bool operator==(const key &other) const
+		{
+			return words[0] == other.words[0] && words[1] == other.words[1];
+		}
+	};
+
+	struct slot
+	{
+		key symbol;
+		int id = -1;
+	};
+
+private: //methods
+	static key make_key(const char *text, size_t len)
+	{
+		key k;
+		memcpy(k.words, text, len);
+		return k;
+	}
+
+	static size_t hash(const key &k)
+	{
+		return static_cast<size_t>((k.words[0] ^ (k.words[1] * 0x9E3779B97F4A7C15ull)) * 0x9E3779B97F4A7C15ull >> 32);
+	}
+
+	int remember(const key &k, int id)
+	{
+		last_key_ = k;
+		last_id_ = id;
+		return id;
+	}
+
+private: //state
+	const size_t max_symbols_;
+	std::vector<slot> slots_;
+	size_t mask_ = 0;
+	std::vector<std::string> names_;
+
+	key last_key_;
+	int last_id_ = -1;
+};
+
+#endif
@@ -0,0 +1,712 @@
+#ifndef __WORKLOAD_SIMULATOR_H__
+#define __WORKLOAD_SIMULATOR_H__
+
+#include "enums.hpp"
+#include "message_parser.hpp"
+#include "price.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//the shape of the feed a workload_simulator generates. each side of each book is
+//filled to depth resting orders before anything else happens to it, and then kept
+//between depth and twice depth, with the events picked by the weights below
+struct workload_profile
+{
+	std::string name;
+	std::string description;
+
+	//books, each with its symbol at the start of its lines when there's more than one.
+	//the book each event is for is drawn from a zipf distribution with this exponent,
+	//so 0 is every book as busy as the next and 1 or more is a few very busy ones
+	int instruments = 1;
+	double instrument_skew = 0;
+
+	int depth = 200;
+
+	//adds go up to this many ticks behind the far touch. how far behind, and which level
+	//a modify or a remove picks an order from, is drawn from a zipf distribution with
+	//the exponent touch_skew: 0 is anywhere, and the higher it is the more of the
+	//activity is at the touch
+	int levels = 50;
+	double touch_skew = 0.5;
+
+	//relative weights of the events on a side that's at depth
+	int add_weight = 45;
+	int remove_weight = 35;
+	int modify_volume_weight = 10;
+	int modify_price_weight = 5;	//cancel-replace, to the back of another level
+	int aggress_weight = 5;	//an add that crosses the spread and trades
+
+	//each event starts a burst with this probability: burst_length aggressive orders in
+	//a row on one side of one book, each up to sweep_levels ticks through the touch
+	double burst_probability = 0;
+	int burst_length = 0;
+	int sweep_levels = 0;
+
+	int max_volume = 400;
+
+	//the named profiles simulator -w picks from
+	static const std::vector<workload_profile> &all()
+	{
+		static const std::vector<workload_profile> profiles = []()
+		{
+			std::vector<workload_profile> all;
+
+			workload_profile balanced;
+			balanced.name = "balanced";
+			balanced.description = "a mix of adds, removes, modifies and trades on a book of a few hundred orders";
+			all.push_back(balanced);
+
+			workload_profile deep = balanced;
+			deep.name = "deep";
+			deep.description = "a book of 50k orders a side over 2000 levels, mostly busy away from the touch";
+			deep.depth = 50000;
+			deep.levels = 2000;
+			deep.touch_skew = 0.2;
+			all.push_back(deep);
+
+			workload_profile cancel_replace = balanced;
+			cancel_replace.name = "cancel_replace";
+			cancel_replace.description = "mostly orders repriced near the touch, as quoting algorithms do";
+			cancel_replace.depth = 500;
+			cancel_replace.levels = 20;
+			cancel_replace.touch_skew = 1.2;
+			cancel_replace.add_weight = 15;
+			cancel_replace.remove_weight = 12;
+			cancel_replace.modify_volume_weight = 10;
+			cancel_replace.modify_price_weight = 60;
+			cancel_replace.aggress_weight = 3;
+			all.push_back(cancel_replace);
+
+			workload_profile touch = balanced;
+			touch.name = "touch";
+			touch.description = "activity crowded onto the first few levels of a 1000 order book";
+			touch.depth = 1000;
+			touch.levels = 200;
+			touch.touch_skew = 2.0;
+			all.push_back(touch);
+
+			workload_profile bursty = balanced;
+			bursty.name = "bursty";
+			bursty.description = "quiet quoting broken up by bursts of 200 trades sweeping up to 5 levels";
+			bursty.depth = 500;
+			bursty.touch_skew = 1.0;
+			bursty.aggress_weight = 2;
+			bursty.burst_probability = 0.001;
+			bursty.burst_length = 200;
+			bursty.sweep_levels = 5;
+			all.push_back(bursty);
+
+			workload_profile many = balanced;
+			many.name = "many_instruments";
+			many.description = "2000 books of 50 orders a side, a few of them much busier than the rest";
+			many.instruments = 2000;
+			many.instrument_skew = 1.0;
+			many.depth = 50;
+			many.levels = 30;
+			many.touch_skew = 1.0;
+			all.push_back(many);
+
+			return all;
+		}();
+		return profiles;
+	}
+
+	//returns false if there's no profile by that name
+	static bool named(const std::string &name, workload_profile &profile)
+	{
+		for (const auto &p : all())
+		{
+			if (p.name == name)
+			{
+				profile = p;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+//splitmix64, which is a few multiplies and shifts a draw rather than the mersenne
+//twister's table, and draws in a range by multiplying rather than dividing
+class workload_rng
+{
+public:
+	explicit workload_rng(uint64_t seed) : state_(seed) {}
+
+	uint64_t next()
+	{
+		uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	//in [0, n)
+	uint32_t below(uint32_t n) { return (uint32_t)(((next() >> 32) * n) >> 32); }
+
+	//in [0, 1)
+	double unit() { return (next() >> 11) * (1.0 / (uint64_t(1) << 53)); }
+
+private: //state
+	uint64_t state_;
+};
+
+//draws k in [0, n) with probability proportional to 1/(k+1)^exponent, by inverting
+//the cumulative distribution. a guide table of where each of guide_size equal slices of
+//[0, 1) starts in it means a draw is a lookup and usually no more than a step or two on,
+//rather than a binary search's worth of unpredictable branches
+class zipf_table
+{
+public:
+	zipf_table(int n, double exponent)
+		: n_(std::max(n, 1)), uniform_(exponent == 0)
+	{
+		if (uniform_)
+		{
+			return;
+		}
+		cumulative_.resize(n_);
+		double total = 0;
+		for (int k = 0; k < n_; ++k)
+		{
+			total += 1 / std::pow(k + 1, exponent);
+			cumulative_[k] = total;
+		}
+		for (auto &c : cumulative_)
+		{
+			c /= total;
+		}
+		cumulative_.back() = 1;
+
+		guide_.resize(std::min(4 * n_, 1 << 16));
+		int k = 0;
+		for (size_t slice = 0; slice < guide_.size(); ++slice)
+		{
+			while (cumulative_[k] <= (double)slice / guide_.size())
+			{
+				++k;
+			}
+			guide_[slice] = k;
+		}
+	}
+
+	int draw(workload_rng &rng) const
+	{
+		if (uniform_)
+		{
+			return rng.below(n_);
+		}
+		const double u = rng.unit();
+		int k = guide_[(size_t)(u * guide_.size())];
+		while (cumulative_[k] <= u)
+		{
+			++k;
+		}
+		return k;
+	}
+
+private: //state
+	int n_;
+	bool uniform_;
+	std::vector<double> cumulative_;
+	std::vector<int> guide_;
+};
+
+//generates a feed to a workload_profile, fast enough to load the feedhandler at
+//tens of millions of events a second. it keeps just enough of each book to stay
+//consistent: the resting orders in a slot array, each in a fifo on its price level,
+//and a list of each side's orders to pick from at random, so every event is a few
+//draws and pointer moves and never a search through a book.
+//
+//it only ever modifies or removes orders that are resting, and it never crosses a
+//book except with an aggressive add, which is followed straight away by the trades
+//and the removes and modifies of the orders it fills, then its own remove or modify
+//if it's left resting, as the feed has them. the same profile and seed always give
+//the same feed
+class workload_simulator
+{
+public:
+	//books start out around 1000.00 at 2 decimal places
+	static constexpr price_t mid_price = 100000;
+
+	workload_simulator(const workload_profile &profile, uint64_t seed)
+		: profile_(profile),
+		  rng_(seed),
+		  instrument_zipf_(profile.instruments, profile.instrument_skew),
+		  touch_zipf_(profile.levels, profile.touch_skew),
+		  window_(4 * (std::max(profile.levels, 1) + profile.sweep_levels) + 2 * profile.burst_length * profile.sweep_levels + 64),
+		  low_price_(mid_price - window_ / 2),
+		  books_(std::max(profile.instruments, 1))
+	{
+		for (book &b : books_)
+		{
+			b.levels[0].resize(window_);
+			b.levels[1].resize(window_);
+			b.best[0] = -1;
+			b.best[1] = window_;
+		}
+		if (books_.size() > 1)
+		{
+			for (size_t i = 0; i < books_.size(); ++i)
+			{
+				symbols_.push_back("SYM" + std::to_string(i));
+			}
+		}
+		weights_[0] = profile.add_weight;
+		weights_[1] = weights_[0] + profile.remove_weight;
+		weights_[2] = weights_[1] + profile.modify_volume_weight;
+		weights_[3] = weights_[2] + profile.modify_price_weight;
+		weights_[4] = weights_[3] + profile.aggress_weight;
+	}
+
+	//generate the next event, and if it's an aggressive add the trades and fills that go
+	//with it, calling emit(int instrument, const parsed_message &) for each in feed order
+	template <typename Emit>
+	void step(Emit emit)
+	{
+		if (burst_left_ == 0 && profile_.burst_probability > 0 && rng_.unit() < profile_.burst_probability)
+		{
+			burst_left_ = profile_.burst_length;
+			burst_book_ = instrument_zipf_.draw(rng_);
+			burst_side_ = aggressor_side(burst_book_);
+		}
+		if (burst_left_ > 0)
+		{
+			--burst_left_;
+			aggress(burst_book_, burst_side_, profile_.sweep_levels, emit);
+			return;
+		}
+
+		const int b = instrument_zipf_.draw(rng_);
+		const side s = rng_.below(2) ? side::ask : side::bid;
+		const size_t resting = books_[b].live[(int)s].size();
+		if (resting < (size_t)profile_.depth || weights_[4] == 0)
+		{
+			add(b, s, emit);
+			return;
+		}
+
+		const int choice = rng_.below(weights_[4]);
+		if (choice < weights_[0])
+		{
+			if (resting < 2 * (size_t)profile_.depth)
+			{
+				add(b, s, emit);
+			}
+			else
+			{
+				remove(b, s, emit);
+			}
+		}
+		else if (choice < weights_[1])
+		{
+			remove(b, s, emit);
+		}
+		else if (choice < weights_[2])
+		{
+			modify_volume(b, s, emit);
+		}
+		else if (choice < weights_[3])
+		{
+			modify_price(b, s, emit);
+		}
+		else
+		{
+			aggress(b, aggressor_side(b), 0, emit);
+		}
+	}
+
+	const workload_profile &profile() const { return profile_; }
+	int instruments() const { return books_.size(); }
+
+	//the symbol at the start of the instrument's lines, or empty for a single book
+	const std::string &symbol(int instrument) const
+	{
+		static const std::string none;
+		return symbols_.empty() ? none : symbols_[instrument];
+	}
+
+	size_t resting_orders(int instrument, side s) const { return books_[instrument].live[(int)s].size(); }
+
+	//every order resting on the instrument's book, a level at a time and in time
+	//priority within each level, as f(side, price, volume)
+	template <typename F>
+	void for_each_resting_order(int instrument, F f) const
+	{
+		const book &b = books_[instrument];
+		for (const side s : {side::bid, side::ask})
+		{
+			for (int l = 0; l < window_; ++l)
+			{
+				for (uint32_t slot = b.levels[(int)s][l].head; slot != no_order; slot = orders_[slot].next)
+				{
+					f(s, price_of(l), orders_[slot].volume);
+				}
+			}
+		}
+	}
+
+private: //types
+	static constexpr uint32_t no_order = UINT32_MAX;
+
+	struct order
+	{
+		int id;
+		int volume;
+		int level;	//price - low_price_
+		side order_side;
+		uint32_t prev, next;	//in its level's fifo
+		uint32_t live_index;	//in its side's live list
+	};
+
+	struct level
+	{
+		uint32_t head = no_order;
+		uint32_t tail = no_order;
+	};
+
+	struct book
+	{
+		std::vector<level> levels[2];
+		std::vector<uint32_t> live[2];
+
+		//best level of each side, or one past the end of the window when it's empty
+		int best[2];
+	};
+
+private: //methods
+	static parsed_message make_event(message_type type, side s, int order_id, int volume, price_t price)
+	{
+		parsed_message msg;
+		msg.type = type;
+		msg.order_side = s;
+		msg.order_id = order_id;
+		msg.volume = volume;
+		msg.price = price;
+		return msg;
+	}
+
+	static side other(side s) { return s == side::bid ? side::ask : side::bid; }
+
+	bool has_orders(const book &b, side s) const { return !b.live[(int)s].empty(); }
+
+	//whether a bid at level a is at or through an ask at level b, or the other way round
+	static bool crosses(side s, int level, int opposite) { return s == side::bid ? level >= opposite : level <= opposite; }
+
+	int draw_volume() { return 1 + rng_.below(profile_.max_volume); }
+
+	int next_order_id()
+	{
+		//ids only repeat once 2^31 orders have been added
+		const int id = next_order_id_;
+		next_order_id_ = next_order_id_ == INT_MAX ? 1 : next_order_id_ + 1;
+		return id;
+	}
+
+	//a level for a new passive order on the side: behind the other side's touch, or
+	//this side's if the other is empty. returns false if that's off the edge of the
+	//window or would cross
+	bool passive_level(const book &b, side s, int &level)
+	{
+		const int o = (int)other(s);
+		const int distance = touch_zipf_.draw(rng_);
+		if (s == side::bid)
+		{
+			const int reference = has_orders(b, side::ask) ? b.best[o] - 1 : has_orders(b, side::bid) ? b.best[0] : window_ / 2 - 1;
+			level = reference - distance;
+		}
+		else
+		{
+			const int reference = has_orders(b, side::bid) ? b.best[o] + 1 : has_orders(b, side::ask) ? b.best[1] : window_ / 2 + 1;
+			level = reference + distance;
+		}
+		return level >= 0 && level < window_ && (!has_orders(b, other(s)) || !crosses(s, level, b.best[o]));
+	}
+
+	//aggressors mostly take from whichever side would pull the price back to the middle of
+	//the window, so that however long the feed runs the books stay in it
+	side aggressor_side(int b)
+	{
+		const book &bk = books_[b];
+		if (!has_orders(bk, side::bid) || !has_orders(bk, side::ask))
+		{
+			return has_orders(bk, side::ask) ? side::bid : side::ask;
+		}
+		const double offset = (bk.best[0] + bk.best[1] - window_) / (double)window_;
+		return rng_.unit() < 0.5 - offset ? side::bid : side::ask;
+	}
+
+	//an order on the side to modify or remove, most likely from the level the touch
+	//distribution picks, else any; no_order if there are none
+	uint32_t pick_order(const book &b, side s)
+	{
+		const auto &live = b.live[(int)s];
+		if (live.empty())
+		{
+			return no_order;
+		}
+		if (profile_.touch_skew > 0)
+		{
+			const int distance = touch_zipf_.draw(rng_);
+			const int level = s == side::bid ? b.best[0] - distance : b.best[1] + distance;
+			if (level >= 0 && level < window_ && b.levels[(int)s][level].tail != no_order)
+			{
+				return b.levels[(int)s][level].tail;
+			}
+		}
+		return live[rng_.below(live.size())];
+	}
+
+	price_t price_of(int level) const { return low_price_ + level; }
+
+	void link(book &b, uint32_t slot)
+	{
+		order &o = orders_[slot];
+		const int s = (int)o.order_side;
+		level &l = b.levels[s][o.level];
+		o.prev = l.tail;
+		o.next = no_order;
+		(l.tail == no_order ? l.head : orders_[l.tail].next) = slot;
+		l.tail = slot;
+		b.best[s] = s == 0 ? std::max(b.best[s], o.level) : std::min(b.best[s], o.level);
+	}
+
+	void unlink(book &b, uint32_t slot)
+	{
+		const order &o = orders_[slot];
+		const int s = (int)o.order_side;
+		level &l = b.levels[s][o.level];
+		(o.prev == no_order ? l.head : orders_[o.prev].next) = o.next;
+		(o.next == no_order ? l.tail : orders_[o.next].prev) = o.prev;
+		if (l.head == no_order && o.level == b.best[s])
+		{
+			const int step = s == 0 ? -1 : 1;
+			while (b.best[s] >= 0 && b.best[s] < window_ && b.levels[s][b.best[s]].head == no_order)
+			{
+				b.best[s] += step;
+			}
+		}
+	}
+
+	//put an order that's just been unlinked back between its old neighbours
+	void relink(book &b, uint32_t slot)
+	{
+		const order &o = orders_[slot];
+		const int s = (int)o.order_side;
+		level &l = b.levels[s][o.level];
+		(o.prev == no_order ? l.head : orders_[o.prev].next) = slot;
+		(o.next == no_order ? l.tail : orders_[o.next].prev) = slot;
+		b.best[s] = s == 0 ? std::max(b.best[s], o.level) : std::min(b.best[s], o.level);
+	}
+
+	uint32_t insert(book &b, side s, int id, int volume, int level)
+	{
+		uint32_t slot;
+		if (free_.empty())
+		{
+			slot = orders_.size();
+			orders_.emplace_back();
+		}
+		else
+		{
+			slot = free_.back();
+			free_.pop_back();
+		}
+		order &o = orders_[slot];
+		o.id = id;
+		o.volume = volume;
+		o.level = level;
+		o.order_side = s;
+		auto &live = b.live[(int)s];
+		o.live_index = live.size();
+		live.push_back(slot);
+		link(b, slot);
+		return slot;
+	}
+
+	void erase(book &b, uint32_t slot)
+	{
+		unlink(b, slot);
+		auto &live = b.live[(int)orders_[slot].order_side];
+		const uint32_t moved = live.back();
+		live[orders_[slot].live_index] = moved;
+		orders_[moved].live_index = orders_[slot].live_index;
+		live.pop_back();
+		free_.push_back(slot);
+	}
+
+	template <typename Emit>
+	void add(int b, side s, Emit &emit)
+	{
+		book &bk = books_[b];
+		int level;
+		if (!passive_level(bk, s, level))
+		{
+			return;
+		}
+		const int id = next_order_id();
+		const int volume = draw_volume();
+		insert(bk, s, id, volume, level);
+		emit(b, make_event(message_type::add, s, id, volume, price_of(level)));
+	}
+
+	template <typename Emit>
+	void remove(int b, side s, Emit &emit)
+	{
+		book &bk = books_[b];
+		const uint32_t slot = pick_order(bk, s);
+		if (slot == no_order)
+		{
+			return;
+		}
+		const order &o = orders_[slot];
+		emit(b, make_event(message_type::remove, s, o.id, o.volume, price_of(o.level)));
+		erase(bk, slot);
+	}
+
+	template <typename Emit>
+	void modify_volume(int b, side s, Emit &emit)
+	{
+		const uint32_t slot = pick_order(books_[b], s);
+		if (slot == no_order)
+		{
+			return;
+		}
+		order &o = orders_[slot];
+		o.volume = draw_volume();
+		emit(b, make_event(message_type::modify, s, o.id, o.volume, price_of(o.level)));
+	}
+
+	template <typename Emit>
+	void modify_price(int b, side s, Emit &emit)
+	{
+		book &bk = books_[b];
+		const uint32_t slot = pick_order(bk, s);
+		if (slot == no_order)
+		{
+			return;
+		}
+
+		//taken out first, so that if it's the touch the new level is found without it.
+		//if there's nowhere to go it's put back where it was, time priority and all,
+		//and so it is if it lands on the level it came from, as a book keeps an
+		//order's place when its price doesn't change
+		unlink(bk, slot);
+		order &o = orders_[slot];
+		int level;
+		if (!passive_level(bk, s, level))
+		{
+			relink(bk, slot);
+			return;
+		}
+
+		if (rng_.below(2))
+		{
+			o.volume = draw_volume();
+		}
+		emit(b, make_event(message_type::modify, s, o.id, o.volume, price_of(level)));
+		if (level == o.level)
+		{
+			relink(bk, slot);
+		}
+		else
+		{
+			o.level = level;
+			link(bk, slot);
+		}
+	}
+
+	//an add on the side that crosses to the other side's touch, or up to sweep levels
+	//through it; or a plain add if there's nothing on the other side to trade with. what
+	//isn't filled rests, unless it's a sweep, which is immediate or cancel
+	template <typename Emit>
+	void aggress(int b, side s, int sweep, Emit &emit)
+	{
+		book &bk = books_[b];
+		const side opposite = other(s);
+		const int o = (int)opposite;
+		if (!has_orders(bk, opposite))
+		{
+			add(b, s, emit);
+			return;
+		}
+
+		const int limit = std::max(0, std::min(window_ - 1, s == side::bid ? bk.best[o] + sweep : bk.best[o] - sweep));
+		const int id = next_order_id();
+		const int volume = draw_volume();
+		emit(b, make_event(message_type::add, s, id, volume, price_of(limit)));
+
+		//the trades, then what they did to the orders they filled
+		fills_.clear();
+		int remaining = volume;
+		while (remaining > 0 && has_orders(bk, opposite) && crosses(s, limit, bk.best[o]))
+		{
+			const uint32_t slot = bk.levels[o][bk.best[o]].head;
+			order &resting = orders_[slot];
+			const int filled = std::min(remaining, resting.volume);
+			remaining -= filled;
+			emit(b, make_event(message_type::trade, side::bid, 0, filled, price_of(resting.level)));
+
+			if (filled == resting.volume)
+			{
+				fills_.push_back(make_event(message_type::remove, opposite, resting.id, resting.volume, price_of(resting.level)));
+				erase(bk, slot);
+			}
+			else
+			{
+				resting.volume -= filled;
+				fills_.push_back(make_event(message_type::modify, opposite, resting.id, resting.volume, price_of(resting.level)));
+			}
+		}
+		for (const auto &fill : fills_)
+		{
+			emit(b, fill);
+		}
+
+		if (remaining == 0 || sweep > 0)
+		{
+			emit(b, make_event(message_type::remove, s, id, volume, price_of(limit)));
+		}
+		else
+		{
+			emit(b, make_event(message_type::modify, s, id, remaining, price_of(limit)));
+			insert(bk, s, id, remaining, limit);
+		}
+	}
+
+private: //state
+	const workload_profile profile_;
+	workload_rng rng_;
+	const zipf_table instrument_zipf_;
+	const zipf_table touch_zipf_;
+
+	//the levels each book can have orders on, from low_price_: room for the touch to
+	//wander, and for a burst to sweep it along
+	const int window_;
+	const price_t low_price_;
+
+	std::vector<book> books_;
+	std::vector<std::string> symbols_;
+
+	//every book's resting orders, and the slots that are free
+	std::vector<order> orders_;
+	std::vector<uint32_t> free_;
+	int next_order_id_ = 1;
+
+	//cumulative weights of add, remove, modify volume, modify price and aggress
+	int weights_[5];
+
+	int burst_left_ = 0;
+	int burst_book_ = 0;
+	side burst_side_ = side::bid;
+
+	std::vector<parsed_message> fills_;
+};
+
+#endif
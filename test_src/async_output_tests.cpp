@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+
+#include "../src/spsc_ring.hpp"
+#include "../src/feedhandler.hpp"
+#include "test_feeds.hpp"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	//a feed with some of everything in it: deep levels for the book dumps, trades,
+	//bad lines and lines too long to fit in one record
+	std::vector<std::string> make_feed()
+	{
+		test_feed_options options;
+		options.seed = 11;
+		options.adds = 2;
+		options.bad = 1;
+		options.min_price = 90;
+		options.price_range = 20;
+		options.cents = true;
+		return make_test_feed(options);
+	}
+}
+
+TEST(spsc_ring, fills_and_empties)
+{
+	spsc_ring<int> ring(3);
+	EXPECT_EQ(4u, ring.capacity());
+	EXPECT_EQ(nullptr, ring.front());
+
+	for (int i = 0; i < 4; ++i)
+	{
+		EXPECT_TRUE(ring.try_push(i));
+	}
+	EXPECT_FALSE(ring.try_push(4));
+	EXPECT_EQ(4u, ring.size());
+
+	EXPECT_EQ(0, *ring.front());
+	ring.pop();
+	EXPECT_TRUE(ring.try_push(4));
+	for (int i = 1; i <= 4; ++i)
+	{
+		ASSERT_NE(nullptr, ring.front());
+		EXPECT_EQ(i, *ring.front());
+		ring.pop();
+	}
+	EXPECT_TRUE(ring.empty());
+}
+
+TEST(spsc_ring, passes_items_between_threads_in_order)
+{
+	const int items = 100000;
+	spsc_ring<int> ring(64);
+
+	std::thread consumer([&ring]()
+	{
+		for (int expected = 0; expected < items; )
+		{
+			const int *item = ring.front();
+			if (!item)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			ASSERT_EQ(expected, *item);
+			ring.pop();
+			++expected;
+		}
+	});
+
+	for (int i = 0; i < items; )
+	{
+		if (ring.try_push(i))
+		{
+			++i;
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	consumer.join();
+	EXPECT_TRUE(ring.empty());
+}
+
+TEST(async_output, same_output_as_inline)
+{
+	const auto feed = make_feed();
+	const std::string expected = replay_test_feed(feed, 10, feedhandler_options());
+
+	//a tiny ring so that the producer stalls, and a big one so that it doesn't
+	for (const size_t ring_records : {2u, 1u << 16})
+	{
+		feedhandler_options options;
+		options.async = true;
+		options.async_ring_records = ring_records;
+		const std::string actual = replay_test_feed(feed, 10, options);
+
+		//the async stats follow the rest of the output
+		const size_t stats_at = actual.find("OUTPUT STATS:");
+		ASSERT_NE(std::string::npos, stats_at);
+		EXPECT_EQ(expected, actual.substr(0, stats_at));
+	}
+}
+
+TEST(async_output, reports_backpressure)
+{
+	const auto feed = make_feed();
+
+	std::ostringstream os;
+	feedhandler_options options;
+	options.async = true;
+	options.async_ring_records = 2;
+	{
+		feedhandler fh(10, os, options);
+		for (const auto &line : feed)
+		{
+			fh.process_message(line);
+		}
+		fh.print_stats();
+	}
+
+	const std::string output = os.str();
+	EXPECT_NE(std::string::npos, output.find("  ring capacity: 2\n"));
+	EXPECT_NE(std::string::npos, output.find("  ring high-water mark: 2\n"));
+	EXPECT_EQ(std::string::npos, output.find("  producer stalls: 0\n"));
+}
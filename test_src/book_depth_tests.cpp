@@ -0,0 +1,193 @@
+#include "gtest/gtest.h"
+
+#include "../src/book_depth.hpp"
+#include "../src/feedhandler.hpp"
+#include "../src/orderbook.hpp"
+#include "test_feeds.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//the best levels of a side, the long way round
+	template <typename Book>
+	std::vector<depth_level> walk_levels(const Book &ob, side s, size_t count)
+	{
+		std::vector<depth_level> levels;
+		price_t price;
+		const bool bids = s == side::bid;
+		for (bool more = bids ? ob.bids().best_price(price) : ob.asks().best_price(price);
+				more && levels.size() < count;
+				more = bids ? ob.bids().next_worse(price) : ob.asks().next_worse(price))
+		{
+			depth_level level;
+			level.price = price;
+			level.volume = ob.get_volume(s, price);
+			level.order_count = ob.get_order_count(s, price);
+			levels.push_back(level);
+		}
+		return levels;
+	}
+
+	//adds, modifies and removes on both sides of a book that doesn't cross, over few
+	//enough prices that most of them land near the touch
+	std::vector<std::string> make_book_feed(unsigned seed, int lines)
+	{
+		test_feed_options options;
+		options.seed = seed;
+		options.lines = lines;
+		options.adds = 5;
+		options.modifies = 3;
+		options.removes = 2;
+		options.trades = 0;
+		options.min_price = 90;
+		options.price_range = 20;
+		options.ask_offset = 20;
+		return make_test_feed(options);
+	}
+
+	template <typename Book>
+	void check_depth_follows_the_book()
+	{
+		Book ob;
+		ob.set_depth_levels(5);
+		const std::vector<std::string> feed = make_book_feed(47, 20000);
+		for (size_t i = 0; i < feed.size(); ++i)
+		{
+			apply_test_line(ob, feed[i]);
+			if (i % 7 == 0)
+			{
+				for (const side s : {side::bid, side::ask})
+				{
+					ASSERT_EQ(walk_levels(ob, s, 5), ob.get_depth().side_levels(s)) << i;
+				}
+			}
+		}
+	}
+
+	std::vector<std::string> make_feed()
+	{
+		test_feed_options options;
+		options.seed = 53;
+		return make_test_feed(options);
+	}
+}
+
+TEST(book_depth, follows_the_book)
+{
+	check_depth_follows_the_book<orderbook>();
+	check_depth_follows_the_book<ladder_orderbook>();
+}
+
+TEST(book_depth, changes_away_from_the_touch_are_free)
+{
+	orderbook ob;
+	ob.set_depth_levels(2);
+	ob.on_order_add(side::bid, 1, 100, 10);
+	ob.on_order_add(side::bid, 2, 99, 10);
+	ob.on_order_add(side::bid, 3, 98, 10);
+	ob.get_depth();
+	const size_t refreshes = ob.get_depth().refreshes();
+
+	//deeper than the levels held, so nothing to re-read
+	ob.on_order_add(side::bid, 4, 97, 10);
+	ob.on_order_modify(side::bid, 3, 98, 5);
+	ob.on_order_remove(side::bid, 4);
+	EXPECT_EQ(refreshes, ob.get_depth().refreshes());
+
+	//the second level changing does need one, on that side only
+	ob.on_order_modify(side::bid, 2, 99, 5);
+	EXPECT_EQ(refreshes + 1, ob.get_depth().refreshes());
+	ASSERT_EQ(2u, ob.get_depth().side_levels(side::bid).size());
+	EXPECT_EQ(5, ob.get_depth().side_levels(side::bid)[1].volume);
+
+	//and taking out the touch brings the next level in
+	ob.on_order_remove(side::bid, 1);
+	const auto &bids = ob.get_depth().side_levels(side::bid);
+	ASSERT_EQ(2u, bids.size());
+	EXPECT_EQ(99, bids[0].price);
+	EXPECT_EQ(98, bids[1].price);
+	EXPECT_EQ(5, bids[1].volume);
+}
+
+TEST(book_depth, changes_take_one_snapshot_to_the_next)
+{
+	orderbook ob;
+	ob.set_depth_levels(4);
+	const std::vector<std::string> feed = make_book_feed(59, 5000);
+	std::vector<depth_level> before[2];
+	for (size_t i = 0; i < feed.size(); ++i)
+	{
+		apply_test_line(ob, feed[i]);
+		for (const side s : {side::bid, side::ask})
+		{
+			//apply the changes to the old snapshot, dropping the levels that went
+			const std::vector<depth_level> &after = ob.get_depth().side_levels(s);
+			std::map<price_t, depth_level> applied;
+			for (const auto &level : before[(int)s])
+			{
+				applied[level.price] = level;
+			}
+			price_t last = 0;
+			bool first = true;
+			for_each_depth_change(s, before[(int)s], after, [&](const depth_level &level)
+			{
+				//best first
+				EXPECT_TRUE(first || (s == side::bid ? level.price < last : level.price > last));
+				first = false;
+				last = level.price;
+				if (level.order_count == 0)
+				{
+					applied.erase(level.price);
+				}
+				else
+				{
+					applied[level.price] = level;
+				}
+			});
+
+			std::vector<depth_level> rebuilt;
+			for (const auto &level : applied)
+			{
+				rebuilt.push_back(level.second);
+			}
+			if (s == side::bid)
+			{
+				std::reverse(rebuilt.begin(), rebuilt.end());
+			}
+			ASSERT_EQ(after, rebuilt) << i;
+			before[(int)s] = after;
+		}
+	}
+}
+
+TEST(book_depth, feedhandler_prints_depth)
+{
+	const std::vector<std::string> feed = make_feed();
+
+	feedhandler_options options;
+	options.depth_levels = 3;
+	const std::string snapshots = replay_test_feed(feed, 10, options);
+	EXPECT_NE(std::string::npos, snapshots.find("\n\nDepth:\n"));
+	EXPECT_EQ(std::string::npos, snapshots.find("Current Orderbook"));
+
+	options.depth_updates = true;
+	const std::string updates = replay_test_feed(feed, 10, options);
+	EXPECT_NE(std::string::npos, updates.find("\n\nDepth update:\n"));
+	EXPECT_LT(updates.size(), snapshots.size());
+
+	//the output thread prints the same
+	for (const bool depth_updates : {false, true})
+	{
+		options.depth_updates = depth_updates;
+		options.async = false;
+		const std::string expected = replay_test_feed(feed, 10, options);
+		options.async = true;
+		std::string async = replay_test_feed(feed, 10, options);
+		async.erase(async.find("OUTPUT STATS:"));
+		EXPECT_EQ(expected, async);
+	}
+}
@@ -0,0 +1,202 @@
+#include "gtest/gtest.h"
+
+#include "../src/capture_archive.hpp"
+#include "../src/orderbook.hpp"
+#include "test_feeds.hpp"
+
+#include <climits>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	//records that wander about like a feed's, with the odd one at the limits of
+	//what a record can hold
+	std::vector<capture_record> make_records(size_t count)
+	{
+		static const uint8_t types[] = {'A', 'M', 'X', 'T'};
+
+		std::mt19937 rng(43);
+		std::vector<capture_record> records;
+		for (size_t i = 0; i < count; ++i)
+		{
+			capture_record record;
+			record.type = types[rng() % 4];
+			record.order_side = rng() % 2;
+			record.instrument = rng() % 8 == 0 ? rng() % 3 : (records.empty() ? 0 : records.back().instrument);
+			record.order_id = record.type == 'T' ? 0 : static_cast<int32_t>(i - rng() % 50);
+			record.volume = 1 + rng() % 500;
+			record.reserved = 0;
+			record.price = 10000 + rng() % 200;
+			switch (rng() % 100)
+			{
+			case 0: record.price = INT64_MIN; break;
+			case 1: record.price = INT64_MAX; break;
+			case 2: record.order_id = record.type == 'T' ? 0 : INT32_MIN; break;
+			case 3: record.volume = INT32_MIN; break;
+			case 4: record.instrument = UINT16_MAX; break;
+			}
+			records.push_back(record);
+		}
+		return records;
+	}
+
+	std::vector<std::tuple<side, price_t, int>> book_orders(const orderbook &ob)
+	{
+		std::vector<std::tuple<side, price_t, int>> orders;
+		ob.for_each_order_by_price([&orders](side s, price_t price, int volume)
+		{
+			orders.emplace_back(s, price, volume);
+		});
+		return orders;
+	}
+
+	std::string write_archive(const char *name, const std::vector<capture_record> &records, uint32_t block_records)
+	{
+		const std::string path = temp_path(name);
+		archive_writer writer;
+		EXPECT_TRUE(writer.open(path.c_str(), tick_size(3), block_records));
+		for (const auto &record : records)
+		{
+			writer.add(record);
+		}
+		EXPECT_TRUE(writer.close({"VOD.L", "BARC.L"}));
+		return path;
+	}
+}
+
+TEST(capture_archive, varints)
+{
+	for (const int64_t n : std::vector<int64_t>{INT64_MIN, INT64_MIN + 1, -65, -64, -1, 0, 1, 63, 64, INT64_MAX})
+	{
+		EXPECT_EQ(n, zigzag_decode(zigzag_encode(n)));
+
+		std::vector<uint8_t> bytes;
+		write_varint(bytes, zigzag_encode(n));
+		const uint8_t *p = bytes.data();
+		uint64_t read;
+		ASSERT_TRUE(read_varint(p, bytes.data() + bytes.size(), read));
+		EXPECT_EQ(bytes.data() + bytes.size(), p);
+		EXPECT_EQ(n, zigzag_decode(read));
+
+		//cut short, it's not a varint
+		p = bytes.data();
+		EXPECT_FALSE(read_varint(p, bytes.data() + bytes.size() - 1, read));
+	}
+
+	//small differences take a byte
+	std::vector<uint8_t> bytes;
+	write_varint(bytes, zigzag_encode(-64));
+	EXPECT_EQ(1u, bytes.size());
+}
+
+TEST(capture_archive, round_trip)
+{
+	const std::vector<capture_record> records = make_records(50000);
+	for (const uint32_t block_records : {1u, 1000u, 4096u, 100000u})
+	{
+		const std::string path = write_archive("capture_archive", records, block_records);
+
+		archive_reader reader;
+		ASSERT_TRUE(reader.open(path.c_str()));
+		EXPECT_EQ(3, reader.ticks().decimals());
+		EXPECT_EQ(records.size(), reader.record_count());
+		EXPECT_EQ((records.size() + block_records - 1) / block_records, reader.block_count());
+		ASSERT_EQ(2u, reader.symbol_count());
+		EXPECT_EQ("BARC.L", std::string(reader.symbol(1), reader.symbol_length(1)));
+
+		std::vector<capture_record> decoded;
+		ASSERT_TRUE(reader.for_each_record([&decoded](const capture_record &record)
+		{
+			decoded.push_back(record);
+		}));
+		ASSERT_EQ(records.size(), decoded.size());
+		EXPECT_EQ(0, memcmp(records.data(), decoded.data(), records.size() * sizeof(capture_record))) << block_records;
+
+		//blocks stand alone, so the last decodes by itself
+		size_t last = 0;
+		ASSERT_TRUE(reader.for_each_record(reader.block_count() - 1, [&last](const capture_record &)
+		{
+			++last;
+		}));
+		EXPECT_EQ(records.size() - (reader.block_count() - 1) * block_records, last);
+		remove(path.c_str());
+	}
+}
+
+TEST(capture_archive, smaller_than_a_capture)
+{
+	std::vector<capture_record> records = make_records(50000);
+	for (auto &record : records)
+	{
+		record.price = 10000 + record.order_id % 100;
+		record.instrument = 0;
+	}
+	const std::string path = write_archive("capture_archive_size", records, 4096);
+	archive_reader reader;
+	ASSERT_TRUE(reader.open(path.c_str()));
+	EXPECT_LT(reader.block_bytes(), records.size() * sizeof(capture_record) / 3);
+	remove(path.c_str());
+}
+
+TEST(capture_archive, damaged_blocks_are_refused)
+{
+	const std::vector<capture_record> records = make_records(5000);
+	const std::string path = write_archive("capture_archive_damaged", records, 1000);
+
+	//lose the end of the index, blocks and all
+	ASSERT_EQ(0, truncate(path.c_str(), sizeof(archive_header) + 100));
+	archive_reader reader;
+	EXPECT_FALSE(reader.open(path.c_str()));
+
+	//a block that claims more records than its bytes hold
+	const std::string bad = write_archive("capture_archive_damaged", records, 1000);
+	FILE *f = fopen(bad.c_str(), "r+b");
+	ASSERT_NE(nullptr, f);
+	archive_block_header block;
+	ASSERT_EQ(0, fseek(f, sizeof(archive_header), SEEK_SET));
+	ASSERT_EQ(1u, fread(&block, sizeof(block), 1, f));
+	block.records += 1;
+	ASSERT_EQ(0, fseek(f, sizeof(archive_header), SEEK_SET));
+	ASSERT_EQ(1u, fwrite(&block, sizeof(block), 1, f));
+	fclose(f);
+
+	ASSERT_TRUE(reader.open(bad.c_str()));
+	EXPECT_FALSE(reader.for_each_record(0, [](const capture_record &) {}));
+	EXPECT_TRUE(reader.for_each_record(1, [](const capture_record &) {}));
+	remove(bad.c_str());
+
+	EXPECT_FALSE(reader.open("/nonexistent/feed.fha"));
+}
+
+TEST(capture_archive, feeds_a_book)
+{
+	//a book fed from the archive ends up the same as one fed the records
+	std::vector<capture_record> records = make_records(20000);
+	for (auto &record : records)
+	{
+		record.price = 10000 + record.price % 200;
+		record.volume = 1 + (record.volume & 0xff);
+	}
+	const std::string path = write_archive("capture_archive_book", records, 512);
+
+	orderbook expected;
+	for (const auto &record : records)
+	{
+		apply_capture_record(expected, record);
+	}
+
+	archive_reader reader;
+	ASSERT_TRUE(reader.open(path.c_str()));
+	orderbook replayed;
+	ASSERT_TRUE(reader.for_each_record([&replayed](const capture_record &record)
+	{
+		apply_capture_record(replayed, record);
+	}));
+	EXPECT_EQ(expected.get_current_trade_stats().cumulative_trade_volume, replayed.get_current_trade_stats().cumulative_trade_volume);
+	EXPECT_EQ(book_orders(expected), book_orders(replayed));
+	remove(path.c_str());
+}
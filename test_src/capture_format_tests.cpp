@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+
+#include "../src/capture_replay.hpp"
+#include "test_feeds.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	parsed_message random_message(std::mt19937 &rng, price_t max_price)
+	{
+		parsed_message msg;
+		msg.type = static_cast<message_type>(rng() % 4);
+		msg.order_side = (rng() & 1) ? side::ask : side::bid;
+		msg.order_id = msg.type == message_type::trade ? 0 : static_cast<int>(rng() % 1000);
+		msg.volume = 1 + rng() % 100;
+		msg.price = rng() % max_price;
+		return msg;
+	}
+
+	std::string format(const parsed_message &msg, const std::string &symbol, const tick_size &ticks)
+	{
+		char line[max_capture_line];
+		return std::string(line, format_capture_line(msg, symbol.data(), symbol.size(), ticks, line));
+	}
+}
+
+TEST(capture_format, lines_parse_back_to_the_message)
+{
+	const tick_size two(2);
+	parsed_message msg;
+	msg.type = message_type::add;
+	msg.order_id = 1;
+	msg.order_side = side::ask;
+	msg.volume = 100;
+	msg.price = 1050;
+	EXPECT_EQ("VOD.L,A,1,S,100,10.5", format(msg, "VOD.L", two));
+	msg.type = message_type::trade;
+	msg.price = 1000;
+	EXPECT_EQ("T,100,10", format(msg, "", two));
+	msg.price = -1;
+	EXPECT_EQ("T,100,-0.01", format(msg, "", two));
+
+	std::mt19937 rng(31);
+	for (const int decimals : {0, 2, 9})
+	{
+		const tick_size ticks(decimals);
+		const message_parser parser(ticks);
+		for (int i = 0; i < 10000; ++i)
+		{
+			parsed_message expected = random_message(rng, 1 << 30);
+			if (i % 10 == 0)
+			{
+				expected.price = -expected.price;
+				expected.volume = INT_MIN;
+			}
+
+			const std::string line = format(expected, "", ticks);
+			parsed_message parsed;
+			ASSERT_TRUE(parser.parse(line.data(), line.size(), parsed)) << line;
+			EXPECT_EQ(expected.type, parsed.type) << line;
+			EXPECT_EQ(expected.volume, parsed.volume) << line;
+			EXPECT_EQ(expected.price, parsed.price) << line;
+			if (expected.type != message_type::trade)
+			{
+				EXPECT_EQ(expected.order_side, parsed.order_side) << line;
+				EXPECT_EQ(expected.order_id, parsed.order_id) << line;
+			}
+		}
+	}
+}
+
+TEST(capture_format, write_and_read_back)
+{
+	const std::string path = temp_path("capture_format");
+	const std::vector<std::string> symbols = {"VOD.L", "ABCDEFGHIJKLMNOP"};
+
+	std::mt19937 rng(37);
+	std::vector<capture_record> records;
+	capture_writer writer;
+	ASSERT_TRUE(writer.open(path.c_str(), tick_size(4)));
+	for (int i = 0; i < 200000; ++i)
+	{
+		records.push_back(to_capture_record(random_message(rng, 1000000), rng() % 2));
+		writer.add(records.back());
+	}
+	EXPECT_EQ(records.size(), writer.record_count());
+	ASSERT_TRUE(writer.close(symbols));
+
+	capture_reader reader;
+	ASSERT_TRUE(reader.open(path.c_str()));
+	EXPECT_EQ(4, reader.ticks().decimals());
+	ASSERT_EQ(records.size(), reader.record_count());
+	EXPECT_EQ(0, memcmp(records.data(), reader.records(), records.size() * sizeof(capture_record)));
+	ASSERT_EQ(2u, reader.symbol_count());
+	for (size_t i = 0; i < symbols.size(); ++i)
+	{
+		EXPECT_EQ(symbols[i], std::string(reader.symbol(i), reader.symbol_length(i)));
+	}
+
+	parsed_message msg;
+	ASSERT_TRUE(from_capture_record(records[0], msg));
+	EXPECT_EQ(records[0].price, msg.price);
+	remove(path.c_str());
+}
+
+TEST(capture_format, rejects_what_isnt_a_capture)
+{
+	const std::string path = temp_path("capture_format_bad");
+	capture_reader reader;
+	EXPECT_FALSE(reader.open("/nonexistent/feed.bin"));
+
+	std::ofstream(path) << "A,1,B,100,10.5\n";
+	EXPECT_FALSE(reader.open(path.c_str()));
+
+	//a header claiming more records than the file holds
+	capture_writer writer;
+	ASSERT_TRUE(writer.open(path.c_str(), tick_size(2)));
+	writer.add(capture_record());
+	ASSERT_TRUE(writer.close({}));
+	ASSERT_TRUE(reader.open(path.c_str()));
+	ASSERT_EQ(0, truncate(path.c_str(), sizeof(capture_header) + sizeof(capture_record) - 1));
+	EXPECT_FALSE(reader.open(path.c_str()));
+	remove(path.c_str());
+}
+
+TEST(capture_format, replays_the_same_as_the_feed)
+{
+	//a feed written the way a capture echoes it, so the only difference a replay of
+	//the capture can make is in the parsing
+	std::mt19937 rng(41);
+	const tick_size ticks(2);
+	const std::vector<std::string> symbols = {"VOD.L", "BARC.L", "RIO.L"};
+	const std::string path = temp_path("capture_format_replay");
+	capture_writer writer;
+	ASSERT_TRUE(writer.open(path.c_str(), ticks));
+
+	//instruments are numbered in order of first sighting, as the converter does
+	std::vector<std::string> sighted;
+	std::vector<std::string> feed;
+	for (int i = 0; i < 20000; ++i)
+	{
+		const std::string &symbol = symbols[rng() % symbols.size()];
+		const size_t instrument = std::find(sighted.begin(), sighted.end(), symbol) - sighted.begin();
+		if (instrument == sighted.size())
+		{
+			sighted.push_back(symbol);
+		}
+
+		const parsed_message msg = random_message(rng, 100);
+		feed.push_back(format(msg, symbol, ticks));
+		writer.add(to_capture_record(msg, instrument));
+	}
+	ASSERT_TRUE(writer.close(sighted));
+
+	capture_reader reader;
+	ASSERT_TRUE(reader.open(path.c_str()));
+
+	feedhandler_options options;
+	options.max_instruments = symbols.size();
+
+	std::ostringstream expected;
+	{
+		feedhandler fh(10, expected, options);
+		for (const auto &line : feed)
+		{
+			fh.process_message(line);
+		}
+		fh.print_stats();
+	}
+
+	std::ostringstream replayed;
+	{
+		feedhandler fh(10, replayed, options);
+		EXPECT_TRUE(for_each_capture_message(reader, [&fh](const decoded_message &decoded)
+		{
+			fh.apply_message(decoded);
+		}));
+		fh.print_stats();
+	}
+	EXPECT_EQ(expected.str(), replayed.str());
+	remove(path.c_str());
+}
@@ -0,0 +1,204 @@
+#include "gtest/gtest.h"
+
+#include "../src/book_checkpoint.hpp"
+#include "../src/feedhandler.hpp"
+#include "../src/orderbook.hpp"
+#include "test_feeds.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	//every order in the book, in print order
+	template <typename Book>
+	std::vector<std::tuple<side, price_t, int>> orders_of(const Book &ob)
+	{
+		std::vector<std::tuple<side, price_t, int>> orders;
+		ob.for_each_order_by_price([&orders](side s, price_t price, int volume)
+		{
+			orders.emplace_back(s, price, volume);
+		});
+		return orders;
+	}
+
+	//adds, modifies, removes and trades on a book that crosses now and then
+	std::vector<std::string> make_book_feed()
+	{
+		test_feed_options options;
+		options.seed = 67;
+		options.lines = 40000;
+		options.order_ids = 500;
+		options.adds = 2;
+		options.min_price = 9;
+		options.price_range = 2;
+		options.ask_offset = 1;
+		options.cents = true;
+		return make_test_feed(options);
+	}
+
+	template <typename Book>
+	void check_round_trip()
+	{
+		const std::vector<std::string> feed = make_book_feed();
+		const size_t split = feed.size() / 2;
+		Book ob;
+		for (size_t i = 0; i < split; ++i)
+		{
+			apply_test_line(ob, feed[i]);
+		}
+
+		const std::string path = temp_path("checkpoint_round_trip");
+		checkpoint_builder builder;
+		builder.begin(tick_size(), 1234, checkpoint_offset::bytes);
+		builder.add_book(ob, checkpoint_book());
+		builder.end({});
+		ASSERT_TRUE(write_checkpoint(path.c_str(), builder.image()));
+
+		checkpoint_reader reader;
+		ASSERT_TRUE(reader.open(path.c_str()));
+		remove(path.c_str());
+		EXPECT_EQ(1234u, reader.header().input_offset);
+		ASSERT_EQ(1u, reader.book_count());
+
+		Book restored;
+		ASSERT_TRUE(restore_book(restored, reader, 0));
+		EXPECT_EQ(orders_of(ob), orders_of(restored));
+		EXPECT_EQ(ob.get_midpoint(), restored.get_midpoint());
+		EXPECT_EQ(ob.get_error_stats().total(), restored.get_error_stats().total());
+		EXPECT_EQ(ob.get_error_stats().removes_without_order, restored.get_error_stats().removes_without_order);
+		EXPECT_EQ(ob.get_current_trade_stats().last_trade_price, restored.get_current_trade_stats().last_trade_price);
+		EXPECT_EQ(ob.get_current_trade_stats().cumulative_trade_volume, restored.get_current_trade_stats().cumulative_trade_volume);
+
+		//and the two carry on the same, ids and time priority included
+		for (size_t i = split; i < feed.size(); ++i)
+		{
+			apply_test_line(ob, feed[i]);
+			apply_test_line(restored, feed[i]);
+		}
+		EXPECT_EQ(orders_of(ob), orders_of(restored));
+		EXPECT_EQ(ob.get_error_stats().total(), restored.get_error_stats().total());
+
+		//a book can only be restored into once
+		EXPECT_FALSE(restore_book(restored, reader, 0));
+	}
+
+	std::vector<std::string> make_feed()
+	{
+		test_feed_options options;
+		options.seed = 71;
+		options.lines = 6000;
+		options.symbols = 4;
+		options.order_ids = 300;
+		options.bad = 1;
+		options.min_price = 90;
+		options.price_range = 20;
+		options.ask_offset = 15;
+		return make_test_feed(options);
+	}
+}
+
+TEST(checkpoint, books_round_trip)
+{
+	check_round_trip<orderbook>();
+	check_round_trip<ladder_orderbook>();
+}
+
+TEST(checkpoint, feedhandler_resumes_where_it_left_off)
+{
+	const std::vector<std::string> feed = make_feed();
+	feedhandler_options options;
+	options.max_instruments = 8;
+
+	std::ostringstream full;
+	{
+		feedhandler fh(7, full, options);
+		for (const auto &line : feed)
+		{
+			fh.process_message(line);
+		}
+		fh.print_stats();
+	}
+
+	//checkpoint part way, then carry on in a new feedhandler from the checkpoint
+	const std::string path = temp_path("checkpoint_resume");
+	const size_t split = 3333;
+	std::ostringstream first;
+	{
+		feedhandler fh(7, first, options);
+		for (size_t i = 0; i < split; ++i)
+		{
+			fh.process_message(feed[i]);
+		}
+		ASSERT_TRUE(fh.checkpoint(path.c_str(), split, checkpoint_offset::records));
+		ASSERT_TRUE(fh.wait_for_checkpoint());
+		fh.flush();
+	}
+
+	std::ostringstream second;
+	{
+		feedhandler fh(7, second, options);
+		uint64_t offset = 0;
+		checkpoint_offset offset_kind;
+		ASSERT_TRUE(fh.restore(path.c_str(), offset, offset_kind));
+		EXPECT_EQ(split, offset);
+		EXPECT_EQ(checkpoint_offset::records, offset_kind);
+		for (size_t i = offset; i < feed.size(); ++i)
+		{
+			fh.process_message(feed[i]);
+		}
+		fh.print_stats();
+	}
+	remove(path.c_str());
+
+	//the output, book prints and stats included, is the same as if it had never stopped
+	EXPECT_EQ(full.str(), first.str() + second.str());
+}
+
+TEST(checkpoint, bad_checkpoints_are_refused)
+{
+	const std::string path = temp_path("checkpoint_bad");
+	feedhandler_options options;
+	std::ostringstream os;
+	{
+		feedhandler fh(0, os, options);
+		fh.process_message("A,1,B,10,100");
+		fh.process_message("A,2,S,10,101");
+		ASSERT_TRUE(fh.checkpoint(path.c_str(), 24, checkpoint_offset::bytes));
+	}
+
+	uint64_t offset;
+	checkpoint_offset offset_kind;
+
+	//a feedhandler with other settings
+	options.ticks = tick_size(3);
+	{
+		feedhandler fh(0, os, options);
+		EXPECT_FALSE(fh.restore(path.c_str(), offset, offset_kind));
+	}
+	options.ticks = tick_size();
+	options.max_instruments = 4;
+	{
+		feedhandler fh(0, os, options);
+		EXPECT_FALSE(fh.restore(path.c_str(), offset, offset_kind));
+	}
+
+	//a cut short checkpoint
+	std::string image;
+	{
+		std::ifstream is(path, std::ios::binary);
+		image.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+	}
+	{
+		std::ofstream os(path, std::ios::binary | std::ios::trunc);
+		os.write(image.data(), image.size() - 8);
+	}
+	checkpoint_reader reader;
+	EXPECT_FALSE(reader.open(path.c_str()));
+	remove(path.c_str());
+	EXPECT_FALSE(reader.open(path.c_str()));
+}
@@ -0,0 +1,162 @@
+#include "gtest/gtest.h"
+
+#include "../src/feedhandler.hpp"
+#include "../src/orderbook.hpp"
+#include "test_feeds.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//a book whose bids and asks overlap a little, so the touch moves a lot
+	std::vector<std::string> make_feed()
+	{
+		test_feed_options options;
+		options.seed = 61;
+		options.min_price = 90;
+		options.price_range = 20;
+		options.ask_offset = 15;
+		return make_test_feed(options);
+	}
+
+	//the output without the stats
+	std::string replay(const std::vector<std::string> &feed, const feedhandler_options &options)
+	{
+		return replay_test_feed(feed, 0, options, false);
+	}
+
+	std::vector<std::string> split_lines(const std::string &text)
+	{
+		std::vector<std::string> lines;
+		std::istringstream is(text);
+		std::string line;
+		while (std::getline(is, line))
+		{
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	//the midpoint printed on an add, modify or remove line, or empty for any other line
+	std::string midpoint_of(const std::string &line)
+	{
+		if (line.empty() || line[0] == 'T')
+		{
+			return std::string();
+		}
+		return line.substr(line.rfind(": ") + 2);
+	}
+}
+
+TEST(conflation, book_counts_changes_to_the_touch)
+{
+	orderbook ob;
+	ob.on_order_add(side::bid, 1, 100, 10);
+	ob.on_order_add(side::ask, 2, 110, 10);
+	uint64_t top = ob.get_top_changes();
+	uint64_t midpoint = ob.get_midpoint_changes();
+	EXPECT_EQ(2u, top);
+	EXPECT_EQ(1u, midpoint);
+
+	//away from the touch changes neither
+	ob.on_order_add(side::bid, 3, 99, 10);
+	ob.on_order_add(side::ask, 4, 111, 10);
+	ob.on_order_modify(side::bid, 3, 98, 5);
+	ob.on_order_remove(side::ask, 4);
+	EXPECT_EQ(top, ob.get_top_changes());
+	EXPECT_EQ(midpoint, ob.get_midpoint_changes());
+
+	//volume at the touch changes the top but not the midpoint
+	ob.on_order_add(side::bid, 5, 100, 10);
+	EXPECT_EQ(++top, ob.get_top_changes());
+	ob.on_order_modify(side::ask, 2, 110, 5);
+	EXPECT_EQ(++top, ob.get_top_changes());
+	EXPECT_EQ(midpoint, ob.get_midpoint_changes());
+
+	//a new best price changes both, as does the touch going away
+	ob.on_order_add(side::ask, 6, 109, 10);
+	EXPECT_EQ(++top, ob.get_top_changes());
+	EXPECT_EQ(++midpoint, ob.get_midpoint_changes());
+	ob.on_order_remove(side::ask, 6);
+	EXPECT_EQ(++top, ob.get_top_changes());
+	EXPECT_EQ(++midpoint, ob.get_midpoint_changes());
+
+	//and a rejected message changes nothing
+	ob.on_order_remove(side::ask, 42);
+	EXPECT_EQ(top, ob.get_top_changes());
+	EXPECT_EQ(midpoint, ob.get_midpoint_changes());
+}
+
+TEST(conflation, prints_only_the_changes_it_is_asked_for)
+{
+	const std::vector<std::string> feed = make_feed();
+	const std::vector<std::string> full = split_lines(replay(feed, feedhandler_options()));
+
+	feedhandler_options options;
+	options.conflation = conflation_mode::top;
+	const std::vector<std::string> top = split_lines(replay(feed, options));
+	EXPECT_LT(top.size(), full.size());
+
+	//a midpoint change is a change at the top, so everything a midpoint conflation
+	//prints is what the full output printed when the midpoint moved
+	std::vector<std::string> expected;
+	std::string last = "NAN";
+	for (const auto &line : full)
+	{
+		const std::string midpoint = midpoint_of(line);
+		if (midpoint.empty() || midpoint != last)
+		{
+			expected.push_back(line);
+		}
+		if (!midpoint.empty())
+		{
+			last = midpoint;
+		}
+	}
+	options.conflation = conflation_mode::midpoint;
+	const std::vector<std::string> midpoint = split_lines(replay(feed, options));
+	EXPECT_EQ(expected, midpoint);
+	EXPECT_LT(midpoint.size(), top.size());
+}
+
+TEST(conflation, windows_print_the_latest_change)
+{
+	const std::vector<std::string> feed = make_feed();
+	const std::vector<std::string> full = split_lines(replay(feed, feedhandler_options()));
+
+	feedhandler_options options;
+	options.conflation = conflation_mode::top;
+	options.conflation_window_messages = 50;
+	const std::string windowed = replay(feed, options);
+	size_t midpoints = 0;
+	std::string last;
+	for (const auto &line : split_lines(windowed))
+	{
+		//each is a line of the full output
+		EXPECT_NE(full.end(), std::find(full.begin(), full.end(), line)) << line;
+		if (!midpoint_of(line).empty())
+		{
+			++midpoints;
+			last = line;
+		}
+	}
+	EXPECT_LE(midpoints, feed.size() / 50);
+
+	//and the last window leaves the book as it ended
+	std::string full_last;
+	for (const auto &line : full)
+	{
+		if (!midpoint_of(line).empty())
+		{
+			full_last = midpoint_of(line);
+		}
+	}
+	EXPECT_EQ(full_last, midpoint_of(last));
+
+	//the output thread prints the same
+	options.async = true;
+	EXPECT_EQ(windowed, replay(feed, options));
+}
@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+
+#include "../src/orderbook.hpp"
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	//a window of the smallest size, so that tests can walk off the edge of it easily
+	ladder_levels_options small_window()
+	{
+		ladder_levels_options opts;
+		opts.window_ticks = 64;
+		return opts;
+	}
+
+	std::string printed(const orderbook &ob)
+	{
+		std::ostringstream os;
+		ob.print_ob(os);
+		return os.str();
+	}
+
+	std::string printed(const ladder_orderbook &ob)
+	{
+		std::ostringstream os;
+		ob.print_ob(os);
+		return os.str();
+	}
+}
+
+TEST(ladder_levels, window_and_overflow)
+{
+	ladder_levels<bid_side> bids(small_window());
+	auto no_moves = [](price_level &) {};
+
+	bids.insert(1000, no_moves).order_count = 1;
+	bids.insert(1010, no_moves).order_count = 2;
+	EXPECT_EQ(2, bids.window_size());
+
+	//far below the best bid, so it waits outside the window
+	bids.insert(500, no_moves).order_count = 3;
+	EXPECT_EQ(2, bids.window_size());
+	EXPECT_EQ(3, bids.size());
+
+	price_t price;
+	ASSERT_TRUE(bids.best_price(price));
+	EXPECT_EQ(1010, price);
+	ASSERT_TRUE(bids.next_worse(price));
+	EXPECT_EQ(1000, price);
+	ASSERT_TRUE(bids.next_worse(price));
+	EXPECT_EQ(500, price);
+	EXPECT_FALSE(bids.next_worse(price));
+
+	ASSERT_TRUE(bids.worst_price(price));
+	EXPECT_EQ(500, price);
+	ASSERT_TRUE(bids.next_better(price));
+	EXPECT_EQ(1000, price);
+
+	//emptying the window pulls it over to the best level left
+	bids.erase(1010, no_moves);
+	bids.erase(1000, no_moves);
+	EXPECT_EQ(1, bids.window_size());
+	ASSERT_NE(nullptr, bids.find(500));
+	EXPECT_EQ(3, bids.find(500)->order_count);
+}
+
+TEST(ladder_levels, recentre_on_new_best)
+{
+	ladder_levels<ask_side> asks(small_window());
+	int moves = 0;
+	auto count_moves = [&moves](price_level &) { ++moves; };
+
+	asks.insert(1000, count_moves);
+	asks.insert(1020, count_moves);
+
+	//a much better ask drags the window down and pushes the old levels out
+	asks.insert(100, count_moves);
+	EXPECT_EQ(2, moves);
+	EXPECT_EQ(1, asks.window_size());
+	EXPECT_EQ(3, asks.size());
+
+	price_t price;
+	ASSERT_TRUE(asks.best_price(price));
+	EXPECT_EQ(100, price);
+	ASSERT_TRUE(asks.next_worse(price));
+	EXPECT_EQ(1000, price);
+	ASSERT_TRUE(asks.next_worse(price));
+	EXPECT_EQ(1020, price);
+}
+
+TEST(ladder_orderbook, orders_survive_recentring)
+{
+	ladder_orderbook ob(tick_size(), small_window());
+
+	ob.on_order_add(side::bid, 1, 1000, 10);
+	ob.on_order_add(side::bid, 2, 1000, 20);
+	ob.on_order_add(side::bid, 3, 5000, 30);
+
+	//the first level has been moved out of the window; its orders must still be reachable
+	EXPECT_EQ(5000, ob.get_best_price(side::bid));
+	EXPECT_TRUE(ob.on_order_modify(side::bid, 1, 1000, 15));
+	EXPECT_EQ(35, ob.get_volume(side::bid, 1000));
+
+	EXPECT_TRUE(ob.on_order_remove(side::bid, 3));
+	EXPECT_EQ(1000, ob.get_best_price(side::bid));
+	EXPECT_TRUE(ob.on_order_remove(side::bid, 1));
+	EXPECT_EQ(20, ob.get_volume(side::bid, 1000));
+	EXPECT_EQ(2, ob.get_order_in_position(side::bid, 0)->order_id);
+}
+
+TEST(ladder_orderbook, matches_map_book)
+{
+	//drive both books with the same random stream of events, with prices wandering
+	//well beyond the window, and check they always agree
+	orderbook expected;
+	ladder_orderbook actual(tick_size(), small_window());
+
+	std::mt19937 rng(42);
+	std::vector<std::pair<side, int>> live;
+	price_t centre = 10000;
+	int next_id = 0;
+	for (int i = 0; i < 20000; ++i)
+	{
+		centre += std::uniform_int_distribution<int>(-3, 3)(rng);
+		const price_t price = centre + std::uniform_int_distribution<int>(-200, 200)(rng);
+		const int volume = std::uniform_int_distribution<int>(0, 50)(rng);
+		const int action = std::uniform_int_distribution<int>(0, 9)(rng);
+
+		if (live.empty() || action < 5)
+		{
+			const side s = price < centre ? side::bid : side::ask;
+			live.emplace_back(s, next_id);
+			EXPECT_EQ(expected.on_order_add(s, next_id, price, volume + 1), actual.on_order_add(s, next_id, price, volume + 1));
+			++next_id;
+			continue;
+		}
+
+		const size_t which = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+		const auto order = live[which];
+		if (action < 8)
+		{
+			EXPECT_EQ(expected.on_order_modify(order.first, order.second, price, volume),
+					actual.on_order_modify(order.first, order.second, price, volume));
+			if (volume != 0)
+			{
+				continue;
+			}
+		}
+		else
+		{
+			EXPECT_EQ(expected.on_order_remove(order.first, order.second), actual.on_order_remove(order.first, order.second));
+		}
+		live[which] = live.back();
+		live.pop_back();
+
+		ASSERT_EQ(expected.get_best_price(side::bid), actual.get_best_price(side::bid));
+		ASSERT_EQ(expected.get_best_price(side::ask), actual.get_best_price(side::ask));
+		ASSERT_EQ(expected.get_level_count_on_side(side::bid), actual.get_level_count_on_side(side::bid));
+		ASSERT_EQ(expected.get_level_count_on_side(side::ask), actual.get_level_count_on_side(side::ask));
+	}
+
+	EXPECT_EQ(printed(expected), printed(actual));
+	for (unsigned position = 0; position < (unsigned)expected.get_order_count_on_side(side::ask); ++position)
+	{
+		ASSERT_EQ(expected.get_order_in_position(side::ask, position)->order_id,
+				actual.get_order_in_position(side::ask, position)->order_id);
+	}
+}
@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+
+#include "../src/latency_histogram.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+TEST(latency_histogram, buckets_cover_every_value_once)
+{
+	//each bucket starts where the last one ended
+	for (size_t bucket = 1; bucket < latency_histogram::bucket_count; ++bucket)
+	{
+		ASSERT_EQ(latency_histogram::highest_in(bucket - 1) + 1, latency_histogram::lowest_in(bucket)) << bucket;
+	}
+
+	//and values in range land in the bucket that covers them, to within 1/32 of themselves
+	std::mt19937_64 rng(73);
+	for (int i = 0; i < 100000; ++i)
+	{
+		const uint64_t value = rng() >> (24 + rng() % 40);
+		const size_t bucket = latency_histogram::bucket_of(value);
+		ASSERT_LT(bucket, latency_histogram::bucket_count);
+		EXPECT_LE(latency_histogram::lowest_in(bucket), value);
+		EXPECT_GE(latency_histogram::highest_in(bucket), value);
+		EXPECT_LE(latency_histogram::highest_in(bucket) - latency_histogram::lowest_in(bucket), value / latency_histogram::sub_buckets);
+	}
+
+	//anything too big goes in the last
+	EXPECT_EQ(latency_histogram::bucket_count - 1, latency_histogram::bucket_of(UINT64_MAX));
+}
+
+TEST(latency_histogram, percentiles_are_close_to_exact)
+{
+	std::mt19937_64 rng(79);
+	std::lognormal_distribution<double> latency(5.0, 1.0);
+	latency_histogram histogram;
+	std::vector<uint64_t> values;
+	for (int i = 0; i < 200000; ++i)
+	{
+		values.push_back((uint64_t)latency(rng));
+		histogram.record(values.back());
+	}
+	std::sort(values.begin(), values.end());
+
+	EXPECT_EQ(values.size(), histogram.count());
+	EXPECT_EQ(values.back(), histogram.max());
+	for (const double quantile : {0.5, 0.9, 0.99, 0.999})
+	{
+		const uint64_t exact = values[(size_t)(quantile * values.size()) - 1];
+		const uint64_t reported = histogram.value_at(quantile);
+		EXPECT_GE(reported, exact) << quantile;
+		EXPECT_LE(reported, exact + exact / latency_histogram::sub_buckets + 1) << quantile;
+	}
+	EXPECT_EQ(values.back(), histogram.value_at(1.0));
+	EXPECT_EQ(0u, latency_histogram().value_at(0.5));
+}
+
+TEST(latency_histogram, merges)
+{
+	latency_histogram low, high, both;
+	for (uint64_t value = 1; value <= 1000; ++value)
+	{
+		low.record(value);
+		high.record(value + 1000);
+		both.record(value);
+		both.record(value + 1000);
+	}
+	low += high;
+	EXPECT_EQ(both.count(), low.count());
+	EXPECT_EQ(both.max(), low.max());
+	for (const double quantile : {0.25, 0.5, 0.75, 0.99})
+	{
+		EXPECT_EQ(both.value_at(quantile), low.value_at(quantile));
+	}
+}
+
+TEST(latency_histogram, tsc_moves_forward)
+{
+	const uint64_t start = read_tsc();
+	EXPECT_GT(tsc_ticks_per_ns(), 0.0);
+	EXPECT_LT(start, read_tsc());
+}
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+
+#include "../src/feedhandler.hpp"
+#include "../src/live_metrics.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+TEST(live_metrics, reader_sees_what_writer_publishes)
+{
+	const std::string name = "feedhandler_test_" + std::to_string(getpid());
+	live_metrics_writer writer;
+	ASSERT_TRUE(writer.open(name.c_str(), 2));
+
+	live_metrics_reader reader;
+	ASSERT_TRUE(reader.open(name.c_str()));
+	EXPECT_EQ(getpid(), reader.header().pid);
+	ASSERT_EQ(2u, reader.slot_count());
+	EXPECT_EQ(0u, reader.total().messages);
+
+	live_metrics_snapshot first;
+	first.messages = 10;
+	first.bid_orders = 3;
+	first.duplicate_order_ids = 1;
+	writer.slot(0)->publish(first);
+
+	live_metrics_snapshot second;
+	second.messages = 5;
+	second.invalid_inputs = 2;
+	writer.slot(1)->publish(second);
+	writer.slot(1)->publish(second);
+
+	EXPECT_EQ(10u, reader.slot(0).messages);
+	EXPECT_EQ(1u, reader.slot(0).publishes);
+	EXPECT_EQ(2u, reader.slot(1).publishes);
+
+	const live_metrics_snapshot total = reader.total();
+	EXPECT_EQ(15u, total.messages);
+	EXPECT_EQ(3u, total.bid_orders);
+	EXPECT_EQ(3u, total.book_errors());
+
+	//gone once the writer is done with it
+	writer.close();
+	live_metrics_reader late;
+	EXPECT_FALSE(late.open(name.c_str()));
+}
+
+TEST(live_metrics, feedhandler_publishes_every_so_many_messages_and_on_flush)
+{
+	live_metrics_slot slot = {};
+	feedhandler_options options;
+	options.live_metrics = &slot;
+	options.live_metrics_messages = 3;
+
+	std::ostringstream os;
+	feedhandler fh(0, os, options);
+	fh.process_message("A,1,B,10,100");
+	fh.process_message("A,2,S,5,110");
+	EXPECT_EQ(0u, slot.load().publishes);
+
+	fh.process_message("not a message");
+	live_metrics_snapshot published = slot.load();
+	EXPECT_EQ(1u, published.publishes);
+	EXPECT_EQ(3u, published.messages);
+	EXPECT_EQ(1u, published.unparsable);
+	EXPECT_EQ(1u, published.bid_orders);
+	EXPECT_EQ(1u, published.ask_orders);
+
+	fh.process_message("A,1,B,10,100");
+	EXPECT_EQ(1u, slot.load().publishes);
+	fh.flush();
+	published = slot.load();
+	EXPECT_EQ(2u, published.publishes);
+	EXPECT_EQ(4u, published.messages);
+	EXPECT_EQ(1u, published.duplicate_order_ids);
+	EXPECT_EQ(1u, published.book_errors());
+}
@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+
+#include "../src/message_parser.hpp"
+
+#include <string>
+
+namespace
+{
+	bool parse(const std::string &line, parsed_message &msg, tick_size ticks = tick_size())
+	{
+		return message_parser(ticks).parse(line.data(), line.size(), msg);
+	}
+
+	bool parses(const std::string &line)
+	{
+		parsed_message msg;
+		return parse(line, msg);
+	}
+}
+
+TEST(message_parser, order_actions)
+{
+	parsed_message msg;
+	EXPECT_TRUE(parse("A,100000,S,1,1075", msg));
+	EXPECT_EQ(message_type::add, msg.type);
+	EXPECT_EQ(100000, msg.order_id);
+	EXPECT_EQ(side::ask, msg.order_side);
+	EXPECT_EQ(1, msg.volume);
+	EXPECT_EQ(107500, msg.price);
+
+	EXPECT_TRUE(parse("M,7,B,250,1.23", msg));
+	EXPECT_EQ(message_type::modify, msg.type);
+	EXPECT_EQ(7, msg.order_id);
+	EXPECT_EQ(side::bid, msg.order_side);
+	EXPECT_EQ(250, msg.volume);
+	EXPECT_EQ(123, msg.price);
+
+	EXPECT_TRUE(parse("X,8,S,3,0.5", msg));
+	EXPECT_EQ(message_type::remove, msg.type);
+	EXPECT_EQ(8, msg.order_id);
+	EXPECT_EQ(50, msg.price);
+}
+
+TEST(message_parser, trades)
+{
+	parsed_message msg;
+	EXPECT_TRUE(parse("T,2,1025", msg));
+	EXPECT_EQ(message_type::trade, msg.type);
+	EXPECT_EQ(2, msg.volume);
+	EXPECT_EQ(102500, msg.price);
+
+	//trade lines can't carry order fields and order lines can't be trades
+	EXPECT_FALSE(parses("T,1,B,2,3"));
+	EXPECT_FALSE(parses("A,5,100"));
+}
+
+TEST(message_parser, number_formats)
+{
+	parsed_message msg;
+
+	//whitespace and signs are accepted before numbers, as sscanf did
+	EXPECT_TRUE(parse("A, 1,B,\t2, -3.5", msg));
+	EXPECT_EQ(1, msg.order_id);
+	EXPECT_EQ(2, msg.volume);
+	EXPECT_EQ(-350, msg.price);
+
+	EXPECT_TRUE(parse("A,+1,B,-2,.25", msg));
+	EXPECT_EQ(-2, msg.volume);
+	EXPECT_EQ(25, msg.price);
+
+	EXPECT_TRUE(parse("A,1,B,2,5.", msg));
+	EXPECT_EQ(500, msg.price);
+
+	EXPECT_TRUE(parse("A,1,B,2,1.5e2", msg));
+	EXPECT_EQ(15000, msg.price);
+
+	EXPECT_FALSE(parses("A,1,B,2,."));
+	EXPECT_FALSE(parses("A,1,B,,3"));
+	EXPECT_FALSE(parses("A,2147483648,B,2,3"));
+	EXPECT_FALSE(parses("A,1,B,2,nan"));
+}
+
+TEST(message_parser, ticks)
+{
+	parsed_message msg;
+
+	//trailing zeros below the tick are fine, anything else is off the price grid
+	EXPECT_TRUE(parse("A,1,B,2,1.2300", msg));
+	EXPECT_EQ(123, msg.price);
+	EXPECT_FALSE(parses("A,1,B,2,1.234"));
+	EXPECT_FALSE(parses("A,1,B,2,0.30000000000000004441"));
+
+	EXPECT_TRUE(parse("A,1,B,2,1.234", msg, tick_size(3)));
+	EXPECT_EQ(1234, msg.price);
+
+	EXPECT_TRUE(parse("T,1,12", msg, tick_size(0)));
+	EXPECT_EQ(12, msg.price);
+	EXPECT_TRUE(parse("T,1,1.2e1", msg, tick_size(0)));
+	EXPECT_EQ(12, msg.price);
+
+	//prices that don't fit in a tick count are rejected rather than wrapped
+	EXPECT_FALSE(parses("A,1,B,2,1e17"));
+	EXPECT_FALSE(parses("A,1,B,2,123456789012345678901"));
+}
+
+TEST(message_parser, malformed_lines)
+{
+	EXPECT_FALSE(parses(""));
+	EXPECT_FALSE(parses("Z,1,B,2,3"));
+	EXPECT_FALSE(parses("A,1,b,2,3"));
+	EXPECT_FALSE(parses("A,1, B,2,3"));
+	EXPECT_FALSE(parses("A,1,B,2"));
+
+	//anything trailing the price makes the line unparsable
+	EXPECT_FALSE(parses("A,1,B,2,3 "));
+	EXPECT_FALSE(parses("A,1,B,2,3,"));
+	EXPECT_FALSE(parses("A,1,B,2,3\r"));
+	EXPECT_FALSE(parses("T,1,2x"));
+}
@@ -0,0 +1,187 @@
+#include "gtest/gtest.h"
+
+#include "../src/symbol_directory.hpp"
+#include "../src/feedhandler.hpp"
+#include "test_feeds.hpp"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+	std::string replay(const std::vector<std::string> &feed, const feedhandler_options &options)
+	{
+		return replay_test_feed(feed, 3, options);
+	}
+}
+
+TEST(symbol_directory, interns_in_order_of_first_sighting)
+{
+	symbol_directory symbols(3);
+
+	EXPECT_EQ(0, symbols.find_or_add("VOD.L", 5));
+	EXPECT_EQ(1, symbols.find_or_add("BARC.L", 6));
+	EXPECT_EQ(0, symbols.find_or_add("VOD.L", 5));
+	EXPECT_EQ(1, symbols.find_or_add("BARC.Lxxx", 6));
+
+	//symbols that share a prefix, or are the longest allowed, are still distinct
+	EXPECT_EQ(2, symbols.find_or_add("BARC", 4));
+	EXPECT_EQ(2, symbols.find_or_add("BARC", 4));
+	EXPECT_EQ("BARC.L", symbols.name(1));
+
+	//full, so nothing new gets in, but the ones we have are still found
+	EXPECT_EQ(-1, symbols.find_or_add("RIO.L", 5));
+	EXPECT_EQ(0, symbols.find_or_add("VOD.L", 5));
+	EXPECT_EQ(3u, symbols.size());
+
+	EXPECT_EQ(-1, symbols.find_or_add("", 0));
+	EXPECT_EQ(-1, symbols.find_or_add("ABCDEFGHIJKLMNOPQ", symbol_directory::max_symbol_length + 1));
+}
+
+TEST(symbol_directory, find_does_not_add)
+{
+	symbol_directory symbols(2);
+
+	EXPECT_EQ(-1, symbols.find("VOD.L", 5));
+	EXPECT_EQ(0u, symbols.size());
+	EXPECT_EQ(0, symbols.find_or_add("BARC.L", 6));
+	EXPECT_EQ(-1, symbols.find("VOD.L", 5));
+	EXPECT_EQ(1, symbols.find_or_add("VOD.L", 5));
+	EXPECT_EQ(1, symbols.find("VOD.L", 5));
+	EXPECT_EQ(0, symbols.find("BARC.L", 6));
+}
+
+TEST(symbol_directory, many_symbols)
+{
+	symbol_directory symbols(1000);
+	for (int i = 0; i < 1000; ++i)
+	{
+		const std::string symbol = "SYM" + std::to_string(i * 7919);
+		ASSERT_EQ(i, symbols.find_or_add(symbol.data(), symbol.size()));
+	}
+	for (int i = 999; i >= 0; --i)
+	{
+		const std::string symbol = "SYM" + std::to_string(i * 7919);
+		ASSERT_EQ(i, symbols.find_or_add(symbol.data(), symbol.size()));
+	}
+}
+
+TEST(multi_instrument, books_are_kept_apart)
+{
+	//the same order ids and prices on each instrument, interleaved
+	const std::vector<std::string> feed = {
+		"AAA,A,1,B,100,10",
+		"BBB,A,1,B,50,20",
+		"AAA,A,2,S,100,11",
+		"BBB,A,2,S,50,22",
+		"AAA,T,10,10.5",
+		"CCC,X,1,B,100,10",
+		"BBB,M,1,B,40,21",
+		"no symbol",
+		"AAA,garbage",
+	};
+
+	feedhandler_options options;
+	options.max_instruments = 2;
+	const std::string output = replay(feed, options);
+
+	EXPECT_NE(std::string::npos, output.find("AAA,A,2,S,100,11: 10.5\n"));
+	EXPECT_NE(std::string::npos, output.find("BBB,A,2,S,50,22: 21\n"));
+	EXPECT_NE(std::string::npos, output.find("BBB,M,1,B,40,21: 21.5\n"));
+
+	//every third message prints the book it was for
+	EXPECT_NE(std::string::npos, output.find("AAA,A,2,S,100,11: 10.5\n\n\nCurrent Orderbook AAA:\n\n11 S 100\n10 B 100\n\n"));
+	EXPECT_NE(std::string::npos, output.find("CCC,X,1,B,100,10:  UNPARSABLE\n"));
+	EXPECT_NE(std::string::npos, output.find("no symbol:  UNPARSABLE\n"));
+
+	EXPECT_NE(std::string::npos, output.find("  unparseable: 3\n"));
+	EXPECT_NE(std::string::npos, output.find("  trades without order: 1\n"));
+	EXPECT_NE(std::string::npos, output.find("  instruments: 2 of 2\n"));
+	EXPECT_NE(std::string::npos, output.find("  unknown or over capacity: 2\n"));
+	EXPECT_NE(std::string::npos, output.find("  AAA: messages 3, unparseable 1, trades 0 (volume 0), orders 1 bid 1 ask, errors 1\n"));
+	EXPECT_NE(std::string::npos, output.find("  BBB: messages 3, unparseable 0, trades 0 (volume 0), orders 1 bid 1 ask, errors 0\n"));
+}
+
+TEST(multi_instrument, unparsable_lines_take_no_instrument)
+{
+	//a bad line's first field isn't a symbol, so it mustn't use up a slot that a
+	//good line then needs
+	const std::vector<std::string> feed = {
+		"garbage1,foo",
+		"AAA,A,1,B,100,10",
+		"BBB,A,1,S,100,11",
+		"AAA,junk",
+		"CCC,A,3,B,1,99",
+		"DDD,A,4,B,1,99",
+	};
+
+	feedhandler_options options;
+	options.max_instruments = 3;
+	const std::string output = replay(feed, options);
+
+	EXPECT_NE(std::string::npos, output.find("garbage1,foo:  UNPARSABLE\n"));
+	EXPECT_NE(std::string::npos, output.find("CCC,A,3,B,1,99: "));
+	EXPECT_EQ(std::string::npos, output.find("CCC,A,3,B,1,99:  UNPARSABLE\n"));
+	EXPECT_NE(std::string::npos, output.find("DDD,A,4,B,1,99:  UNPARSABLE\n"));
+
+	EXPECT_NE(std::string::npos, output.find("  unparseable: 3\n"));
+	EXPECT_NE(std::string::npos, output.find("  instruments: 3 of 3\n"));
+	EXPECT_NE(std::string::npos, output.find("  unknown or over capacity: 1\n"));
+	EXPECT_NE(std::string::npos, output.find("  AAA: messages 1, unparseable 1,"));
+	EXPECT_NE(std::string::npos, output.find("  CCC: messages 1, unparseable 0,"));
+	EXPECT_EQ(std::string::npos, output.find("garbage1:"));
+}
+
+TEST(multi_instrument, one_instrument_matches_plain_feed)
+{
+	//a feed with a single symbol gives the same output as the plain feed, bar the
+	//symbols and the instrument stats
+	const std::vector<std::string> plain = {
+		"A,1,B,100,10",
+		"A,2,S,100,11",
+		"A,3,S,50,10",
+		"T,50,10",
+		"X,3,S,50,10",
+		"M,1,B,80,10.5",
+		"A,4,B,20,10.5",
+	};
+	std::vector<std::string> prefixed;
+	for (const auto &line : plain)
+	{
+		prefixed.push_back("XYZ," + line);
+	}
+
+	feedhandler_options options;
+	std::string expected = replay(plain, options);
+
+	options.max_instruments = 4;
+	std::string actual = replay(prefixed, options);
+	actual = actual.substr(0, actual.find("INSTRUMENT STATS:"));
+	for (size_t at; (at = actual.find("XYZ,")) != std::string::npos; )
+	{
+		actual.erase(at, 4);
+	}
+	for (size_t at; (at = actual.find("Orderbook XYZ:")) != std::string::npos; )
+	{
+		actual.replace(at, 14, "Orderbook:");
+	}
+	EXPECT_EQ(expected, actual);
+}
+
+TEST(multi_instrument, async_output_names_the_book)
+{
+	const std::vector<std::string> feed = {
+		"AAA,A,1,B,100,10",
+		"BBB,A,1,B,50,20",
+		"LONGERSYMBOL.XY,A,2,S,100,11",
+	};
+
+	feedhandler_options options;
+	options.max_instruments = 8;
+	const std::string expected = replay(feed, options);
+
+	options.async = true;
+	const std::string actual = replay(feed, options);
+	EXPECT_EQ(expected, actual.substr(0, actual.find("OUTPUT STATS:")));
+	EXPECT_NE(std::string::npos, actual.find("Current Orderbook LONGERSYMBOL.XY:\n"));
+}
@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+
+#include "../src/node_pool.hpp"
+#include "../src/orderbook.hpp"
+
+namespace
+{
+	node_pool_options pool_of(size_t bytes)
+	{
+		node_pool_options opts;
+		opts.capacity_bytes = bytes;
+		return opts;
+	}
+
+	//add and remove a batch of orders spread over a few hundred ticks
+	template <typename Book>
+	void churn(Book &ob, int first_id, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			const side s = (i & 1) ? side::bid : side::ask;
+			const price_t price = s == side::bid ? 1000 - (i * 7) % 300 : 1001 + (i * 11) % 300;
+			ob.on_order_add(s, first_id + i, price, 10);
+		}
+		for (int i = 0; i < count; i += 2)
+		{
+			ob.on_order_modify(side::ask, first_id + i, 1500 + i % 50, 5);
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			ob.on_order_remove((i & 1) ? side::bid : side::ask, first_id + i);
+		}
+	}
+
+	template <typename Book>
+	void check_steady_state(order_index_kind kind)
+	{
+		order_index_options index;
+		index.kind = kind;
+		Book ob(tick_size(), typename Book::level_options(), node_pool_options(), index);
+
+		//warm up, so the pool and the index have seen the most orders they'll hold
+		//(and the direct index has had a run of ids straddle two of its pages)
+		for (int round = 0; round < 3; ++round)
+		{
+			churn(ob, round * 2000, 2000);
+		}
+
+		//every node comes from the pool and the index only allocates to grow, so
+		//if neither has gone to the heap the book has left it alone
+		const uint64_t pool_before = ob.get_node_pool().heap_allocations();
+		const size_t index_before = ob.get_order_index_capacity();
+		for (int round = 3; round < 13; ++round)
+		{
+			churn(ob, round * 2000, 2000);
+		}
+
+		EXPECT_EQ(0, ob.get_order_count_on_side(side::bid));
+		EXPECT_EQ(pool_before, ob.get_node_pool().heap_allocations());
+		EXPECT_EQ(index_before, ob.get_order_index_capacity());
+	}
+}
+
+TEST(node_pool, reuses_freed_nodes)
+{
+	node_pool pool(pool_of(4096));
+
+	void *first = pool.allocate(40);
+	const size_t used = pool.used();
+	pool.deallocate(first, 40);
+
+	//same size class, so the freed node comes straight back
+	EXPECT_EQ(first, pool.allocate(48));
+	EXPECT_EQ(used, pool.used());
+
+	//a different size class gets fresh memory
+	EXPECT_NE(first, pool.allocate(64));
+	EXPECT_EQ(0u, pool.heap_allocations());
+}
+
+TEST(node_pool, overflows_to_heap)
+{
+	node_pool pool(pool_of(64));
+
+	void *nodes[4];
+	for (auto &node : nodes)
+	{
+		node = pool.allocate(16);
+	}
+	EXPECT_EQ(64u, pool.used());
+	EXPECT_EQ(0u, pool.heap_allocations());
+
+	//the arena's full, and big requests never fit a size class
+	void *spilled = pool.allocate(16);
+	void *big = pool.allocate(node_pool::max_node_size + 1);
+	EXPECT_EQ(2u, pool.heap_allocations());
+
+	pool.deallocate(spilled, 16);
+	pool.deallocate(big, node_pool::max_node_size + 1);
+	for (auto node : nodes)
+	{
+		pool.deallocate(node, 16);
+	}
+	EXPECT_EQ(nodes[3], pool.allocate(16));
+}
+
+TEST(node_pool, no_pool)
+{
+	node_pool pool(pool_of(0));
+	EXPECT_EQ(0u, pool.capacity());
+
+	void *node = pool.allocate(16);
+	EXPECT_EQ(1u, pool.heap_allocations());
+	pool.deallocate(node, 16);
+}
+
+TEST(node_pool, hugepages_fall_back)
+{
+	node_pool_options opts = pool_of(1 << 20);
+	opts.hugepages = true;
+	node_pool pool(opts);
+
+	//whether or not the system has huge pages reserved we should get an arena
+	EXPECT_GE(pool.capacity(), 1u << 20);
+	void *node = pool.allocate(16);
+	pool.deallocate(node, 16);
+	EXPECT_EQ(0u, pool.heap_allocations());
+}
+
+TEST(node_pool, no_allocations_after_warm_up)
+{
+	check_steady_state<orderbook>(order_index_kind::hashed);
+	check_steady_state<ladder_orderbook>(order_index_kind::hashed);
+
+	//ids keep counting up, so this also checks that the direct index recycles its pages
+	check_steady_state<orderbook>(order_index_kind::direct);
+	check_steady_state<ladder_orderbook>(order_index_kind::direct);
+}
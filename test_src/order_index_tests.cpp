@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+
+#include "../src/order_index.hpp"
+#include "../src/orderbook.hpp"
+
+#include <climits>
+#include <map>
+#include <random>
+
+namespace
+{
+	//drive an index and a std::map with the same random inserts and erases
+	template <typename Index>
+	void check_against_map(Index &index, int max_key, int steps)
+	{
+		std::map<int, int> expected;
+		std::mt19937 rng(3);
+		std::uniform_int_distribution<int> key_of(0, max_key);
+		for (int i = 0; i < steps; ++i)
+		{
+			const int key = key_of(rng);
+			if (rng() & 1)
+			{
+				int *value = index.insert(key);
+				const bool inserted = expected.emplace(key, i).second;
+				ASSERT_EQ(inserted, value != nullptr);
+				if (value)
+				{
+					*value = i;
+				}
+			}
+			else
+			{
+				index.erase(key);
+				expected.erase(key);
+			}
+			ASSERT_EQ(expected.size(), index.size());
+		}
+
+		for (int key = 0; key <= max_key; ++key)
+		{
+			const auto iter = expected.find(key);
+			const int *value = index.find(key);
+			ASSERT_EQ(iter != expected.end(), value != nullptr);
+			if (value)
+			{
+				EXPECT_EQ(iter->second, *value);
+			}
+		}
+	}
+}
+
+TEST(order_index, hashed_basics)
+{
+	hashed_order_index<int> index;
+
+	*index.insert(5) = 50;
+	*index.insert(6) = 60;
+	EXPECT_EQ(nullptr, index.insert(5));
+	EXPECT_EQ(50, *index.find(5));
+	EXPECT_EQ(nullptr, index.find(7));
+
+	index.erase(5);
+	EXPECT_EQ(nullptr, index.find(5));
+	EXPECT_EQ(60, *index.find(6));
+	EXPECT_EQ(1u, index.size());
+
+	//erasing something that isn't there is harmless
+	index.erase(5);
+	EXPECT_EQ(1u, index.size());
+}
+
+TEST(order_index, hashed_probe_runs)
+{
+	//lots of churn through long, wrapping probe runs, and through the table growing,
+	//with erases closing the gaps behind them
+	hashed_order_index<int> index;
+	check_against_map(index, 500, 20000);
+}
+
+TEST(order_index, paged_basics)
+{
+	paged_order_index<int> index;
+
+	*index.insert(0) = 1;
+	*index.insert(INT_MAX) = 2;
+	EXPECT_EQ(nullptr, index.insert(0));
+	EXPECT_EQ(1, *index.find(0));
+	EXPECT_EQ(2, *index.find(INT_MAX));
+	EXPECT_EQ(nullptr, index.find(1));
+	EXPECT_EQ(nullptr, index.find(1 << 20));
+
+	index.erase(0);
+	EXPECT_EQ(nullptr, index.find(0));
+
+	//the page freed by the erase is reused for the next one needed
+	EXPECT_EQ(2 * paged_order_index<int>::page_size, index.capacity());
+	*index.insert(1 << 20) = 3;
+	EXPECT_EQ(3, *index.find(1 << 20));
+	EXPECT_EQ(2u, index.size());
+	EXPECT_EQ(2 * paged_order_index<int>::page_size, index.capacity());
+}
+
+TEST(order_index, paged_churn)
+{
+	paged_order_index<int> index;
+	check_against_map(index, 3 * paged_order_index<int>::page_size, 20000);
+}
+
+TEST(order_index, book_with_either_index)
+{
+	for (const auto kind : {order_index_kind::hashed, order_index_kind::direct})
+	{
+		order_index_options opts;
+		opts.kind = kind;
+		orderbook ob(tick_size(), orderbook::level_options(), node_pool_options(), opts);
+
+		EXPECT_TRUE(ob.on_order_add(side::bid, 1, 100, 10));
+		EXPECT_TRUE(ob.on_order_add(side::ask, 2, 110, 20));
+		EXPECT_FALSE(ob.on_order_add(side::ask, 1, 120, 30));
+		EXPECT_EQ(1, ob.get_error_stats().duplicate_order_ids);
+
+		EXPECT_TRUE(ob.on_order_modify(side::bid, 1, 105, 15));
+		EXPECT_EQ(105, ob.get_best_price(side::bid));
+		EXPECT_FALSE(ob.on_order_remove(side::bid, 2));
+		EXPECT_TRUE(ob.on_order_remove(side::ask, 2));
+		EXPECT_FALSE(ob.on_order_modify(side::ask, 2, 110, 5));
+		EXPECT_EQ(0, ob.get_order_count_on_side(side::ask));
+	}
+}
@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+
+#include "../src/output_sink.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <sstream>
+
+TEST(output_sink, formats_like_ostream)
+{
+	std::ostringstream expected;
+	std::ostringstream actual;
+	{
+		output_sink out(actual);
+
+		const double doubles[] = {0, 1, -1, 0.5, 1.005, 107.25, 1234567, 12345678, 0.0001, 0.00001,
+				1e-300, 1e300, 123.456789, std::numeric_limits<double>::max(), -std::numeric_limits<double>::min()};
+		for (const double value : doubles)
+		{
+			expected << value << '\n';
+			out << value << '\n';
+		}
+
+		std::mt19937_64 rng(5);
+		for (int i = 0; i < 1000; ++i)
+		{
+			const double value = static_cast<int64_t>(rng() % 100000000) / 100.0;
+			expected << value << ' ' << value * 0.5 << '\n';
+			out << value << ' ' << value * 0.5 << '\n';
+		}
+
+		expected << 0 << std::numeric_limits<int>::min() << std::numeric_limits<uint64_t>::max() << "@" << -5L;
+		out << 0 << std::numeric_limits<int>::min() << std::numeric_limits<uint64_t>::max() << "@" << -5L;
+	}
+	EXPECT_EQ(expected.str(), actual.str());
+}
+
+TEST(output_sink, buffers_until_flushed)
+{
+	std::ostringstream os;
+	output_sink out(os, 64);
+
+	out << "hello " << 42;
+	EXPECT_EQ("", os.str());
+	EXPECT_EQ(8u, out.buffered());
+
+	out.flush();
+	EXPECT_EQ("hello 42", os.str());
+	EXPECT_EQ(0u, out.buffered());
+
+	//filling the buffer pushes out what's there, and anything bigger goes straight through
+	const std::string big(100, 'x');
+	out << "a";
+	out.write(big.data(), big.size());
+	EXPECT_EQ("hello 42a" + big, os.str());
+}
@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+
+#include "../src/parallel_replay.hpp"
+#include "test_feeds.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+	//a multi instrument feed with blank lines, bad lines and some long lines, so
+	//that chunks often start mid-line or have no lines of their own
+	std::string write_feed()
+	{
+		test_feed_options options;
+		options.seed = 29;
+		options.lines = 20000;
+		options.symbols = 5;
+		options.order_ids = 300;
+		options.bad = 2;
+		options.max_bad_length = 300;
+
+		const std::string path = temp_path("parallel_replay");
+		write_test_feed(path, make_test_feed(options));
+		return path;
+	}
+
+	std::string replay(const std::string &path, const parallel_options *options)
+	{
+		feedhandler_options feed;
+		feed.max_instruments = 4;
+
+		std::ostringstream os;
+		feedhandler fh(10, os, feed);
+		if (options)
+		{
+			parallel_replay replay(*options);
+			EXPECT_TRUE(replay.open(path.c_str()));
+			replay.run(fh);
+		}
+		else
+		{
+			mapped_file file;
+			EXPECT_TRUE(file.open(path.c_str()));
+			file.for_each_line([&fh](const char *line, size_t len)
+			{
+				fh.process_message(line, len);
+			});
+		}
+		fh.print_stats();
+		return os.str();
+	}
+}
+
+TEST(parallel_replay, same_output_and_stats_as_serial)
+{
+	const std::string path = write_feed();
+	const std::string expected = replay(path, nullptr);
+	ASSERT_NE(std::string::npos, expected.find("  unparseable: "));
+
+	for (const unsigned threads : {1u, 3u})
+	{
+		for (const size_t chunk_bytes : {1u, 7u, 1000u, 1u << 20})
+		{
+			parallel_options options;
+			options.threads = threads;
+			options.chunk_bytes = chunk_bytes;
+			options.chunks_per_thread = 1;
+			EXPECT_EQ(expected, replay(path, &options)) << threads << " threads, " << chunk_bytes << " byte chunks";
+		}
+	}
+	remove(path.c_str());
+}
+
+TEST(parallel_replay, empty_and_missing_files)
+{
+	const std::string path = temp_path("parallel_replay_empty");
+	std::ofstream(path).close();
+
+	std::ostringstream os;
+	feedhandler fh(10, os);
+	parallel_replay replay;
+	EXPECT_LE(1u, replay.thread_count());
+	ASSERT_TRUE(replay.open(path.c_str()));
+	replay.run(fh);
+	fh.flush();
+	EXPECT_EQ("", os.str());
+	remove(path.c_str());
+
+	parallel_replay missing;
+	EXPECT_FALSE(missing.open("/nonexistent/feed.csv"));
+}
@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+
+#include "../src/perf_counters.hpp"
+
+#include <string>
+#include <thread>
+
+namespace
+{
+	volatile uint64_t sink;
+
+	void spin(int iterations)
+	{
+		uint64_t total = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			total += i * 7;
+			sink = total;
+		}
+	}
+}
+
+TEST(perf_counters, count_this_thread_and_its_children_or_say_why_not)
+{
+	perf_counters counters;
+	std::string error;
+	if (!counters.open(error))
+	{
+		//no counters on this box; all that's owed is a reason, and reading is harmless
+		EXPECT_FALSE(error.empty());
+		counters.start();
+		counters.stop();
+		const auto counted = counters.read();
+		for (int c = 0; c < perf_counters::counter_count; ++c)
+		{
+			EXPECT_FALSE(counted.counted[c]);
+		}
+		return;
+	}
+	EXPECT_TRUE(error.empty());
+
+	counters.start();
+	spin(1000000);
+	counters.stop();
+	const auto alone = counters.read();
+
+	//a thread started once the counters are open is counted too, even once it's gone
+	counters.start();
+	spin(1000000);
+	std::thread([]() { spin(1000000); }).join();
+	counters.stop();
+	const auto with_thread = counters.read();
+
+	if (alone.counted[perf_counters::instructions])
+	{
+		EXPECT_GT(alone.values[perf_counters::instructions], 1000000);
+		EXPECT_GT(with_thread.values[perf_counters::instructions], 1.5 * alone.values[perf_counters::instructions]);
+	}
+}
@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include "../src/pipelined_replay.hpp"
+#include "../src/mapped_file.hpp"
+#include "test_feeds.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+	//a feed file with some blank and bad lines in it, and no newline at the end. no
+	//line is longer than the smallest block, which would have to split it
+	std::string write_feed(const char *name)
+	{
+		test_feed_options options;
+		options.seed = 23;
+		options.lines = 20000;
+		options.order_ids = 300;
+		options.bad = 1;
+		options.cents = true;
+		options.max_bad_length = 40;
+
+		const std::string path = temp_path(name);
+		write_test_feed(path, make_test_feed(options), false);
+		return path;
+	}
+
+	std::string replay_mapped(const std::string &path)
+	{
+		std::ostringstream os;
+		feedhandler fh(10, os);
+		mapped_file file;
+		EXPECT_TRUE(file.open(path.c_str()));
+		file.for_each_line([&fh](const char *line, size_t len)
+		{
+			fh.process_message(line, len);
+		});
+		fh.print_stats();
+		return os.str();
+	}
+}
+
+TEST(pipelined_replay, same_output_as_mapped)
+{
+	const std::string path = write_feed("pipelined_replay");
+	const std::string expected = replay_mapped(path);
+
+	//blocks small enough that lines straddle them all the time, and few enough that
+	//the reader has to wait for them to come back
+	for (const size_t block_bytes : {64u, 1000u, 1u << 20})
+	{
+		pipeline_options options;
+		options.block_bytes = block_bytes;
+		options.blocks = 3;
+
+		std::ostringstream os;
+		feedhandler fh(10, os);
+		pipelined_replay pipeline(options);
+		ASSERT_TRUE(pipeline.open(path.c_str()));
+		pipeline.run(fh);
+		fh.print_stats();
+		EXPECT_EQ(expected, os.str());
+	}
+	remove(path.c_str());
+}
+
+TEST(pipelined_replay, empty_and_missing_files)
+{
+	const std::string path = temp_path("pipelined_replay_empty");
+	std::ofstream(path).close();
+
+	std::ostringstream os;
+	feedhandler fh(10, os);
+	pipelined_replay pipeline;
+	ASSERT_TRUE(pipeline.open(path.c_str()));
+	pipeline.run(fh);
+	fh.flush();
+	EXPECT_EQ("", os.str());
+	remove(path.c_str());
+
+	pipelined_replay missing;
+	EXPECT_FALSE(missing.open("/nonexistent/feed.csv"));
+}
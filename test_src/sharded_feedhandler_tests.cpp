@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+
+#include "../src/sharded_feedhandler.hpp"
+#include "test_feeds.hpp"
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//a multi instrument feed with the same order ids reused across instruments,
+	//a few bad lines, and some symbols too many for the capacity
+	std::vector<std::string> make_feed(int symbols)
+	{
+		test_feed_options options;
+		options.seed = 17;
+		options.lines = 20000;
+		options.symbols = symbols;
+		options.order_ids = 50;
+		options.modifies = 2;
+		options.bad = 1;
+		options.price_range = 20;
+		return make_test_feed(options);
+	}
+
+	//the output lines for each symbol, in the order they were written
+	std::map<std::string, std::vector<std::string>> lines_by_symbol(const std::string &output)
+	{
+		std::map<std::string, std::vector<std::string>> lines;
+		std::istringstream is(output);
+		std::string line;
+		while (std::getline(is, line))
+		{
+			const size_t comma = line.find(',');
+			if (comma != std::string::npos)
+			{
+				lines[line.substr(0, comma)].push_back(line);
+			}
+		}
+		return lines;
+	}
+
+	std::string instrument_stats(const std::string &output)
+	{
+		const size_t from = output.find("ERROR STATS:");
+		return output.substr(from, output.find("\n\n", output.find("INSTRUMENT STATS:")) - from);
+	}
+}
+
+TEST(sharded_feedhandler, each_instrument_in_feed_order)
+{
+	const auto feed = make_feed(40);
+
+	feedhandler_options options;
+	options.max_instruments = 32;
+
+	const std::string expected = replay_test_feed(feed, 0, options);
+
+	for (const unsigned shards : {1u, 3u, 4u})
+	{
+		std::vector<std::unique_ptr<std::ostringstream>> outputs;
+		std::vector<std::ostream *> streams;
+		for (unsigned i = 0; i < shards; ++i)
+		{
+			outputs.emplace_back(new std::ostringstream);
+			streams.push_back(outputs.back().get());
+		}
+
+		std::ostringstream stats;
+		sharded_options sharding;
+		sharding.feed = options;
+		sharding.shards = shards;
+		sharding.queue_records = 16;
+		{
+			sharded_feedhandler fh(0, stats, streams, sharding);
+			ASSERT_EQ(shards, fh.shard_count());
+			for (const auto &line : feed)
+			{
+				fh.process_message(line);
+			}
+			fh.print_stats();
+		}
+
+		std::string combined;
+		for (const auto &output : outputs)
+		{
+			combined += output->str();
+		}
+		const std::string expected_lines = expected.substr(0, expected.find("ERROR STATS:"));
+		EXPECT_EQ(lines_by_symbol(expected_lines), lines_by_symbol(combined));
+
+		//the merged stats are the same as for one feedhandler, instruments in order
+		EXPECT_EQ(instrument_stats(expected), instrument_stats(stats.str()));
+		EXPECT_NE(std::string::npos, stats.str().find("SHARD STATS:\n  shard 0: lines "));
+	}
+}
+
+TEST(sharded_feedhandler, no_more_shards_than_instruments)
+{
+	std::ostringstream os;
+	std::vector<std::ostream *> streams(4, &os);
+
+	sharded_options sharding;
+	sharding.feed.max_instruments = 2;
+	sharding.shards = 4;
+	sharded_feedhandler fh(0, os, streams, sharding);
+	EXPECT_EQ(2u, fh.shard_count());
+
+	fh.process_message("A,A,1,B,10,100");
+	fh.process_message("B,A,1,B,10,100");
+	fh.process_message("C,A,1,B,10,100");
+	const feed_stats stats = fh.get_stats();
+	EXPECT_EQ(2u, stats.instruments.size());
+	EXPECT_EQ(1, stats.unknown_instruments);
+	EXPECT_EQ("B", stats.instruments[1].symbol);
+}
+
+TEST(sharded_feedhandler, unparsable_lines_take_no_instrument)
+{
+	std::ostringstream os;
+	std::vector<std::ostream *> streams(2, &os);
+
+	sharded_options sharding;
+	sharding.feed.max_instruments = 2;
+	sharding.shards = 2;
+	sharded_feedhandler fh(0, os, streams, sharding);
+
+	fh.process_message("garbage1,foo");
+	fh.process_message("A,A,1,B,10,100");
+	fh.process_message("A,junk");
+	fh.process_message("B,A,1,B,10,100");
+	const feed_stats stats = fh.get_stats();
+	ASSERT_EQ(2u, stats.instruments.size());
+	EXPECT_EQ(0, stats.unknown_instruments);
+	EXPECT_EQ(2, stats.unparsable);
+	EXPECT_EQ("A", stats.instruments[0].symbol);
+	EXPECT_EQ(1, stats.instruments[0].unparsable);
+	EXPECT_EQ("B", stats.instruments[1].symbol);
+	EXPECT_EQ(1, stats.instruments[1].messages);
+}
@@ -0,0 +1,155 @@
+#ifndef __TEST_FEEDS_H__
+#define __TEST_FEEDS_H__
+
+#include "../src/feedhandler.hpp"
+#include "../src/message_parser.hpp"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+//a file of the given name in /tmp, kept apart from any other run's
+inline std::string temp_path(const char *name)
+{
+	return std::string("/tmp/") + name + "_" + std::to_string(getpid());
+}
+
+//what goes into a feed from make_test_feed. each kind of line is picked with
+//the given weight; the defaults are a plain feed with no bad lines
+struct test_feed_options
+{
+	unsigned seed = 1;
+	int lines = 5000;
+
+	//0 for the plain format, otherwise every line but some of the bad ones starts
+	//with one of this many symbols, S0, S1...
+	int symbols = 0;
+
+	//orders take ids in [0, order_ids), so modifies and removes often hit one
+	int order_ids = 200;
+
+	int adds = 3;
+	int modifies = 1;
+	int removes = 1;
+	int trades = 1;
+	int bad = 0;
+
+	//bids are priced in [min_price, min_price + price_range) and asks the same but
+	//ask_offset higher, with a random fraction if cents is set
+	int min_price = 100;
+	int price_range = 30;
+	int ask_offset = 0;
+	bool cents = false;
+
+	//some bad lines are a run of junk up to this long, to go past any fixed size buffer
+	int max_bad_length = 150;
+};
+
+//a seeded random feed, one line per entry
+inline std::vector<std::string> make_test_feed(const test_feed_options &options)
+{
+	std::mt19937 rng(options.seed);
+	const int total = options.adds + options.modifies + options.removes + options.trades + options.bad;
+	std::vector<std::string> feed;
+	feed.reserve(options.lines);
+	for (int i = 0; i < options.lines; ++i)
+	{
+		const std::string symbol = options.symbols ? "S" + std::to_string(rng() % options.symbols) + "," : "";
+		const bool bid = rng() & 1;
+		std::string price = std::to_string(options.min_price + (bid ? 0 : options.ask_offset) + rng() % options.price_range);
+		if (options.cents)
+		{
+			price += "." + std::to_string(rng() % 100);
+		}
+		const std::string volume = std::to_string(1 + rng() % 100);
+		const std::string order = std::to_string(rng() % options.order_ids) + (bid ? ",B," : ",S,") + volume + "," + price;
+
+		int pick = rng() % total;
+		if ((pick -= options.adds) < 0)
+		{
+			feed.push_back(symbol + "A," + order);
+		}
+		else if ((pick -= options.modifies) < 0)
+		{
+			feed.push_back(symbol + "M," + order);
+		}
+		else if ((pick -= options.removes) < 0)
+		{
+			feed.push_back(symbol + "X," + order);
+		}
+		else if ((pick -= options.trades) < 0)
+		{
+			feed.push_back(symbol + "T," + volume + "," + price);
+		}
+		else
+		{
+			switch (rng() % 4)
+			{
+			case 0: feed.push_back(""); break;
+			case 1: feed.push_back("not a message"); break;
+			case 2: feed.push_back(symbol + "junk"); break;
+			case 3: feed.push_back(symbol + std::string(rng() % options.max_bad_length, 'z')); break;
+			}
+		}
+	}
+	return feed;
+}
+
+//write the feed to a file, a line at a time
+inline void write_test_feed(const std::string &path, const std::vector<std::string> &feed, bool newline_at_end = true)
+{
+	std::ofstream os(path);
+	for (size_t i = 0; i < feed.size(); ++i)
+	{
+		os << feed[i];
+		if (newline_at_end || i + 1 != feed.size())
+		{
+			os << '\n';
+		}
+	}
+}
+
+//everything a feedhandler prints for the feed, ending with its stats if asked
+inline std::string replay_test_feed(const std::vector<std::string> &feed, int ob_print_frequency,
+		const feedhandler_options &options, bool with_stats = true)
+{
+	std::ostringstream os;
+	feedhandler fh(ob_print_frequency, os, options);
+	for (const auto &line : feed)
+	{
+		fh.process_message(line);
+	}
+	if (with_stats)
+	{
+		fh.print_stats();
+	}
+	else
+	{
+		fh.flush();
+	}
+	return os.str();
+}
+
+//apply a line of a plain feed straight to a book; bad lines are skipped
+template <typename Book>
+void apply_test_line(Book &ob, const std::string &line)
+{
+	parsed_message msg;
+	if (!message_parser(ob.get_tick_size()).parse(line.data(), line.size(), msg))
+	{
+		return;
+	}
+	switch (msg.type)
+	{
+	case message_type::add: ob.on_order_add(msg.order_side, msg.order_id, msg.price, msg.volume); break;
+	case message_type::modify: ob.on_order_modify(msg.order_side, msg.order_id, msg.price, msg.volume); break;
+	case message_type::remove: ob.on_order_remove(msg.order_side, msg.order_id); break;
+	case message_type::trade: ob.on_trade(msg.price, msg.volume); break;
+	}
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+
+#include "../src/capture_format.hpp"
+#include "../src/feedhandler.hpp"
+#include "../src/orderbook.hpp"
+#include "../src/workload_simulator.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//the profile, cut down so that a few thousand steps are well past filling the books
+	workload_profile small(workload_profile profile)
+	{
+		profile.depth = std::min(profile.depth, 100);
+		profile.instruments = std::min(profile.instruments, 20);
+		return profile;
+	}
+
+	std::vector<std::string> generate(const workload_profile &profile, uint64_t seed, int steps)
+	{
+		workload_simulator simulator(profile, seed);
+		std::vector<std::string> feed;
+		for (int i = 0; i < steps; ++i)
+		{
+			simulator.step([&](int instrument, const parsed_message &msg)
+			{
+				char line[max_capture_line];
+				const std::string &symbol = simulator.symbol(instrument);
+				feed.emplace_back(line, format_capture_line(msg, symbol.data(), symbol.size(), tick_size(), line));
+			});
+		}
+		return feed;
+	}
+
+	//the volumes queued at each price on each side, in time priority
+	typedef std::map<std::pair<side, price_t>, std::vector<int>> level_queues;
+
+	level_queues queues_of(const workload_simulator &simulator, int instrument)
+	{
+		level_queues queues;
+		simulator.for_each_resting_order(instrument, [&queues](side s, price_t price, int volume)
+		{
+			queues[std::make_pair(s, price)].push_back(volume);
+		});
+		return queues;
+	}
+
+	level_queues queues_of(const orderbook &ob)
+	{
+		level_queues queues;
+		ob.for_each_order_by_price([&queues](side s, price_t price, int volume)
+		{
+			queues[std::make_pair(s, price)].push_back(volume);
+		});
+
+		//the asks come out from the back of each level
+		for (auto &queue : queues)
+		{
+			if (queue.first.first == side::ask)
+			{
+				std::reverse(queue.second.begin(), queue.second.end());
+			}
+		}
+		return queues;
+	}
+}
+
+TEST(workload_simulator, every_event_of_every_profile_applies_cleanly)
+{
+	for (const auto &named : workload_profile::all())
+	{
+		SCOPED_TRACE(named.name);
+		const workload_profile profile = small(named);
+		workload_simulator simulator(profile, 5);
+
+		std::vector<std::unique_ptr<orderbook>> books;
+		for (int i = 0; i < simulator.instruments(); ++i)
+		{
+			books.emplace_back(new orderbook());
+		}
+
+		int events = 0, trades = 0, failures = 0;
+		for (int i = 0; i < 20000; ++i)
+		{
+			simulator.step([&](int instrument, const parsed_message &msg)
+			{
+				++events;
+				trades += msg.type == message_type::trade;
+				failures += !apply_capture_record(*books[instrument], to_capture_record(msg, instrument));
+			});
+		}
+		EXPECT_GE(events, 20000);
+		EXPECT_GT(trades, 0);
+		EXPECT_EQ(0, failures);
+
+		//the books it keeps are the books the feed builds, and none of them is left crossed
+		for (int i = 0; i < simulator.instruments(); ++i)
+		{
+			EXPECT_EQ(simulator.resting_orders(i, side::bid), (size_t)books[i]->get_order_count_on_side(side::bid));
+			EXPECT_EQ(simulator.resting_orders(i, side::ask), (size_t)books[i]->get_order_count_on_side(side::ask));
+			EXPECT_EQ(0, books[i]->get_error_stats().total());
+			EXPECT_EQ(queues_of(simulator, i), queues_of(*books[i]));
+			if (books[i]->get_order_count_on_side(side::bid) != 0 && books[i]->get_order_count_on_side(side::ask) != 0)
+			{
+				EXPECT_FALSE(books[i]->is_crossed());
+			}
+		}
+	}
+}
+
+TEST(workload_simulator, feed_text_replays_without_errors)
+{
+	workload_profile profile;
+	ASSERT_TRUE(workload_profile::named("many_instruments", profile));
+	profile = small(profile);
+	const auto feed = generate(profile, 9, 5000);
+	EXPECT_EQ(0u, feed[0].find("SYM"));
+
+	feedhandler_options options;
+	options.max_instruments = profile.instruments;
+	std::ostringstream os;
+	feedhandler fh(0, os, options);
+	for (const auto &line : feed)
+	{
+		fh.process_message(line);
+	}
+	const feed_stats stats = fh.get_stats();
+	EXPECT_EQ((int)feed.size(), stats.messages);
+	EXPECT_EQ(0, stats.unparsable);
+	EXPECT_EQ(0, stats.unknown_instruments);
+	EXPECT_EQ(0, stats.book_errors.total());
+}
+
+TEST(workload_simulator, same_seed_same_feed)
+{
+	workload_profile profile;
+	ASSERT_TRUE(workload_profile::named("bursty", profile));
+	profile = small(profile);
+	EXPECT_EQ(generate(profile, 3, 3000), generate(profile, 3, 3000));
+	EXPECT_NE(generate(profile, 3, 3000), generate(profile, 4, 3000));
+
+	EXPECT_FALSE(workload_profile::named("no_such_profile", profile));
+}
+
+TEST(zipf_table, favours_the_first_by_the_exponent)
+{
+	workload_rng rng(1);
+	const zipf_table uniform(4, 0);
+	const zipf_table skewed(4, 1);
+	int uniform_counts[4] = {}, skewed_counts[4] = {};
+	const int draws = 100000;
+	for (int i = 0; i < draws; ++i)
+	{
+		++uniform_counts[uniform.draw(rng)];
+		++skewed_counts[skewed.draw(rng)];
+	}
+
+	//1/(k+1) over 1 + 1/2 + 1/3 + 1/4 is 48%, 24%, 16% and 12%
+	const double expected[4] = {0.48, 0.24, 0.16, 0.12};
+	for (int k = 0; k < 4; ++k)
+	{
+		EXPECT_NEAR(0.25, uniform_counts[k] / (double)draws, 0.01);
+		EXPECT_NEAR(expected[k], skewed_counts[k] / (double)draws, 0.01);
+	}
+}